@@ -0,0 +1,472 @@
+/**
+ * @file json_bench.c
+ * @brief Benchmark of the JSON parser over generated SCEF corpora
+ *
+ * Every corpus holds documents of one resource in a range of sizes. Each
+ * document goes through ten timed stages :
+ *   tokenize   json_parseJsonLen() into the thread context
+ *   lookup     key index build and the scsId getter
+ *   decode     json_decodeResource() into the resource struct
+ *   route      json_parseSelect() of scsId and the reference id alone
+ *   ptokenize  json_parsePackedLen() into 8 bytes tokens
+ *   walk       depth first walk of the tokenize stage tokens, scsId found by skipping subtrees
+ *   pwalk      the same walk over the packed tokens
+ *   patch      json_patchReplaceString() of scsId and the reference id, iovec of the forwarded body
+ *   binencode  json_encodeBin() of the tokenize stage tokens
+ *   binroute   scsId and the reference id read from the binary form, as route does from the text
+ * After a warm-up pass the corpus is run -r times; ns/doc, MB/s and the
+ * p50/p90/p99 of the per-document times are reported. -b compares the
+ * ns/doc with a baseline written by -w and fails past the tolerance.
+ *
+ *   make bench                  run, compare with json_bench.baseline if present
+ *   make bench-baseline         store the current numbers as the baseline
+ */
+#define JSON_NO_TEST_MAIN
+#include "slee_json_parser_test.c"
+
+#define BENCH_MAX_DOC_LEN			32768
+#define BENCH_MAX_LINE				64
+#define BENCH_STAGE_NUM				10
+
+typedef struct {
+	const char	*name;
+	const char	*resource;
+	const char	*refKey;
+	JsonBinding	*bind;
+	size_t		outSize;
+	int			(*gen)(char *out, int size, unsigned int *seed, int scale);
+} Bench_corpus_t;
+
+typedef struct {
+	char		corpus[32];
+	char		stage[16];
+	double		nsPerDoc;
+} Bench_line_t;
+
+static const char *stageName[BENCH_STAGE_NUM] = { "tokenize", "lookup", "decode", "route", "ptokenize", "walk", "pwalk", "patch",
+	"binencode", "binroute" };
+
+/* Keeps the walks from being optimized out */
+static volatile unsigned int benchSink;
+
+/* xorshift32, the corpora are the same on every run */
+static unsigned int bench_rand(unsigned int *seed)
+{
+	unsigned int x = *seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *seed = x;
+}
+
+static int bench_address(char *out, unsigned int *seed, int num)
+{
+	int i, len = 0;
+
+	for (i = 0; i < num; i++)
+		len += sprintf(out + len, "%s\"tel:+8210%08u\"", i ? ", " : "", bench_rand(seed) % 100000000);
+	return len;
+}
+
+static int gen_nidd_info(char *out, int size, unsigned int *seed, int scale)
+{
+	char addr[1024];
+
+	bench_address(addr, seed, 1 + scale * (MAX_SCS_ADDRESS_NUM - 1) / 3);
+	return snprintf(out, size, "{\"nidd:info\" : { \"scsRefereneId\": \"%08X\", \"scsId\":\"scs%02u\", "
+			"\"address\": [%s], \"validity\": { \"startTime\": \"2016-06-23T09:00:00\", \"expiryTime\": \"2017-06-23T09:00:00\" }}}",
+			bench_rand(seed), bench_rand(seed) % 100, addr);
+}
+
+static int gen_cp_info(char *out, int size, unsigned int *seed, int scale)
+{
+	char sched[4096];
+	int i, len = 0, num = 1 + scale * (MAX_SCS_SCHEDULE_COMM_NUM - 1) / 3;
+
+	for (i = 0; i < num; i++)
+		len += sprintf(sched + len, "%s{ \"timeOfDayStart\": \"%u\", \"timeOfDayEnd\": \"%u\", \"dayOfWeekMask\": \"%u%u%u%u%u00\", \"timezoneFlag\": \"%u\" }",
+				i ? ", " : "", bench_rand(seed) % 43200, 43200 + bench_rand(seed) % 43200,
+				bench_rand(seed) & 1, bench_rand(seed) & 1, bench_rand(seed) & 1, bench_rand(seed) & 1, bench_rand(seed) & 1,
+				bench_rand(seed) % 3);
+
+	return snprintf(out, size, "{ \"cp:info\" : { \"scsRefereneId\": \"%08u\", \"scsId\":\"scs%02u\", \"address\": [ \"tel:+8210%08u\" ], "
+			"\"validity\": { \"startTime\": \"2016-06-23T09:00:00\", \"expiryTime\": \"2017-06-23 09:00:00\" }, "
+			"\"parameterSet\": { \"periodicCommunication\": { \"commIndicator\": \"Periodic\", \"duration\": %u, \"interval\": %u }, "
+			"\"scheduledCommunication\": [%s], \"stationary\": \"Mobile\" } } }",
+			bench_rand(seed) % 100000000, bench_rand(seed) % 100, bench_rand(seed) % 100000000,
+			bench_rand(seed) % 3600, bench_rand(seed) % 86400, sched);
+}
+
+static int gen_event_info(char *out, int size, unsigned int *seed, int scale)
+{
+	char monset[16384];
+	int i, len = 0, num = 1 + scale * (MAX_SCS_MON_SET_NUM - 1) / 3;
+
+	for (i = 0; i < num; i++)
+		len += sprintf(monset + len, "%s{ \"monitorType\" : \"%s\", \"validity\": { \"startTime\": \"2017-01-01 00:00:00\", \"expiryTime\": \"2017-12-31 24:00:00\" }, "
+				"\"reportNumber\": %u, \"chargingNumber\": \"8210%08u\", \"reachableMonitor\": { \"eventType\": [ \"SMS\", \"DATA\" ], "
+				"\"maximumLatency\" : %u, \"maximumResponse\" : %u }, \"associationMonitor\": [ \"IMSI\", \"IMEISV\" ], "
+				"\"locationMonitor\": { \"locationType\": \"current\", \"accuracy\": \"ecgi\" }, \"groupMonitor\": { \"groupType\": \"ecgi\", \"groupValue\": \"%04x\" } }",
+				i ? ", " : "", (bench_rand(seed) & 1) ? "ueReachable" : "lossofConnectivity",
+				bench_rand(seed) % 100, bench_rand(seed) % 100000000, bench_rand(seed) % 5000, bench_rand(seed) % 5000,
+				bench_rand(seed) & 0xffff);
+
+	return snprintf(out, size, "{ \"event:info\" : { \"scsRefereneId\": \"%08u\", \"scsId\":\"scs%02u\", \"address\": [ \"tel:+8210%08u\" ], "
+			"\"monitorSet\" : [%s], \"destinationAddress\": \"192.100.101.101:9002\" } }",
+			bench_rand(seed) % 100000000, bench_rand(seed) % 100, bench_rand(seed) % 100000000, monset);
+}
+
+static int gen_mo_indication(char *out, int size, unsigned int *seed, int scale)
+{
+	static const int niddLen[] = { 32, 256, 1024, 2048 };
+	int i, j, len, num = 1 + scale;
+
+	len = snprintf(out, size, "{\"nidd:moIndication\":{\"scsId\":\"scs%02u\",\"scsReferenceId\":\"8210%08u\",\"moData\":[",
+			bench_rand(seed) % 100, bench_rand(seed) % 100000000);
+	for (i = 0; i < num; i++) {
+		len += snprintf(out + len, size - len, "%s{\"address\":\"tel:+8210%08u\",\"niddData\":\"", i ? "," : "", bench_rand(seed) % 100000000);
+		for (j = 0; j < niddLen[scale] && len < size - 8; j++)
+			out[len++] = '0' + (bench_rand(seed) & 1);
+		len += snprintf(out + len, size - len, "\"}");
+	}
+	return len + snprintf(out + len, size - len, "]}}");
+}
+
+/* moIndication has no binding, its fields are read through a path set */
+static JsonPathSet	moPathSet;
+static int			moPathReady;
+
+static int decode_mo_indication(const char *js, JsonToken *tokens)
+{
+	JsonView	val[JSON_PATHSET_MAX_PATH];
+
+	if (!moPathReady) {
+		json_initPathSet(&moPathSet);
+		json_addPath(&moPathSet, "/nidd:moIndication/scsId");
+		json_addPath(&moPathSet, "/nidd:moIndication/scsReferenceId");
+		json_addPath(&moPathSet, "/nidd:moIndication/moData");
+		moPathReady = 1;
+	}
+	return (json_viewPathSet(json_viewOf(js, tokens), &moPathSet, val) == moPathSet.pathNum) ? 1 : -1;
+}
+
+/* Depth first walk going from child to child by subtree skips, the spans
+ * of the scalars are summed, then scsId is found through the member lookup */
+static unsigned int bench_walkTree(JsonToken *tok)
+{
+	JsonToken	*c, *end;
+	unsigned int sum = 0;
+
+	if (tok->type != JSON_OBJECT && tok->type != JSON_ARRAY) return tok->end - tok->start;
+	for (c = tok + 1, end = tok + tok->skip; c < end; c += c->skip) sum += bench_walkTree(c);
+	return sum;
+}
+
+static unsigned int bench_walkPacked(const JsonPackedToken *tok)
+{
+	const JsonPackedToken *c, *end;
+	unsigned int sum = 0;
+
+	if (!JSON_PACKED_IS_CONTAINER(tok)) return JSON_PACKED_LEN(tok);
+	for (c = tok + 1, end = tok + JSON_PACKED_LEN(tok); c < end; c += JSON_PACKED_SKIP(c)) sum += bench_walkPacked(c);
+	return sum;
+}
+
+static void bench_walk(const char *js, JsonToken *tokens, const char *resource)
+{
+	benchSink = bench_walkTree(tokens) + json_viewMember(json_viewMember(json_viewOf(js, tokens), resource), "scsId").tok->start;
+}
+
+static void bench_packedWalk(const char *js, JsonPackedToken *tokens, const char *resource)
+{
+	benchSink = bench_walkPacked(tokens) + json_packedMember(js, json_packedMember(js, tokens, resource), "scsId")->start;
+}
+
+static struct iovec *bench_patch(JsonPatch *patch, const char *js, int len, JsonToken *tokens, const char *resource, const char *refKey, char *frag, size_t size)
+{
+	JsonView	res = json_viewMember(json_viewOf(js, tokens), resource);
+	int			iovcnt;
+	size_t		total;
+
+	json_initPatch(patch, js, len, frag, size);
+	json_patchReplaceString(patch, json_viewMember(res, "scsId"), "scs07", 5);
+	json_patchReplaceString(patch, json_viewMember(res, refKey), "forwarded0001", 13);
+	return json_finishPatch(patch, &iovcnt, &total);
+}
+
+static int bench_binRoute(const unsigned char *buf, long len, const char *resource, const char *refKey, char *name, int size)
+{
+	JsonBin		bin;
+	JsonBinView	res;
+
+	if (json_openBin(&bin, buf, len) < 0) return -1;
+	res = json_binMember(json_binRoot(&bin), resource);
+	if (json_binString(json_binMember(res, "scsId"), name, size - 1) < 0) return -1;
+	return json_binString(json_binMember(res, refKey), name, size - 1);
+}
+
+static Bench_corpus_t corpus[] = {
+	{ "nidd:info",      "nidd:info",         "scsRefereneId",  &json_bindNiddInfo, sizeof(Scs_nidd_info_t), gen_nidd_info },
+	{ "cp:info",        "cp:info",           "scsRefereneId",  &json_bindCpInfo,   sizeof(Scs_cp_info_t),   gen_cp_info },
+	{ "event:info",     "event:info",        "scsRefereneId",  &json_bindEvtInfo,  sizeof(Scs_evt_info_t),  gen_event_info },
+	{ "moIndication",   "nidd:moIndication", "scsReferenceId", NULL,               0,                       gen_mo_indication },
+};
+
+static long long bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * @fn static int bench_corpus(Bench_corpus_t *c, int docNum, int repeat, Bench_line_t *line, int lineNum)
+ * @brief Generates the corpus, runs it and prints one line per stage.
+ * @return lines added, -1 if a document fails a stage
+ */
+static int bench_corpus(Bench_corpus_t *c, int docNum, int repeat, Bench_line_t *line, int lineNum)
+{
+	JsonContext	*ctx = json_getContext();
+	char		*text, name[32], *out, path[64];
+	int			*off, *len, i, r, s, pass;
+	long long	*sample[BENCH_STAGE_NUM], t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12, total[BENCH_STAGE_NUM], overhead;
+	JsonParser	packedParser;
+	JsonPatch	patch;
+	char		frag[128];
+	unsigned char *bin;
+	long		binLen;
+	JsonPackedToken *packed;
+	JsonPathSet	route;
+	JsonView	routeVal[JSON_PATHSET_MAX_PATH];
+	size_t		bytes = 0;
+	unsigned int seed = 0x5cef0001;
+
+	text = (char *)malloc((size_t)docNum * BENCH_MAX_DOC_LEN);
+	off = (int *)malloc(sizeof(int) * docNum);
+	len = (int *)malloc(sizeof(int) * docNum);
+	out = (char *)malloc(c->outSize > 0 ? c->outSize : 1);
+	packed = (JsonPackedToken *)malloc(sizeof(JsonPackedToken) * BENCH_MAX_DOC_LEN);
+	bin = (unsigned char *)malloc(JSON_BIN_HEAD_LEN + BENCH_MAX_DOC_LEN * 14);
+	for (s = 0; s < BENCH_STAGE_NUM; s++) sample[s] = (long long *)malloc(sizeof(long long) * docNum * repeat);
+
+	// What a router needs, nothing else is tokenized
+	json_initPathSet(&route);
+	snprintf(path, sizeof(path), "/%s/scsId", c->resource);
+	json_addPath(&route, path);
+	snprintf(path, sizeof(path), "/%s/%s", c->resource, c->refKey);
+	json_addPath(&route, path);
+
+	// Sizes cycle through 4 scales, from one element to the biggest arrays
+	for (i = 0; i < docNum; i++) {
+		off[i] = (i == 0) ? 0 : off[i - 1] + len[i - 1] + 1;
+		len[i] = c->gen(text + off[i], BENCH_MAX_DOC_LEN, &seed, i % 4);
+		bytes += len[i];
+	}
+
+	// Cost of the clock itself, taken off every sample
+	t0 = bench_now();
+	for (i = 0; i < 1000; i++) bench_now();
+	overhead = (bench_now() - t0) / 1000;
+
+	// Pass 0 warms the caches and the context arena, it is not counted
+	for (pass = 0; pass <= repeat; pass++) {
+		for (i = 0; i < docNum; i++) {
+			const char *js = text + off[i];
+
+			t0 = bench_now();
+			json_initJsonParser(&ctx->parser);
+			r = json_runContext(ctx, js, len[i]);
+			t1 = bench_now();
+			if (r != JSON_SUCCESS) {
+				printf("[%s] %s doc %d : %s at %u\n", __func__, c->name, i, json_strerror(ctx->parser.errcode), ctx->parser.errpos);
+				return -1;
+			}
+
+			json_buildKeyIndex(&ctx->index, js, ctx->tokens, ctx->tokenNum);
+			if (get_string_from_json_new((char *)js, ctx->tokens, "scsId", name, sizeof(name) - 1) < 0) return -1;
+			t2 = bench_now();
+
+			if (c->bind != NULL)
+				r = json_decodeResource(js, ctx->tokens, ctx->tokenNum, c->resource, c->bind, out);
+			else
+				r = decode_mo_indication(js, ctx->tokens);
+			t3 = bench_now();
+			if (r < 0) {
+				printf("[%s] %s doc %d : can't decode\n", __func__, c->name, i);
+				return -1;
+			}
+
+			r = json_parseSelect(ctx, &route, js, len[i], routeVal);
+			t4 = bench_now();
+			if (r != JSON_SUCCESS || routeVal[1].tok == NULL) {
+				printf("[%s] %s doc %d : can't route\n", __func__, c->name, i);
+				return -1;
+			}
+
+			t5 = bench_now();
+			json_initJsonParser(&packedParser);
+			r = json_parsePackedLen(&packedParser, js, len[i], packed, BENCH_MAX_DOC_LEN);
+			t6 = bench_now();
+			// The route stage left its own tokens in the arena
+			json_initJsonParser(&ctx->parser);
+			json_runContext(ctx, js, len[i]);
+			if (r != JSON_SUCCESS || packedParser.toknext != ctx->tokenNum) {
+				printf("[%s] %s doc %d : packed %s at %u\n", __func__, c->name, i, json_strerror(packedParser.errcode), packedParser.errpos);
+				return -1;
+			}
+			t7 = bench_now();
+			bench_walk(js, ctx->tokens, c->resource);
+			t8 = bench_now();
+			bench_packedWalk(js, packed, c->resource);
+			t9 = bench_now();
+			if (bench_patch(&patch, js, len[i], ctx->tokens, c->resource, c->refKey, frag, sizeof(frag)) == NULL) {
+				printf("[%s] %s doc %d : can't patch\n", __func__, c->name, i);
+				return -1;
+			}
+			t10 = bench_now();
+			binLen = json_encodeBin(js, ctx->tokens, ctx->tokenNum, bin, JSON_BIN_HEAD_LEN + BENCH_MAX_DOC_LEN * 14);
+			t11 = bench_now();
+			if (binLen < 0 || bench_binRoute(bin, binLen, c->resource, c->refKey, name, sizeof(name)) < 0) {
+				printf("[%s] %s doc %d : can't read the binary form\n", __func__, c->name, i);
+				return -1;
+			}
+			t12 = bench_now();
+
+			if (pass == 0) continue;
+			sample[0][(pass - 1) * docNum + i] = t1 - t0 - overhead;
+			sample[1][(pass - 1) * docNum + i] = t2 - t1 - overhead;
+			sample[2][(pass - 1) * docNum + i] = t3 - t2 - overhead;
+			sample[3][(pass - 1) * docNum + i] = t4 - t3 - overhead;
+			sample[4][(pass - 1) * docNum + i] = t6 - t5 - overhead;
+			sample[5][(pass - 1) * docNum + i] = t8 - t7 - overhead;
+			sample[6][(pass - 1) * docNum + i] = t9 - t8 - overhead;
+			sample[7][(pass - 1) * docNum + i] = t10 - t9 - overhead;
+			sample[8][(pass - 1) * docNum + i] = t11 - t10 - overhead;
+			sample[9][(pass - 1) * docNum + i] = t12 - t11 - overhead;
+		}
+	}
+
+	for (s = 0; s < BENCH_STAGE_NUM && lineNum + s < BENCH_MAX_LINE; s++) {
+		long long n = (long long)docNum * repeat;
+
+		total[s] = 0;
+		for (i = 0; i < n; i++) total[s] += sample[s][i];
+		qsort(sample[s], n, sizeof(long long), cmp_ll);
+
+		snprintf(line[lineNum + s].corpus, sizeof(line[0].corpus), "%s", c->name);
+		snprintf(line[lineNum + s].stage, sizeof(line[0].stage), "%s", stageName[s]);
+		line[lineNum + s].nsPerDoc = (double)total[s] / n;
+
+		printf("%-14s %-9s %9.1f %9.1f %8lld %8lld %8lld %9.0f\n", c->name, stageName[s],
+				line[lineNum + s].nsPerDoc, (total[s] > 0) ? bytes * repeat * 1000.0 / total[s] : 0.0,
+				sample[s][n / 2], sample[s][n * 9 / 10], sample[s][n * 99 / 100], (double)bytes / docNum);
+	}
+
+	for (s = 0; s < BENCH_STAGE_NUM; s++) free(sample[s]);
+	free(packed);
+	free(bin);
+	free(out);
+	free(len);
+	free(off);
+	free(text);
+	return s;
+}
+
+static int load_baseline(const char *path, Bench_line_t *line)
+{
+	FILE	*fp;
+	int		num = 0;
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		printf("[%s] can't open %s\n", __func__, path);
+		return -1;
+	}
+	while (num < BENCH_MAX_LINE && fscanf(fp, "%31s %15s %lf", line[num].corpus, line[num].stage, &line[num].nsPerDoc) == 3)
+		num++;
+	fclose(fp);
+	return num;
+}
+
+static void usage(const char *prog)
+{
+	printf("usage: %s [-n docs] [-r repeat] [-s scanner] [-b baseline] [-w baseline] [-t tolerance%%]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	Bench_line_t	line[BENCH_MAX_LINE], base[BENCH_MAX_LINE];
+	const char		*basePath = NULL, *writePath = NULL;
+	double			tolerance = 15.0, ratio;
+	int				docNum = 2000, repeat = 5, lineNum = 0, baseNum = 0, regress = 0;
+	int				i, j, n, opt;
+	FILE			*fp;
+
+	while ((opt = getopt(argc, argv, "n:r:s:b:w:t:h")) != -1) {
+		switch (opt) {
+			case 'n': docNum = atoi(optarg); break;
+			case 'r': repeat = atoi(optarg); break;
+			case 's':
+				if (json_setScanner(optarg) < 0) {
+					printf("scanner %s is not available\n", optarg);
+					return 1;
+				}
+				break;
+			case 'b': basePath = optarg; break;
+			case 'w': writePath = optarg; break;
+			case 't': tolerance = atof(optarg); break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (docNum <= 0 || repeat <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	printf("scanner %s, %d documents per corpus, %d runs\n\n", json_getScanner(), docNum, repeat);
+	printf("%-14s %-9s %9s %9s %8s %8s %8s %9s\n", "corpus", "stage", "ns/doc", "MB/s", "p50", "p90", "p99", "bytes/doc");
+
+	for (i = 0; i < (int)(sizeof(corpus) / sizeof(corpus[0])); i++) {
+		if ((n = bench_corpus(&corpus[i], docNum, repeat, line, lineNum)) < 0) return 1;
+		lineNum += n;
+	}
+
+	if (writePath != NULL) {
+		if ((fp = fopen(writePath, "w")) == NULL) {
+			printf("can't write %s\n", writePath);
+			return 1;
+		}
+		for (i = 0; i < lineNum; i++)
+			fprintf(fp, "%s %s %.1f\n", line[i].corpus, line[i].stage, line[i].nsPerDoc);
+		fclose(fp);
+		printf("\nbaseline written to %s\n", writePath);
+	}
+
+	if (basePath == NULL) return 0;
+	if ((baseNum = load_baseline(basePath, base)) < 0) return 1;
+
+	printf("\n%-14s %-9s %9s %9s %7s\n", "corpus", "stage", "base", "now", "delta");
+	for (i = 0; i < lineNum; i++) {
+		for (j = 0; j < baseNum; j++)
+			if (!strcmp(base[j].corpus, line[i].corpus) && !strcmp(base[j].stage, line[i].stage)) break;
+		if (j == baseNum || base[j].nsPerDoc <= 0) continue;
+
+		ratio = (line[i].nsPerDoc / base[j].nsPerDoc - 1.0) * 100.0;
+		printf("%-14s %-9s %9.1f %9.1f %+6.1f%%%s\n", line[i].corpus, line[i].stage, base[j].nsPerDoc, line[i].nsPerDoc,
+				ratio, (ratio > tolerance) ? "  REGRESSION" : "");
+		if (ratio > tolerance) regress++;
+	}
+	if (regress > 0) {
+		printf("\n%d stage(s) slower than %s by more than %.0f%%\n", regress, basePath, tolerance);
+		return 2;
+	}
+	return 0;
+}
@@ -4,14 +4,23 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <stddef.h>
 #include <string.h>
 #include <time.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #define MAX_SCS_TIME_LEN            19
 #define MAX_SCS_COMM_IND_LEN        32
 #define MAX_SCS_STATIONARY_LEN      10  // Stationary, Mobile
 
-#define MAX_JSON_TOKEN_SIZE			100
 #define HTTPF_MSG_BUFSIZE			10240
 #define MAX_SCS_EVT_TYPE_NUM        3   // sms, data, both
 #define MAX_SCS_EVT_TYPE_LEN        4
@@ -26,43 +35,169 @@
 #define MAX_SCS_MON_SET_NUM         10
 #define MAX_SCS_ID_LEN				32
 #define MAX_SCS_REF_ID_LEN			32
+#define MAX_SCS_ADDRESS_NUM			10
+#define MAX_SCS_ADDRESS_LEN			32
+#define MAX_SCS_DEST_ADDR_LEN		64
+#define MAX_SCS_SCHEDULE_COMM_NUM   10
+#define MAX_SCS_MO_DATA_NUM			10
+
+/*
+ * Enumerated values of the SCEF resources, X(code, name).
+ * The structs store the code, the rank of the name in its list; the names
+ * are matched case insensitively when decoding ( see JsonEnum ).
+ */
+#define JSON_ENUM_CODE(code, name)	code,
+#define JSON_ENUM_NAME(code, name)	name,
+
+#define SCS_MON_TYPE_LIST(X) \
+    X(SCS_MON_LOSS_OF_CONNECTIVITY,     "lossofConnectivity") \
+    X(SCS_MON_UE_REACHABILITY,          "ueReachable") \
+    X(SCS_MON_LOCATION_REPORTING,       "locationReporting") \
+    X(SCS_MON_CHANGE_OF_IMSI_IMEI,      "changeOfImsiImeiAssociation") \
+    X(SCS_MON_ROAMING_STATUS,           "roamingStatus") \
+    X(SCS_MON_COMMUNICATION_FAILURE,    "communicationFailure") \
+    X(SCS_MON_AVAILABILITY_AFTER_DDN,   "availabilityAfterDdnFailure")
+
+#define SCS_EVT_TYPE_LIST(X) \
+    X(SCS_EVT_SMS,                      "SMS") \
+    X(SCS_EVT_DATA,                     "DATA") \
+    X(SCS_EVT_BOTH,                     "BOTH")
+
+#define SCS_LOC_TYPE_LIST(X) \
+    X(SCS_LOC_CURRENT,                  "current") \
+    X(SCS_LOC_LAST,                     "last")
+
+#define SCS_ACCURACY_LIST(X) \
+    X(SCS_ACCURACY_ECGI,                "ecgi") \
+    X(SCS_ACCURACY_ENB,                 "enb") \
+    X(SCS_ACCURACY_TA,                  "ta") \
+    X(SCS_ACCURACY_PRA,                 "pra")
+
+#define SCS_GRP_TYPE_LIST(X) \
+    X(SCS_GRP_TAI,                      "tai") \
+    X(SCS_GRP_ENB_ID,                   "enbId") \
+    X(SCS_GRP_ECGI,                     "ecgi")
+
+#define SCS_ASSO_MON_LIST(X) \
+    X(SCS_ASSO_IMSI,                    "IMSI") \
+    X(SCS_ASSO_IMEISV,                  "IMEISV")
+
+#define SCS_COMM_IND_LIST(X) \
+    X(SCS_COMM_PERIODIC,                "Periodic") \
+    X(SCS_COMM_ON_DEMAND,               "OnDemand")
+
+#define SCS_STATIONARY_LIST(X) \
+    X(SCS_STATIONARY,                   "Stationary") \
+    X(SCS_MOBILE,                       "Mobile")
+
+typedef enum { SCS_MON_TYPE_LIST(JSON_ENUM_CODE) SCS_MON_TYPE_NUM } Scs_mon_type_t;
+typedef enum { SCS_EVT_TYPE_LIST(JSON_ENUM_CODE) SCS_EVT_TYPE_NUM } Scs_evt_type_t;
+typedef enum { SCS_LOC_TYPE_LIST(JSON_ENUM_CODE) SCS_LOC_TYPE_NUM } Scs_loc_type_t;
+typedef enum { SCS_ACCURACY_LIST(JSON_ENUM_CODE) SCS_ACCURACY_NUM } Scs_accuracy_t;
+typedef enum { SCS_GRP_TYPE_LIST(JSON_ENUM_CODE) SCS_GRP_TYPE_NUM } Scs_grp_type_t;
+typedef enum { SCS_ASSO_MON_LIST(JSON_ENUM_CODE) SCS_ASSO_MON_NUM } Scs_asso_mon_t;
+typedef enum { SCS_COMM_IND_LIST(JSON_ENUM_CODE) SCS_COMM_IND_NUM } Scs_comm_ind_t;
+typedef enum { SCS_STATIONARY_LIST(JSON_ENUM_CODE) SCS_STATIONARY_NUM } Scs_stationary_t;
 
 
 
 typedef struct  {
     char    start_time[MAX_SCS_TIME_LEN+1];
     char    expiry_time[MAX_SCS_TIME_LEN+1];
+    time_t  start_epoch;
+    time_t  expiry_epoch;
 } Scs_validity_t;
 
 typedef struct  {
     int     event_number;
-    char    event_type[MAX_SCS_EVT_TYPE_NUM][MAX_SCS_EVT_TYPE_LEN+1];
+    int     event_type[MAX_SCS_EVT_TYPE_NUM]; /* Scs_evt_type_t */
     int     max_latency;
     int     max_resp;
 } Scs_rchble_mon_t;
 
 typedef struct  {
-    char    loc_type[MAX_SCS_LOC_TYPE_LEN+1];
-    char    accuracy[MAX_SCS_ACCURACY_LEN+1];
+    int     loc_type; /* Scs_loc_type_t */
+    int     accuracy; /* Scs_accuracy_t */
 } Scs_loc_mon_t;
 
 typedef struct  {
-    char    group_type[MAX_SCS_GRP_TYPE_LEN+1];
+    int     group_type; /* Scs_grp_type_t */
     char    group_value[MAX_SCS_GRP_VAL_LEN+1];
 } Scs_group_mon_t;
 
 typedef struct  {
     int                 scef_ref_id;
-    char                mon_type[MAX_SCS_MON_TYPE_LEN+1];
+    int                 mon_type; /* Scs_mon_type_t */
     Scs_validity_t      validity;
     int                 report_num;
     char                charging_num[MAX_SCS_CHARGE_NUM_LEN+1];
     Scs_rchble_mon_t    rch_mon;
-    char                ass_mon[MAX_SCS_ASS_TYPE_NUM][MAX_SCS_ASSO_MON_LEN+1];
+    int                 ass_number;
+    int                 ass_mon[MAX_SCS_ASS_TYPE_NUM]; /* Scs_asso_mon_t */
     Scs_loc_mon_t       loc_mon;
     Scs_group_mon_t     grp_mon;
 } Scs_mon_set_t;
 
+typedef struct  {
+    int     time_of_day_start;
+    int     time_of_day_end;
+    int     day_of_week_mask;
+    int     timezone_flag;
+} Scs_schedule_comm_t;
+
+typedef struct  {
+    int     comm_indicator; /* Scs_comm_ind_t */
+    int     duration;
+    int     interval;
+} Scs_period_comm_t;
+
+typedef struct  {
+    Scs_period_comm_t   period_comm;
+    int                 sched_comm_number;
+    Scs_schedule_comm_t sched_comm[MAX_SCS_SCHEDULE_COMM_NUM];
+    int                 stationary; /* Scs_stationary_t */
+} Scs_param_set_t;
+
+typedef struct  {
+    char                scs_ref_id[MAX_SCS_REF_ID_LEN+1];
+    char                scs_id[MAX_SCS_ID_LEN+1];
+    int                 address_number;
+    char                address[MAX_SCS_ADDRESS_NUM][MAX_SCS_ADDRESS_LEN+1];
+    Scs_validity_t      validity;
+} Scs_nidd_info_t;
+
+typedef struct  {
+    char                scs_ref_id[MAX_SCS_REF_ID_LEN+1];
+    char                scs_id[MAX_SCS_ID_LEN+1];
+    int                 address_number;
+    char                address[MAX_SCS_ADDRESS_NUM][MAX_SCS_ADDRESS_LEN+1];
+    Scs_validity_t      validity;
+    Scs_param_set_t     param_set;
+} Scs_cp_info_t;
+
+typedef struct  {
+    char                scs_ref_id[MAX_SCS_REF_ID_LEN+1];
+    char                scs_id[MAX_SCS_ID_LEN+1];
+    int                 address_number;
+    char                address[MAX_SCS_ADDRESS_NUM][MAX_SCS_ADDRESS_LEN+1];
+    int                 monset_number;
+    Scs_mon_set_t       mon_set[MAX_SCS_MON_SET_NUM];
+    char                dest_addr[MAX_SCS_DEST_ADDR_LEN+1];
+} Scs_evt_info_t;
+
+typedef struct  {
+    char                address[MAX_SCS_ADDRESS_LEN+1];
+    const char          *nidd_data; /* referenced, not copied, by the writer */
+    int                 nidd_len;
+} Scs_mo_data_t;
+
+typedef struct  {
+    char                scs_id[MAX_SCS_ID_LEN+1];
+    char                scs_ref_id[MAX_SCS_REF_ID_LEN+1];
+    int                 mo_data_number;
+    Scs_mo_data_t       mo_data[MAX_SCS_MO_DATA_NUM];
+} Scs_mo_indication_t;
+
 
 /**
  * JSON type identifier. Basic types are:
@@ -81,11 +216,35 @@ typedef enum
     JSON_SUCCESS = 0 // Everthing is fine
 } JsonError;
 
+/**
+ * Reason of a failed parse, with JsonParser.errpos as the byte offset
+ */
+typedef enum
+{
+    JSON_ERRC_NONE = 0,
+    JSON_ERRC_NO_TOKEN,         // token array is full
+    JSON_ERRC_TOO_DEEP,         // more than JSON_MAX_DEPTH open containers
+    JSON_ERRC_UNMATCHED_CLOSE,  // '}' or ']' without an open container
+    JSON_ERRC_MISMATCHED_CLOSE, // '}' closing an array or ']' closing an object
+    JSON_ERRC_BAD_ESCAPE,       // unknown escape sequence in a string
+    JSON_ERRC_BAD_CHAR,         // control or non-ASCII byte in a primitive
+    JSON_ERRC_UNEXPECTED_CHAR,  // not the start of a value ( strict mode )
+    JSON_ERRC_OPEN_STRING,      // end of input inside a string
+    JSON_ERRC_OPEN_PRIMITIVE,   // end of input inside a primitive ( strict mode )
+    JSON_ERRC_OPEN_CONTAINER,   // end of input with an object or array still open
+    JSON_ERRC_TOO_LONG,         // document longer than JSON_PACKED_MAX_LEN ( packed tokens )
+    JSON_ERRC_BAD_UTF8,         // invalid UTF-8 sequence in a string
+    JSON_ERRC_READ              // read of the input failed ( errno )
+} JsonErrorCode;
+
 /**
  * JSON token description.
  * @param       type    type (object, array, string etc.)
  * @param       start   start position in JSON data string
  * @param       end     end position in JSON data string
+ * @param       size    children ( an object counts keys and values )
+ * @param       skip    tokens of the subtree, set when the container closes
+ * @param       flags   JSON_STRING_ESCAPED
  */
 typedef struct
 {
@@ -93,22 +252,504 @@ typedef struct
     int start;
     int end;
     int size;
+    int skip; /* tokens in the subtree including this one, next sibling is this + skip */
+    int flags;
     #ifdef json_PARENT_LINKS
     int parent;
     #endif
 } JsonToken;
 
+/* The span of the string is not its value, json_spanUnescape() decodes it */
+#define JSON_STRING_ESCAPED			0x01
+#define JSON_TOKEN_ESCAPED(t)		(((t)->flags & JSON_STRING_ESCAPED) != 0)
+
+/**
+ * Packed token, 8 bytes : a cache line holds 8 of them against 2 JsonToken.
+ * Filled by json_parsePackedLen() instead of JsonToken when the walk only
+ * needs the spans and the subtree lengths; the children count and the end
+ * of a container are not stored, json_packedSize() and json_packedEnd()
+ * work them out from the subtree.
+ * @param       start   start position in JSON data string
+ * @param       info    type in the 2 high bits, JSON_PACKED_ESCAPED, below : the length
+ *                      of a string or primitive, the tokens of the subtree of a container
+ */
+#define JSON_PACKED_TYPE_SHIFT		30
+#define JSON_PACKED_ESCAPED			0x20000000	// string with escapes, see JSON_STRING_ESCAPED
+#define JSON_PACKED_MAX_LEN			0x1fffffff	// longest document, bounds every length and subtree
+
+typedef struct
+{
+    unsigned int start;
+    unsigned int info;
+} JsonPackedToken;
+
+#define JSON_PACKED_TYPE(t)			((JsonType)((t)->info >> JSON_PACKED_TYPE_SHIFT))
+#define JSON_PACKED_IS_CONTAINER(t)	(JSON_PACKED_TYPE(t) == JSON_OBJECT || JSON_PACKED_TYPE(t) == JSON_ARRAY)
+/* Length of a string or primitive, tokens of the subtree of a container */
+#define JSON_PACKED_LEN(t)			((t)->info & JSON_PACKED_MAX_LEN)
+/* Next sibling is t + JSON_PACKED_SKIP(t) */
+#define JSON_PACKED_SKIP(t)			(JSON_PACKED_IS_CONTAINER(t) ? JSON_PACKED_LEN(t) : 1)
+#define JSON_PACKED_IS_ESCAPED(t)	(((t)->info & JSON_PACKED_ESCAPED) != 0)
+
 /**
  * JSON parser. Contains an array of token blocks available. Also stores
- * the string being parsed now and current position in that string
+ * the string being parsed now and current position in that string.
+ * Open containers are kept on a stack, so a closing bracket resolves its
+ * token in O(1) instead of scanning back through the tokens.
  */
+#define JSON_MAX_DEPTH				64
+
 typedef struct
 {
     unsigned int pos; /* offset in the JSON string */
     unsigned int toknext; /* next token to allocate */
     int toksuper; /* superior token node, e.g parent object or array */
+    int depth; /* number of open containers */
+    int stack[JSON_MAX_DEPTH]; /* open container tokens, innermost last */
+    JsonErrorCode errcode; /* why the last parse failed */
+    unsigned int errpos; /* offset of the failing byte */
+    int stream; /* input may continue : the end of the data is not the end of a value */
+    int partial; /* JSON_PARTIAL_xxx, value cut by the end of the data */
+    unsigned int partStart; /* start of the cut string or primitive */
+    int partHi; /* the cut string may hold bytes of 0x80 and up */
+    int partEsc; /* the cut string holds an escape */
 } JsonParser;
 
+#define JSON_PARTIAL_NONE			0
+#define JSON_PARTIAL_STRING			1
+#define JSON_PARTIAL_PRIMITIVE		2
+
+/**
+ * Key index of one parsed document.
+ * Every object key is hashed once after json_parseJson(); a lookup walks
+ * only the keys with the same hash and compares the span in place, so the
+ * getters never copy a token and never rescan the token array.
+ * A chain is kept in document order, which lets a lookup stop at the first
+ * key past the end of the object it is scoped to.
+ */
+#define JSON_KEY_BUCKET				256		// power of 2
+
+typedef struct
+{
+    unsigned int hash;
+    int keyIdx; /* token of the key */
+    int next; /* next entry with the same bucket, -1 at the end */
+} JsonKeyEntry;
+
+typedef struct
+{
+    const char *js;
+    JsonToken *tokens;
+    int tokenNum;
+    int entryNum;
+    int entryCap; /* grows with the documents, 0 : nothing allocated yet */
+    int bucket[JSON_KEY_BUCKET];
+    JsonKeyEntry *entry;
+} JsonKeyIndex;
+
+/**
+ * View of a token subtree in the original token array.
+ * Walking a view never copies the JSON text nor parses it again: the first
+ * child is the next token and a sibling is reached by jumping over the
+ * subtree with JsonToken.skip.
+ * @param       js      JSON data string
+ * @param       tok     token of the view, NULL if the view is empty
+ * @param       end     end of the enclosing subtree ( sibling bound )
+ */
+typedef struct
+{
+    const char *js;
+    JsonToken *tok;
+    JsonToken *end;
+} JsonView;
+
+/**
+ * Enumerated string values interned into integer codes.
+ * The names of a table come from an X-macro list ( see SCS_MON_TYPE_LIST ),
+ * the code of a name is its rank in the list. A value is looked up through
+ * a perfect hash of the names, built on first use like the field tables,
+ * then one compare ignoring the case; later comparisons are integer compares.
+ */
+#define JSON_ENUM_SLOT				32		// power of 2, at least twice the names
+
+typedef struct
+{
+    const char *name;
+    const char *const *names;
+    int nameNum;
+    int ready; /* perfect hash built */
+    unsigned char nameLen[JSON_ENUM_SLOT / 2];
+    unsigned int seed;
+    unsigned int mask;
+    unsigned char slot[JSON_ENUM_SLOT]; /* code + 1, 0 : no name */
+} JsonEnum;
+
+/**
+ * Declarative binding of a C struct to a JSON object.
+ * A field table is generated from an X-macro list ( see SCS_VALIDITY_FIELDS ),
+ * one entry per key : where the value lands in the struct, how long it may
+ * be and whether the object is invalid without it. json_decodeObject() walks
+ * the members once and dispatches every key through a perfect hash of the
+ * table, so each key costs one hash and one memcmp.
+ */
+typedef enum
+{
+    JSON_FT_STRING,         // char[maxLen+1]
+    JSON_FT_INT,            // int, a primitive or a quoted number
+    JSON_FT_BITMASK,        // int, "1111100" -> 0x7c
+    JSON_FT_TIME,           // char[maxLen+1] and the time_t at countOffset, "2016-06-23T09:00:00"
+    JSON_FT_OBJECT,         // nested struct described by sub
+    JSON_FT_STRING_ARRAY,   // char[maxItem][maxLen+1] with an int count
+    JSON_FT_OBJECT_ARRAY,   // struct[maxItem] described by sub with an int count
+    JSON_FT_ENUM,           // int, code of the name in names
+    JSON_FT_ENUM_ARRAY      // int[maxItem] codes with an int count
+} JsonFieldType;
+
+#define JSON_FIELD_OPTIONAL			0x00
+#define JSON_FIELD_REQUIRED			0x01	// missing key or empty array fails the decode
+
+#define JSON_BIND_MAX_FIELD			32		// one bit per field in the seen mask
+#define JSON_BIND_SLOT				64		// power of 2, at least twice the fields
+
+struct JsonBinding;
+
+typedef struct
+{
+    const char *key;
+    int keyLen;
+    JsonFieldType type;
+    int flag;
+    size_t offset; /* of the member in the struct */
+    int maxLen; /* longest string accepted */
+    int maxItem; /* array capacity */
+    size_t elemSize; /* array element stride */
+    size_t countOffset; /* of the int receiving the element number, of the time_t of a TIME */
+    struct JsonBinding *sub; /* binding of a nested object */
+    JsonEnum *names; /* names of an ENUM kind */
+} JsonFieldDesc;
+
+typedef struct JsonBinding
+{
+    const char *name;
+    const JsonFieldDesc *field;
+    int fieldNum;
+    size_t structSize;
+    int ready; /* perfect hash built */
+    unsigned int seed;
+    unsigned int mask;
+    unsigned char slot[JSON_BIND_SLOT]; /* field index + 1, 0 : no key */
+} JsonBinding;
+
+/**
+ * Parse context, one per thread ( see json_getContext() ).
+ * The token arena doubles whenever a document does not fit and is kept for
+ * the next one; starting a document only resets the counters, nothing is
+ * zeroed. tokenNum is the number of valid tokens, the tokens carry no end
+ * marker ( a subtree holds tokens[0].skip tokens ).
+ * scratch is the work buffer of the thread ( a message being built or read )
+ * in place of big stack arrays, it grows the same way and is kept too.
+ */
+#define JSON_ARENA_MIN_TOKEN		128
+#define JSON_SCRATCH_MIN			4096
+
+typedef struct
+{
+    JsonParser parser;
+    JsonToken *tokens;
+    unsigned int tokenCap;
+    unsigned int tokenNum;
+    JsonKeyIndex index;
+    char *scratch;
+    size_t scratchCap;
+} JsonContext;
+
+/**
+ * Incremental parse of a document arriving in chunks ( e.g. TCP reads ).
+ * Chunks are appended to buf, which grows but is never compacted during a
+ * document, so token offsets stay valid and the getters work on buf as on
+ * any other JSON string. Every feed scans only the new bytes : a string or
+ * primitive cut by the end of a chunk is continued, not scanned again.
+ */
+#define JSON_STREAM_MIN_BUF			4096
+
+typedef struct
+{
+    JsonContext ctx;
+    char *buf; /* the document so far, NUL terminated */
+    unsigned int len;
+    unsigned int cap;
+} JsonStream;
+
+/**
+ * Streaming JSON writer.
+ * Output goes to buffers supplied by the caller; when one is full the
+ * writer moves on to the next one of the chain, nothing is allocated. The
+ * written bytes are described by an iovec array ready for writev(), and
+ * long values that need no escaping can be referenced in place instead of
+ * being copied ( json_writeStringRef() ).
+ */
+#define JSON_WRITER_MAX_SEG			8
+#define JSON_WRITER_MAX_IOV			64
+
+typedef struct
+{
+    char *seg[JSON_WRITER_MAX_SEG]; /* buffer chain */
+    size_t segSize[JSON_WRITER_MAX_SEG];
+    int segNum;
+    int cur; /* buffer being filled */
+    char *ptr; /* next byte of the current buffer */
+    char *end;
+    char *mark; /* start of the bytes not in iov yet */
+    struct iovec iov[JSON_WRITER_MAX_IOV];
+    int iovNum;
+    size_t total; /* bytes in iov */
+    int depth;
+    unsigned char first[JSON_MAX_DEPTH]; /* container has no member yet */
+    unsigned char object[JSON_MAX_DEPTH]; /* container is an object */
+    int error; /* out of buffer, out of iovec or misnested, sticky */
+} JsonWriter;
+
+/**
+ * Edits of a parsed document, emitted over its original text.
+ * Every edit replaces a byte span of the text by a fragment : a replaced
+ * value spans its token ( quotes included ), a deleted member spans its key,
+ * its value and one comma, an insert is an empty span before the closing
+ * bracket. Fragments are copied into the buffer given by the caller.
+ * json_finishPatch() orders the edits and describes the result by an iovec
+ * alternating untouched runs of the text with the fragments, so forwarding
+ * a document costs the edited bytes only.
+ */
+#define JSON_PATCH_MAX_EDIT			32
+#define JSON_PATCH_MAX_IOV			(JSON_PATCH_MAX_EDIT * 2 + 1)
+
+#define JSON_PATCH_REPLACE			0
+#define JSON_PATCH_DELETE			1
+#define JSON_PATCH_INSERT			2
+
+typedef struct
+{
+    int kind; /* JSON_PATCH_xxx */
+    unsigned int start; /* span of the text replaced */
+    unsigned int end;
+    unsigned int fragOff; /* fragment in buf, an insert has a leading comma */
+    unsigned int fragLen;
+    const JsonToken *parent; /* container of a deleted or inserted member */
+    const JsonToken *tok; /* value replaced or deleted */
+    JsonView next; /* value after a deleted one */
+    unsigned int prevEnd; /* end of the value before a deleted one, 0 if first */
+} JsonPatchEdit;
+
+typedef struct
+{
+    const char *js;
+    unsigned int len;
+    char *buf; /* fragments */
+    size_t size;
+    size_t used;
+    JsonPatchEdit edit[JSON_PATCH_MAX_EDIT];
+    int editNum;
+    struct iovec iov[JSON_PATCH_MAX_IOV];
+    int iovNum;
+    size_t total; /* bytes in iov */
+    int error; /* out of buffer or of edits, bad view or overlapping edits, sticky */
+} JsonPatch;
+
+/**
+ * Binary form of a parsed document, for internal hops ( CBOR like ).
+ *   header  "JB", version, 0, then node count and total size ( 4 bytes each )
+ *   table   offset of every node from the start ( 4 bytes each ), node i is token i
+ *   nodes   a tag : type in the 3 high bits, length in the 5 low bits, or
+ *           24/25/26 when 1/2/4 length bytes follow, then by type
+ *             string, number  the bytes of the JSON text ( escapes kept )
+ *             int             length bytes, two's complement
+ *             array, object   elements count ( object : members ), then 4 bytes
+ *                             with the nodes of the subtree ( JsonToken.skip )
+ *             bool            the value is the length, nothing follows
+ * Every number is little endian. A reader gets to any node through the table
+ * and over a subtree by its node count, nothing is tokenized.
+ */
+#define JSON_BIN_VERSION			1
+#define JSON_BIN_HEAD_LEN			12
+
+#define JSON_BIN_NULL				0
+#define JSON_BIN_BOOL				1
+#define JSON_BIN_INT				2
+#define JSON_BIN_NUMBER				3
+#define JSON_BIN_STRING				4
+#define JSON_BIN_ARRAY				5
+#define JSON_BIN_OBJECT				6
+
+#define JSON_BIN_PUT32(p, v) \
+    ((p)[0] = (unsigned char)(v), (p)[1] = (unsigned char)((v) >> 8), \
+     (p)[2] = (unsigned char)((v) >> 16), (p)[3] = (unsigned char)((v) >> 24))
+#define JSON_BIN_GET32(p) \
+    ((unsigned int)(p)[0] | ((unsigned int)(p)[1] << 8) | ((unsigned int)(p)[2] << 16) | ((unsigned int)(p)[3] << 24))
+
+typedef struct
+{
+    const unsigned char *buf;
+    unsigned int len;
+    unsigned int nodeNum;
+} JsonBin;
+
+/**
+ * Node of a binary document, like JsonView for tokens
+ * @param       node    index of the node, empty view when node >= end
+ * @param       end     end of the enclosing subtree ( sibling bound )
+ */
+typedef struct
+{
+    const JsonBin *bin;
+    unsigned int node;
+    unsigned int end;
+} JsonBinView;
+
+/**
+ * Batch parse of newline delimited documents ( e.g. a mmap'd replay file ).
+ * The buffer is cut into chunks at line boundaries and the chunks are
+ * handed to a pool of threads, each parsing with its own context. A
+ * document starts at the first '{' or '[' of its line, so prefixed records
+ * like "0|0|...|{...}" are accepted as they are.
+ * decode runs in the worker that parsed the document, with its tokens, and
+ * stores what it needs in a result of resultSize bytes. With
+ * JSON_BATCH_ORDERED deliver gets the results one call at a time in line
+ * order, otherwise each worker delivers its own results as it goes.
+ */
+#define JSON_BATCH_CHUNK			(256 * 1024)	// bytes handed to a worker at once
+#define JSON_BATCH_WINDOW			4				// chunks in flight per thread when ordered
+#define JSON_BATCH_MAX_THREAD		64
+
+#define JSON_BATCH_UNORDERED		0x00
+#define JSON_BATCH_ORDERED			0x01
+
+typedef struct
+{
+    const char *line; /* whole line, without the '\n' */
+    unsigned int lineLen;
+    size_t offset; /* of the line in the buffer */
+    const char *js; /* document part of the line */
+    unsigned int len;
+    JsonError r; /* parse result */
+    JsonToken *tokens; /* NULL out of decode */
+    int tokenNum;
+} JsonBatchDoc;
+
+typedef int (*JsonBatchDecodeFunc)(void *arg, const JsonBatchDoc *doc, void *result);
+typedef void (*JsonBatchDeliverFunc)(void *arg, const JsonBatchDoc *doc, void *result, int rc);
+
+struct JsonBatchSlot;
+
+typedef struct
+{
+    JsonBatchDecodeFunc decode;
+    JsonBatchDeliverFunc deliver;
+    void *arg;
+    size_t resultSize;
+    int threadNum; /* 0 : one per online CPU */
+    int flag; /* JSON_BATCH_xxx */
+
+    /* Run state */
+    const char *buf;
+    size_t len;
+    long chunkNum;
+    long nextChunk; /* next chunk to hand out */
+    long nextDeliver; /* next chunk to deliver when ordered */
+    int delivering; /* a worker is delivering */
+    int windowNum;
+    struct JsonBatchSlot *slot; /* windowNum chunks waiting for delivery */
+    long docNum;
+    long errorNum; /* documents that did not parse */
+    int error; /* out of memory */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} JsonBatch;
+
+/**
+ * Pull iterator over the elements of a top level array ( e.g. a bulk export
+ * of monitoring subscriptions ), read from a file descriptor or from a buffer
+ * such as a mmap of the file. Every element is delimited by a bracket scan
+ * and tokenized alone into the context of the iterator, so the arena and the
+ * read window follow the largest element, not the document. The window is
+ * compacted before every read and grows only for an element longer than
+ * itself. An element returned stays valid until the next call.
+ */
+#define JSON_ARRAY_MIN_BUF			(64 * 1024)
+#define JSON_ARRAY_MAX_WINDOW		0x7fffffff		// token offsets are int
+
+#define JSON_ARRAY_START			0	// before '['
+#define JSON_ARRAY_FIRST			1	// after '[' : a value or ']'
+#define JSON_ARRAY_NEXT				2	// after a value : ',' or ']'
+#define JSON_ARRAY_VALUE			3	// after ',' : a value
+#define JSON_ARRAY_DONE				4	// after ']' : blanks only
+
+typedef struct
+{
+    JsonContext ctx; /* tokens of the current element */
+    int fd; /* -1 : the input is map */
+    const char *map;
+    size_t mapLen;
+    int mapOwned; /* mmap of json_openArrayFile(), unmapped on close */
+    size_t released; /* pages of map before it are given back */
+    char *buf; /* read window of fd */
+    unsigned int cap;
+    int eof; /* fd has no more bytes */
+    const char *js; /* window : buf, or map from offset */
+    unsigned int len;
+    unsigned int pos; /* next byte of js to look at */
+    size_t offset; /* of js[0] in the document, errors are at offset + parser.errpos */
+    long index; /* of the current element, -1 before the first */
+    int state; /* JSON_ARRAY_xxx */
+} JsonArrayIter;
+
+/**
+ * Compiled JSON Pointer ( RFC 6901, "/cp:info/parameterSet/duration" ).
+ * The pointer is split once into steps : the unescaped key with its length
+ * and hash, and the array index when the step is a number. Evaluating it is
+ * a forward walk over the token array : members that do not match are
+ * skipped with their whole subtree.
+ * A path set merges the steps of many pointers into a tree, so the members
+ * of an object are visited once for all the pointers going through it.
+ */
+#define JSON_PATH_MAX_STEP			16
+#define JSON_PATH_MAX_TEXT			256		// unescaped keys of all the steps
+#define JSON_PATHSET_MAX_NODE		64		// one bit per node in the walk's found mask
+#define JSON_PATHSET_MAX_PATH		32
+#define JSON_PATHSET_HASH_MIN		4		// children from which a key is hashed before the compares
+
+typedef struct
+{
+    int keyOff; /* key in the text of the path or of the set */
+    int keyLen;
+    unsigned int hash;
+    int index; /* array index, -1 if the step is not a number */
+} JsonPathStep;
+
+typedef struct
+{
+    int stepNum;
+    JsonPathStep step[JSON_PATH_MAX_STEP];
+    char text[JSON_PATH_MAX_TEXT];
+} JsonPath;
+
+typedef struct
+{
+    JsonPathStep step; /* from the parent to this node */
+    int child; /* first child node, -1 if none */
+    int sibling; /* next child of the parent, -1 at the end */
+    int childNum;
+    int path; /* first path ending here, -1 if none */
+} JsonPathNode;
+
+typedef struct
+{
+    int nodeNum; /* node[0] is the root of the document */
+    int pathNum;
+    int textLen;
+    JsonPathNode node[JSON_PATHSET_MAX_NODE];
+    int samePath[JSON_PATHSET_MAX_PATH]; /* next path ending on the same node, -1 at the end */
+    char text[JSON_PATH_MAX_TEXT * 4];
+} JsonPathSet;
+
 /**
  * Create JSON parser over an array of tokens
  */
@@ -120,6 +761,151 @@ void json_initJsonParser(JsonParser *parser);
  */
 JsonError json_parseJson(JsonParser *parser, const char *js, JsonToken *tokens, unsigned int tokenNum);
 
+/**
+ * Same as json_parseJson() over the first len bytes of js
+ */
+JsonError json_parseJsonLen(JsonParser *parser, const char *js, unsigned int len, JsonToken *tokens, unsigned int tokenNum);
+
+/**
+ * Same as json_parseJsonLen() filling packed tokens
+ */
+JsonError json_parsePackedLen(JsonParser *parser, const char *js, unsigned int len, JsonPackedToken *tokens, unsigned int tokenNum);
+int json_packedEnd(const char *js, const JsonPackedToken *tok);
+int json_packedSize(const JsonPackedToken *tok);
+const JsonPackedToken *json_packedMember(const char *js, const JsonPackedToken *obj, const char *key);
+
+/**
+ * Force the structural scanner ( "avx2", "sse2", "scalar" ), NULL picks the best one
+ */
+int json_setScanner(const char *name);
+const char *json_getScanner(void);
+
+/**
+ * Readable name of JsonParser.errcode
+ */
+const char *json_strerror(JsonErrorCode errcode);
+
+/**
+ * Build the key index of a parsed token array and make it the active one
+ */
+int json_buildKeyIndex(JsonKeyIndex *index, const char *js, JsonToken *tokens, int tokenNum);
+
+/**
+ * Deactivate and release a key index before its owner goes away
+ */
+void json_freeKeyIndex(JsonKeyIndex *index);
+
+/**
+ * Decode the members of obj into out as described by bind
+ */
+int json_decodeObject(JsonView obj, JsonBinding *bind, void *out);
+
+/**
+ * Decode the object under the resource name ( e.g. "nidd:info" ) of a parsed document
+ */
+int json_decodeResource(const char *js, JsonToken *tokens, int tokenNum, const char *name, JsonBinding *bind, void *out);
+
+/**
+ * Code of an enumerated name ( -1 if unknown ) and name of a code
+ */
+int json_enumCode(JsonEnum *tab, const char *str, int len);
+const char *json_enumName(const JsonEnum *tab, int code);
+int json_viewEnum(JsonView v, JsonEnum *tab, int *result);
+
+/**
+ * Parse context of the calling thread, and the one-shot parse over it
+ */
+JsonContext *json_getContext(void);
+char *json_contextScratch(JsonContext *ctx, size_t size);
+JsonError json_parseContext(JsonContext *ctx, const char *js, unsigned int len);
+void json_freeContext(JsonContext *ctx);
+
+/**
+ * Feed a document chunk by chunk : JSON_ERROR_PART until it is complete
+ */
+void json_initStream(JsonStream *st);
+JsonError json_feedStream(JsonStream *st, const char *chunk, unsigned int n);
+JsonError json_finishStream(JsonStream *st);
+void json_resetStream(JsonStream *st);
+void json_freeStream(JsonStream *st);
+
+/**
+ * Serialize JSON into caller buffers : key is NULL for array elements and for the top level
+ */
+void json_initWriter(JsonWriter *w, char *buf, size_t size);
+int json_addWriterBuffer(JsonWriter *w, char *buf, size_t size);
+int json_writeObjectStart(JsonWriter *w, const char *key);
+int json_writeObjectEnd(JsonWriter *w);
+int json_writeArrayStart(JsonWriter *w, const char *key);
+int json_writeArrayEnd(JsonWriter *w);
+int json_writeString(JsonWriter *w, const char *key, const char *str, size_t len);
+int json_writeStringRef(JsonWriter *w, const char *key, const char *str, size_t len);
+int json_writeInt(JsonWriter *w, const char *key, long long value);
+int json_writeBool(JsonWriter *w, const char *key, int value);
+int json_writeNull(JsonWriter *w, const char *key);
+struct iovec *json_finishWriter(JsonWriter *w, int *iovcnt, size_t *total);
+
+/**
+ * Edit a parsed document in place of re-serializing it
+ */
+void json_initPatch(JsonPatch *p, const char *js, unsigned int len, char *buf, size_t size);
+int json_patchReplace(JsonPatch *p, JsonView v, const char *text, size_t len);
+int json_patchReplaceString(JsonPatch *p, JsonView v, const char *str, size_t len);
+int json_patchReplaceInt(JsonPatch *p, JsonView v, long long value);
+int json_patchDelete(JsonPatch *p, JsonView parent, JsonView v);
+int json_patchInsert(JsonPatch *p, JsonView parent, const char *key, const char *text, size_t len);
+struct iovec *json_finishPatch(JsonPatch *p, int *iovcnt, size_t *total);
+
+/**
+ * Binary form of parsed tokens, read without a parse
+ */
+long json_encodeBin(const char *js, JsonToken *tokens, int tokenNum, unsigned char *out, size_t size);
+int json_openBin(JsonBin *bin, const unsigned char *buf, size_t len);
+JsonBinView json_binRoot(const JsonBin *bin);
+int json_binType(JsonBinView v);
+JsonBinView json_binChild(JsonBinView v);
+JsonBinView json_binNext(JsonBinView v);
+JsonBinView json_binMember(JsonBinView obj, const char *key);
+JsonBinView json_binAt(JsonBinView arr, int idx);
+int json_binCount(JsonBinView v);
+int json_binSpan(JsonBinView v, const char **ptr);
+int json_binString(JsonBinView v, char *result, int max_len);
+int json_binLong(JsonBinView v, long long *result);
+
+/**
+ * Parse newline delimited documents on a thread pool
+ */
+void json_initBatch(JsonBatch *b, JsonBatchDecodeFunc decode, JsonBatchDeliverFunc deliver, size_t resultSize, void *arg);
+long json_runBatch(JsonBatch *b, const char *buf, size_t len);
+long json_runBatchFile(JsonBatch *b, const char *path);
+
+/**
+ * Pull the elements of a top level array one at a time : 1, 0 past the last one, -1 on error
+ */
+void json_openArrayFd(JsonArrayIter *it, int fd);
+void json_openArrayBuffer(JsonArrayIter *it, const char *buf, size_t len);
+int json_openArrayFile(JsonArrayIter *it, const char *path);
+int json_nextArray(JsonArrayIter *it, JsonView *elem);
+void json_closeArray(JsonArrayIter *it);
+
+/**
+ * Compile JSON Pointers once and evaluate them on parsed tokens
+ */
+int json_compilePath(JsonPath *path, const char *pointer);
+JsonView json_viewPath(JsonView v, const JsonPath *path);
+void json_initPathSet(JsonPathSet *set);
+int json_addPath(JsonPathSet *set, const char *pointer);
+int json_viewPathSet(JsonView v, const JsonPathSet *set, JsonView *result);
+
+/**
+ * Tokenize only the values named by set, stopping once they are all found
+ */
+JsonError json_parseSelect(JsonContext *ctx, const JsonPathSet *set, const char *js, unsigned int len, JsonView *result);
+
+/* Index used by json_object_index_get(), NULL : plain token scan.
+ * Per thread, like the context it usually points into. */
+static __thread JsonKeyIndex *json_activeIndex = NULL;
+
 
 /**
  * @fn static JsonToken *json_allocJsonToken(JsonParser *parser, JsonToken *tokens, size_t tokenNum)
@@ -134,6 +920,8 @@ static JsonToken *json_allocJsonToken(JsonParser *parser, JsonToken *tokens, siz
     JsonToken *tok = &tokens[parser->toknext++];
     tok->start = tok->end = -1;
     tok->size = 0;
+    tok->skip = 1;
+    tok->flags = 0;
     #ifdef json_PARENT_LINKS
     tok->parent = -1;
     #endif
@@ -154,24 +942,78 @@ static void json_fillToken(JsonToken *token, JsonType type, int start, int end)
     token->start = start;
     token->end = end;
     token->size = 0;
+    token->flags = 0;
+}
+
+/**
+ * @fn static JsonError json_setError(JsonParser *parser, JsonError r, JsonErrorCode errcode, unsigned int errpos)
+ * @brief Records why and where the parse stopped.
+ * @param parser
+ * @param r
+ * @param errcode
+ * @param errpos
+ */
+static JsonError json_setError(JsonParser *parser, JsonError r, JsonErrorCode errcode, unsigned int errpos)
+{
+    parser->errcode = errcode;
+    parser->errpos = errpos;
+    return r;
+}
+
+/**
+ * @fn static JsonError json_addToken(JsonParser *parser, JsonToken *tokens, JsonPackedToken *packed, unsigned int num_tokens, JsonType type, int start, int end)
+ * @brief Appends a string or primitive to the packed tokens if any, to tokens otherwise.
+ * @param parser
+ * @param tokens
+ * @param packed
+ * @param num_tokens
+ * @param type
+ * @param start
+ * @param end
+ * @return JSON_ERROR_NOMEM without recording it, the caller knows the position
+ */
+static JsonError json_addToken(JsonParser *parser, JsonToken *tokens, JsonPackedToken *packed, unsigned int num_tokens, JsonType type, int start, int end)
+{
+    JsonToken *token;
+
+    if (packed != NULL)
+    {
+        if (parser->toknext >= num_tokens) return JSON_ERROR_NOMEM;
+        packed[parser->toknext].start = start;
+        packed[parser->toknext].info = ((unsigned int)type << JSON_PACKED_TYPE_SHIFT) | (unsigned int)(end - start);
+        parser->toknext++;
+        return JSON_SUCCESS;
+    }
+
+    token = json_allocJsonToken(parser, tokens, num_tokens);
+    if (!token) return JSON_ERROR_NOMEM;
+    json_fillToken(token, type, start, end);
+    #ifdef json_PARENT_LINKS
+    token->parent = parser->toksuper;
+    #endif
+    if (parser->toksuper != -1) tokens[parser->toksuper].size++;
+    return JSON_SUCCESS;
 }
 
 /**
- * @fn static JsonError json_parsePrimitive(JsonParser *parser, const char *js, JsonToken *tokens, size_t num_tokens)
+ * @fn static JsonError json_parsePrimitive(JsonParser *parser, const char *js, unsigned int len, JsonToken *tokens, JsonPackedToken *packed, unsigned int num_tokens)
  * @brief Fills next available token with JSON primitive.
  * @param parser
  * @param js
+ * @param len
  * @param tokens
+ * @param packed    NULL unless the packed tokens are filled
  * @param num_tokens
  */
-static JsonError json_parsePrimitive(JsonParser *parser, const char *js, JsonToken *tokens, size_t num_tokens)
+static JsonError json_parsePrimitive(JsonParser *parser, const char *js, unsigned int len, JsonToken *tokens, JsonPackedToken *packed, unsigned int num_tokens)
 {
-    JsonToken *token;
     int start;
 
-    start = parser->pos;
+    /* A primitive cut by the previous chunk goes on from parser->pos */
+    start = (parser->partial == JSON_PARTIAL_PRIMITIVE) ? parser->partStart : parser->pos;
+    parser->partial = JSON_PARTIAL_NONE;
 
-    for (; js[parser->pos] != '\0'; parser->pos++)
+    for (; parser->pos < len; parser->pos++)
     {
         switch (js[parser->pos]) 
         {
@@ -190,246 +1032,733 @@ static JsonError json_parsePrimitive(JsonParser *parser, const char *js, JsonTok
         }
         if (js[parser->pos] < 32 || js[parser->pos] >= 127)
         {
+            json_setError(parser, JSON_ERROR_INVAL, JSON_ERRC_BAD_CHAR, parser->pos);
             parser->pos = start;
             return JSON_ERROR_INVAL;
         }
     }
+    /* More input may follow : "12" can still become "1234" */
+    if (parser->stream)
+    {
+        parser->partial = JSON_PARTIAL_PRIMITIVE;
+        parser->partStart = start;
+        return json_setError(parser, JSON_ERROR_PART, JSON_ERRC_OPEN_PRIMITIVE, start);
+    }
     #ifdef json_STRICT
     /* In strict mode primitive must be followed by a comma/object/array */
+    json_setError(parser, JSON_ERROR_PART, JSON_ERRC_OPEN_PRIMITIVE, start);
     parser->pos = start;
     return JSON_ERROR_PART;
     #endif
 
     found:
-    token = json_allocJsonToken(parser, tokens, num_tokens);
-    if (!token)
+    if (json_addToken(parser, tokens, packed, num_tokens, JSON_PRIMITIVE, start, parser->pos) < 0)
     {
         parser->pos = start;
-        return JSON_ERROR_NOMEM;
+        return json_setError(parser, JSON_ERROR_NOMEM, JSON_ERRC_NO_TOKEN, start);
     }
-    json_fillToken(token, JSON_PRIMITIVE, start, parser->pos);
-    #ifdef json_PARENT_LINKS
-    token->parent = parser->toksuper;
-    #endif
     parser->pos--;
     return JSON_SUCCESS;
 }
 
 /**
- * @fn static JsonError json_parseString(JsonParser *parser, const char *js, JsonToken *tokens, size_t num_tokens)
- * @brief Fills next token with JSON string.
- * @param parser
- * @param js 
- * @param tokens
- * @param num_tokens
+ * @fn static int json_checkUtf8(const unsigned char *s, unsigned int len, unsigned int *bad)
+ * @brief RFC 3629 UTF-8 : no overlong form, no surrogate, nothing past U+10FFFF.
+ * @param s
+ * @param len
+ * @param bad       offset of the first byte of the invalid sequence
+ * @return 1, -1 if invalid
  */
-static JsonError json_parseString(JsonParser *parser, const char *js, JsonToken *tokens, size_t num_tokens)
+static int json_checkUtf8(const unsigned char *s, unsigned int len, unsigned int *bad)
 {
-    JsonToken *token;
-    int start = parser->pos;
-
-    parser->pos++;
+    unsigned int i = 0, n, k;
+    unsigned char c, lo, hi;
 
-    /* Skip starting quote */
-    for (; js[parser->pos] != '\0'; parser->pos++)
+    while (i < len)
     {
-        char c = js[parser->pos];
-
-        /* Quote: end of string */
-        if (c == '\"')
+        c = s[i];
+        if (c < 0x80) { i++; continue; }
+
+        /* Sequence length and the range of the second byte, which rules out the overlong forms */
+        lo = 0x80;
+        hi = 0xbf;
+        if (c >= 0xc2 && c <= 0xdf) n = 1;
+        else if (c >= 0xe0 && c <= 0xef)
         {
-            token = json_allocJsonToken(parser, tokens, num_tokens);
-            if (!token)
-            {
-                parser->pos = start;
-                return JSON_ERROR_NOMEM;
-            }
-            json_fillToken(token, JSON_STRING, start+1, parser->pos);
-            #ifdef json_PARENT_LINKS
-            token->parent = parser->toksuper;
-            #endif
-            return JSON_SUCCESS;
+            n = 2;
+            if (c == 0xe0) lo = 0xa0;
+            else if (c == 0xed) hi = 0x9f;
         }
-
-        /* Backslash: Quoted symbol expected */
-        if (c == '\\')
+        else if (c >= 0xf0 && c <= 0xf4)
         {
-            parser->pos++;
-            switch (js[parser->pos])
-            {
-                /* Allowed escaped symbols */
-                case '\"': 
-                case '/': 
-                case '\\': 
-                case 'b':
-                case 'f': 
-                case 'r': 
-                case 'n': 
-                case 't':
-                    break;
-                /* Allows escaped symbol \uXXXX */
-                case 'u':
-                    /// \todo handle JSON unescaped symbol \\uXXXX
-                    break;
-                /* Unexpected symbol */
-                default:
-                    parser->pos = start;
-                    return JSON_ERROR_INVAL;
-            }
+            n = 3;
+            if (c == 0xf0) lo = 0x90;
+            else if (c == 0xf4) hi = 0x8f;
         }
+        else goto invalid;
+
+        if (n >= len - i || s[i + 1] < lo || s[i + 1] > hi) goto invalid;
+        for (k = 2; k <= n; k++)
+            if ((s[i + k] & 0xc0) != 0x80) goto invalid;
+        i += n + 1;
     }
-    parser->pos = start;
-    return JSON_ERROR_PART;
-}
+    return 1;
+
+    invalid:
+    *bad = i;
+    return -1;
+}
 
 /**
- * @fn JsonError json_parseJson(JsonParser *parser, const char *js, JsonToken *tokens, unsigned int num_tokens) 
- * @brief Parse JSON string and fill tokens.
+ * Stage 1 : structural scan.
+ * A block of JSON_SCAN_BLOCK bytes is classified at once into one bit per
+ * byte, bit i standing for block[i]. Tokenizing ( stage 2 ) then jumps from
+ * set bit to set bit and never looks at the bytes in between, so string
+ * bodies and whitespace runs cost nothing past the classification.
+ * @param       quote   '"'
+ * @param       bs      '\\'
+ * @param       op      '{' '}' '[' ']'
+ * @param       sep     whitespace ':' ',' ( ends a primitive )
+ * @param       hi      bytes of 0x80 and up, a string without any is valid UTF-8
+ */
+#define JSON_SCAN_BLOCK				64
+
+typedef unsigned long long JsonBitmap;
+
+typedef struct
+{
+    JsonBitmap quote;
+    JsonBitmap bs;
+    JsonBitmap op;
+    JsonBitmap sep;
+    JsonBitmap hi;
+} JsonBlockMask;
+
+typedef void (*JsonClassifyFunc)(const char *block, JsonBlockMask *mask);
+
+#define JSON_CC_QUOTE				0x01
+#define JSON_CC_BS					0x02
+#define JSON_CC_OP					0x04
+#define JSON_CC_SEP					0x08
+
+static const unsigned char json_charClass[256] =
+{
+    ['"'] = JSON_CC_QUOTE, ['\\'] = JSON_CC_BS,
+    ['{'] = JSON_CC_OP, ['}'] = JSON_CC_OP, ['['] = JSON_CC_OP, [']'] = JSON_CC_OP,
+    [' '] = JSON_CC_SEP, ['\t'] = JSON_CC_SEP, ['\r'] = JSON_CC_SEP, ['\n'] = JSON_CC_SEP,
+    [':'] = JSON_CC_SEP, [','] = JSON_CC_SEP
+};
+
+/**
+ * @fn static void json_classifyScalar(const char *block, JsonBlockMask *mask)
+ * @brief Portable classification through json_charClass.
+ * @param block
+ * @param mask
+ */
+static void json_classifyScalar(const char *block, JsonBlockMask *mask)
+{
+    JsonBitmap quote = 0, bs = 0, op = 0, sep = 0, hi = 0;
+    unsigned int cls;
+    int i;
+
+    for (i = 0; i < JSON_SCAN_BLOCK; i++)
+    {
+        cls = json_charClass[(unsigned char)block[i]];
+        quote |= (JsonBitmap)(cls & JSON_CC_QUOTE) << i;
+        bs |= (JsonBitmap)((cls & JSON_CC_BS) >> 1) << i;
+        op |= (JsonBitmap)((cls & JSON_CC_OP) >> 2) << i;
+        sep |= (JsonBitmap)((cls & JSON_CC_SEP) >> 3) << i;
+        hi |= (JsonBitmap)((unsigned char)block[i] >> 7) << i;
+    }
+    mask->quote = quote;
+    mask->bs = bs;
+    mask->op = op;
+    mask->sep = sep;
+    mask->hi = hi;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/**
+ * @fn static void json_classifySse2(const char *block, JsonBlockMask *mask)
+ * @brief 16 bytes per compare. '[' and ']' differ from '{' and '}' by 0x20 only.
+ * @param block
+ * @param mask
+ */
+__attribute__((target("sse2")))
+static void json_classifySse2(const char *block, JsonBlockMask *mask)
+{
+    __m128i v, lo;
+    JsonBitmap quote = 0, bs = 0, op = 0, sep = 0, hi = 0;
+    int i;
+
+    for (i = 0; i < JSON_SCAN_BLOCK; i += 16)
+    {
+        v = _mm_loadu_si128((const __m128i *)(block + i));
+        lo = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        quote |= (JsonBitmap)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << i;
+        bs |= (JsonBitmap)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << i;
+        op |= (JsonBitmap)(unsigned int)_mm_movemask_epi8(_mm_or_si128(
+                _mm_cmpeq_epi8(lo, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lo, _mm_set1_epi8('}')))) << i;
+        sep |= (JsonBitmap)(unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')))),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))))) << i;
+        /* The sign bits are the bytes of 0x80 and up */
+        hi |= (JsonBitmap)(unsigned int)_mm_movemask_epi8(v) << i;
+    }
+    mask->quote = quote;
+    mask->bs = bs;
+    mask->op = op;
+    mask->sep = sep;
+    mask->hi = hi;
+}
+
+/**
+ * @fn static void json_classifyAvx2(const char *block, JsonBlockMask *mask)
+ * @brief Same as json_classifySse2() with 32 bytes per compare.
+ * @param block
+ * @param mask
+ */
+__attribute__((target("avx2")))
+static void json_classifyAvx2(const char *block, JsonBlockMask *mask)
+{
+    __m256i v, lo;
+    JsonBitmap quote = 0, bs = 0, op = 0, sep = 0, hi = 0;
+    int i;
+
+    for (i = 0; i < JSON_SCAN_BLOCK; i += 32)
+    {
+        v = _mm256_loadu_si256((const __m256i *)(block + i));
+        lo = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        quote |= (JsonBitmap)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << i;
+        bs |= (JsonBitmap)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << i;
+        op |= (JsonBitmap)(unsigned int)_mm256_movemask_epi8(_mm256_or_si256(
+                _mm256_cmpeq_epi8(lo, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lo, _mm256_set1_epi8('}')))) << i;
+        sep |= (JsonBitmap)(unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))))) << i;
+        hi |= (JsonBitmap)(unsigned int)_mm256_movemask_epi8(v) << i;
+    }
+    mask->quote = quote;
+    mask->bs = bs;
+    mask->op = op;
+    mask->sep = sep;
+    mask->hi = hi;
+}
+#endif
+
+/* Classifier picked on the first parse, see json_setScanner() */
+static JsonClassifyFunc json_classify = NULL;
+static const char *json_scannerName = NULL;
+static pthread_once_t json_scannerOnce = PTHREAD_ONCE_INIT;
+
+/* Tables shared by the threads ( bindings, enums ) are built once under
+ * json_initLock, their ready flag publishes them to the lock free readers */
+static pthread_mutex_t json_initLock = PTHREAD_MUTEX_INITIALIZER;
+
+#define JSON_IS_READY(flag)			__atomic_load_n(&(flag), __ATOMIC_ACQUIRE)
+#define JSON_SET_READY(flag)		__atomic_store_n(&(flag), 1, __ATOMIC_RELEASE)
+
+/**
+ * @fn int json_setScanner(const char *name)
+ * @brief Selects the stage 1 classifier : "avx2", "sse2", "scalar" or NULL for the best one the CPU runs.
+ *        Not thread safe : call it before the parsing threads start, or never.
+ * @param name
+ * @return 1 on success, -1 if the CPU or the build does not have it
+ */
+int json_setScanner(const char *name)
+{
+    #if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if ((name == NULL || strcmp(name, "avx2") == 0) && __builtin_cpu_supports("avx2"))
+    {
+        json_classify = json_classifyAvx2;
+        json_scannerName = "avx2";
+        return 1;
+    }
+    if ((name == NULL || strcmp(name, "sse2") == 0) && __builtin_cpu_supports("sse2"))
+    {
+        json_classify = json_classifySse2;
+        json_scannerName = "sse2";
+        return 1;
+    }
+    #endif
+    if (name == NULL || strcmp(name, "scalar") == 0)
+    {
+        json_classify = json_classifyScalar;
+        json_scannerName = "scalar";
+        return 1;
+    }
+    return -1;
+}
+
+/**
+ * @fn static void json_initScanner(void)
+ * @brief Best classifier, unless json_setScanner() picked one. Run once by the first parse.
+ */
+static void json_initScanner(void)
+{
+    if (json_classify == NULL) json_setScanner(NULL);
+}
+
+/**
+ * @fn const char *json_getScanner(void)
+ * @brief Name of the stage 1 classifier in use.
+ */
+const char *json_getScanner(void)
+{
+    pthread_once(&json_scannerOnce, json_initScanner);
+    return json_scannerName;
+}
+
+/**
+ * @fn static JsonError json_openContainer(JsonParser *parser, JsonToken *tokens, JsonPackedToken *packed, unsigned int num_tokens, char c)
+ * @brief Opens the object or array starting at parser->pos.
+ * @param parser
+ * @param tokens
+ * @param packed    NULL unless the packed tokens are filled
+ * @param num_tokens
+ * @param c
+ */
+static JsonError json_openContainer(JsonParser *parser, JsonToken *tokens, JsonPackedToken *packed, unsigned int num_tokens, char c)
+{
+    JsonToken *token;
+
+    if (packed != NULL)
+    {
+        /* Too deep is a bad document, not a short arena : checked first */
+        if (parser->depth >= JSON_MAX_DEPTH)
+            return json_setError(parser, JSON_ERROR_INVAL, JSON_ERRC_TOO_DEEP, parser->pos);
+        if (parser->toknext >= num_tokens)
+            return json_setError(parser, JSON_ERROR_NOMEM, JSON_ERRC_NO_TOKEN, parser->pos);
+        /* The subtree length is set when the container closes */
+        packed[parser->toknext].start = parser->pos;
+        packed[parser->toknext].info = ((unsigned int)(c == '{' ? JSON_OBJECT : JSON_ARRAY) << JSON_PACKED_TYPE_SHIFT) | 1;
+        parser->toksuper = parser->toknext++;
+        parser->stack[parser->depth++] = parser->toksuper;
+        return JSON_SUCCESS;
+    }
+
+    if (parser->depth >= JSON_MAX_DEPTH)
+        return json_setError(parser, JSON_ERROR_INVAL, JSON_ERRC_TOO_DEEP, parser->pos);
+    token = json_allocJsonToken(parser, tokens, num_tokens);
+    if (!token) return json_setError(parser, JSON_ERROR_NOMEM, JSON_ERRC_NO_TOKEN, parser->pos);
+    if (parser->toksuper != -1)
+    {
+        tokens[parser->toksuper].size++;
+        #ifdef json_PARENT_LINKS
+        token->parent = parser->toksuper;
+        #endif
+    }
+    token->type = (c == '{' ? JSON_OBJECT : JSON_ARRAY);
+    token->start = parser->pos;
+    parser->toksuper = parser->toknext - 1;
+    parser->stack[parser->depth++] = parser->toksuper;
+    return JSON_SUCCESS;
+}
+
+/**
+ * @fn static JsonError json_closeContainer(JsonParser *parser, JsonToken *tokens, JsonPackedToken *packed, char c)
+ * @brief Closes the innermost open container at parser->pos.
+ * @param parser
+ * @param tokens
+ * @param packed    NULL unless the packed tokens are filled
+ * @param c
+ */
+static JsonError json_closeContainer(JsonParser *parser, JsonToken *tokens, JsonPackedToken *packed, char c)
+{
+    JsonToken *token;
+    JsonPackedToken *ptok;
+    JsonType type;
+
+    type = (c == '}' ? JSON_OBJECT : JSON_ARRAY);
+    /* The innermost open container is the top of the stack */
+    if (parser->depth == 0)
+        return json_setError(parser, JSON_ERROR_INVAL, JSON_ERRC_UNMATCHED_CLOSE, parser->pos);
+    if (packed != NULL)
+    {
+        ptok = &packed[parser->stack[parser->depth - 1]];
+        if (JSON_PACKED_TYPE(ptok) != type)
+            return json_setError(parser, JSON_ERROR_INVAL, JSON_ERRC_MISMATCHED_CLOSE, parser->pos);
+        ptok->info = ((unsigned int)type << JSON_PACKED_TYPE_SHIFT) | (parser->toknext - parser->stack[parser->depth - 1]);
+        parser->depth--;
+        parser->toksuper = (parser->depth > 0) ? parser->stack[parser->depth - 1] : -1;
+        return JSON_SUCCESS;
+    }
+    token = &tokens[parser->stack[parser->depth - 1]];
+    if (token->type != type)
+        return json_setError(parser, JSON_ERROR_INVAL, JSON_ERRC_MISMATCHED_CLOSE, parser->pos);
+    token->end = parser->pos + 1;
+    token->skip = parser->toknext - parser->stack[parser->depth - 1];
+    parser->depth--;
+    parser->toksuper = (parser->depth > 0) ? parser->stack[parser->depth - 1] : -1;
+    return JSON_SUCCESS;
+}
+
+/**
+ * @fn static JsonError json_scanJson(JsonParser *parser, const char *js, unsigned int len, JsonToken *tokens, JsonPackedToken *packed, unsigned int num_tokens)
+ * @brief Tokenizes len bytes of JSON into tokens, or into packed when it is not NULL.
  * @param parser
  * @param js
+ * @param len
  * @param tokens
+ * @param packed
  * @param num_tokens
  */
-JsonError json_parseJson(JsonParser *parser, const char *js, JsonToken *tokens, unsigned int num_tokens) 
+static JsonError json_scanJson(JsonParser *parser, const char *js, unsigned int len, JsonToken *tokens, JsonPackedToken *packed, unsigned int num_tokens)
 {
     JsonError r;
-    int i;
-    JsonToken *token;
+    JsonBlockMask mask;
+    JsonBitmap primStart, scalar, prevScalar, bits;
+    char pad[JSON_SCAN_BLOCK];
+    const char *block;
+    unsigned int base, next, p, from, strStart = 0;
+    int inString = 0, strHi = 0, strEsc = 0;
+    char c;
+
+    pthread_once(&json_scannerOnce, json_initScanner);
+
+    /* Continue a value cut by the end of the previous chunk */
+    if (parser->partial == JSON_PARTIAL_STRING)
+    {
+        inString = 1;
+        strStart = parser->partStart;
+        strHi = parser->partHi;
+        strEsc = parser->partEsc;
+        parser->partial = JSON_PARTIAL_NONE;
+    }
+    else if (parser->partial == JSON_PARTIAL_PRIMITIVE)
+    {
+        r = json_parsePrimitive(parser, js, len, tokens, packed, num_tokens);
+        if (r < 0) return r;
+        parser->pos++;
+    }
 
-    for (; js[parser->pos] != '\0'; parser->pos++)
+    prevScalar = 0;
+    next = parser->pos;
+    for (base = parser->pos; base < len; base += JSON_SCAN_BLOCK)
     {
-        char c;
-        JsonType type;
+        /* The last block is padded with blanks, they never raise a bit */
+        block = js + base;
+        if (len - base < JSON_SCAN_BLOCK)
+        {
+            memset(pad, ' ', sizeof(pad));
+            memcpy(pad, block, len - base);
+            block = pad;
+        }
+        json_classify(block, &mask);
 
-        c = js[parser->pos];
-        switch (c)
+        /* A primitive starts at any byte that is not structural and follows one that is */
+        scalar = ~(mask.quote | mask.op | mask.sep);
+        primStart = scalar & ~((scalar << 1) | prevScalar);
+        prevScalar = scalar >> (JSON_SCAN_BLOCK - 1);
+
+        /* Stage 2 : one event per set bit, inside a string only quotes and escapes count */
+        if (next < base) next = base;
+        while (next < base + JSON_SCAN_BLOCK)
         {
-            case '{':
-            case '[':
-                token = json_allocJsonToken(parser, tokens, num_tokens);
-                if (!token) return JSON_ERROR_NOMEM;
-                if (parser->toksuper != -1)
-                {
-                    tokens[parser->toksuper].size++;
-                    #ifdef json_PARENT_LINKS
-                    token->parent = parser->toksuper;
-                    #endif
-                }
-                token->type = (c == '{' ? JSON_OBJECT : JSON_ARRAY);
-                token->start = parser->pos;
-                parser->toksuper = parser->toknext - 1;
-                break;
-            case '}':
-            case ']':
-                type = (c == '}' ? JSON_OBJECT : JSON_ARRAY);
-                #ifdef json_PARENT_LINKS
-                if (parser->toknext < 1) {
-					puts("### 1 ###");
-					return JSON_ERROR_INVAL;
-				}
-                token = &tokens[parser->toknext - 1];
-                for (;;)
+            bits = inString ? (mask.quote | mask.bs) : (mask.op | mask.quote | primStart);
+            bits &= ~0ULL << (next - base);
+            if (bits == 0) break;
+
+            p = base + __builtin_ctzll(bits);
+            c = js[p];
+            parser->pos = p;
+            next = p + 1;
+
+            if (inString)
+            {
+                if (c == '\"')
                 {
-                    if (token->start != -1 && token->end == -1)
+                    /* Only a string with bytes of 0x80 and up is decoded as UTF-8 */
+                    from = (strStart + 1 > base) ? strStart + 1 - base : 0;
+                    strHi |= (mask.hi & (~0ULL << from) & ((1ULL << (p - base)) - 1)) != 0;
+                    if (strHi && json_checkUtf8((const unsigned char *)js + strStart + 1, p - strStart - 1, &from) < 0)
                     {
-                        if (token->type != type) {
-							puts("### 2 ###");
-							return JSON_ERROR_INVAL;
-						}
-                        token->end = parser->pos + 1;
-                        parser->toksuper = token->parent;
-                        break;
+                        parser->pos = strStart;
+                        return json_setError(parser, JSON_ERROR_INVAL, JSON_ERRC_BAD_UTF8, strStart + 1 + from);
                     }
-                    if (token->parent == -1) break;
-                    token = &tokens[token->parent];
-                }
-                #else
-                for (i = parser->toknext - 1; i >= 0; i--)
-                {
-                    token = &tokens[i];
-                    if (token->start != -1 && token->end == -1)
+                    if (json_addToken(parser, tokens, packed, num_tokens, JSON_STRING, strStart + 1, p) < 0)
                     {
-                        if (token->type != type) {
-							puts("### 3 ###");
-							return JSON_ERROR_INVAL;
-						}
-                        parser->toksuper = -1;
-                        token->end = parser->pos + 1;
-                        break;
+                        parser->pos = strStart;
+                        return json_setError(parser, JSON_ERROR_NOMEM, JSON_ERRC_NO_TOKEN, strStart);
+                    }
+                    if (strEsc)
+                    {
+                        if (packed != NULL) packed[parser->toknext - 1].info |= JSON_PACKED_ESCAPED;
+                        else tokens[parser->toknext - 1].flags |= JSON_STRING_ESCAPED;
                     }
+                    inString = 0;
+                    continue;
                 }
-                /* Error if unmatched closing bracket */
-                if (i == -1) {
-					puts("### 4 ###");
-					return JSON_ERROR_INVAL;
-				}
-                for (; i >= 0; i--)
+
+                strEsc = 1;
+
+                /* The escaped byte is in the next chunk, scan the backslash again */
+                if (p + 1 >= len && parser->stream)
                 {
-                    token = &tokens[i];
-                    if (token->start != -1 && token->end == -1)
-                    {
-                        parser->toksuper = i;
+                    next = p;
+                    goto partial;
+                }
+
+                /* Backslash: Quoted symbol expected, the escaped byte is skipped */
+                switch (p + 1 < len ? js[p + 1] : '\0')
+                {
+                    /* Allowed escaped symbols */
+                    case '\"': 
+                    case '/': 
+                    case '\\': 
+                    case 'b':
+                    case 'f': 
+                    case 'r': 
+                    case 'n': 
+                    case 't':
+                    /* \uXXXX, its digits are checked by json_spanUnescape() */
+                    case 'u':
+                        next = p + 2;
                         break;
-                    }
+                    /* Unexpected symbol */
+                    default:
+                        json_setError(parser, JSON_ERROR_INVAL, JSON_ERRC_BAD_ESCAPE, p);
+                        parser->pos = strStart;
+                        return JSON_ERROR_INVAL;
                 }
+                continue;
+            }
+
+            switch (c)
+            {
+                case '{':
+                case '[':
+                    r = json_openContainer(parser, tokens, packed, num_tokens, c);
+                    if (r < 0) return r;
+                    break;
+                case '}':
+                case ']':
+                    r = json_closeContainer(parser, tokens, packed, c);
+                    if (r < 0) return r;
+                    break;
+                case '\"':
+                    inString = 1;
+                    strStart = p;
+                    strHi = strEsc = 0;
+                    break;
+                #ifdef json_STRICT
+                /* In strict mode primitives are: numbers and booleans */
+                case '-':
+                case '0':
+                case '1':
+                case '2':
+                case '3':
+                case '4':
+                case '5':
+                case '6':
+                case '7':
+                case '8':
+                case '9':
+                case 't':
+                case 'f':
+                case 'n':
+                #else
+                /* In non-strict mode every unquoted value is a primitive */
+                default:
                 #endif
-                break;
-            case '\"':
-                r = json_parseString(parser, js, tokens, num_tokens);
-                if (r < 0) return r;
-                if (parser->toksuper != -1) tokens[parser->toksuper].size++;
-                break;
-            case '\t':
-            case '\r':
-            case '\n':
-            case ':':
-            case ',':
-            case ' ': 
-                break;
-            #ifdef json_STRICT
-            /* In strict mode primitives are: numbers and booleans */
-            case '-':
-            case '0':
-            case '1':
-            case '2':
-            case '3':
-            case '4':
-            case '5':
-            case '6':
-            case '7':
-            case '8':
-            case '9':
-            case 't':
-            case 'f':
-            case 'n':
-            #else
-            /* In non-strict mode every unquoted value is a primitive */
-            default:
-            #endif
-                r = json_parsePrimitive(parser, js, tokens, num_tokens);
-                if (r < 0) return r;
-                if (parser->toksuper != -1) tokens[parser->toksuper].size++;
-                break;
+                    r = json_parsePrimitive(parser, js, len, tokens, packed, num_tokens);
+                    if (r < 0) return r;
+                    /* Bits inside the primitive ( e.g. a '{' in non-strict mode ) are stale */
+                    next = parser->pos + 1;
+                    break;
 
-            #ifdef json_STRICT
-            /* Unexpected char in strict mode */
-            default:
-				puts("### 5 ###");
-                return JSON_ERROR_INVAL;
-            #endif
+                #ifdef json_STRICT
+                /* Unexpected char in strict mode */
+                default:
+                    return json_setError(parser, JSON_ERROR_INVAL, JSON_ERRC_UNEXPECTED_CHAR, parser->pos);
+                #endif
+            }
+        }
 
+        /* A string going on in the next block keeps what this one held */
+        if (inString)
+        {
+            from = (strStart + 1 > base) ? strStart + 1 - base : 0;
+            if (from < JSON_SCAN_BLOCK) strHi |= (mask.hi >> from) != 0;
         }
     }
 
-    for (i = parser->toknext - 1; i >= 0; i--)
+    next = len;
+    partial:
+    if (inString)
     {
-        /* Unmatched opened object or array */
-        if (tokens[i].start != -1 && tokens[i].end == -1) return JSON_ERROR_PART;
+        if (parser->stream)
+        {
+            parser->partial = JSON_PARTIAL_STRING;
+            parser->partStart = strStart;
+            /* Cut inside a block, its high bytes were not folded in : check the whole string */
+            parser->partHi = strHi || next < len;
+            parser->partEsc = strEsc;
+            parser->pos = next;
+            return json_setError(parser, JSON_ERROR_PART, JSON_ERRC_OPEN_STRING, strStart);
+        }
+        parser->pos = strStart;
+        return json_setError(parser, JSON_ERROR_PART, JSON_ERRC_OPEN_STRING, strStart);
     }
+    parser->pos = len;
+
+    /* Unmatched opened object or array */
+    if (parser->depth > 0)
+        return json_setError(parser, JSON_ERROR_PART, JSON_ERRC_OPEN_CONTAINER,
+                             packed != NULL ? (int)packed[parser->stack[parser->depth - 1]].start : tokens[parser->stack[parser->depth - 1]].start);
 
     return JSON_SUCCESS;
 }
 
+/**
+ * @fn JsonError json_parseJsonLen(JsonParser *parser, const char *js, unsigned int len, JsonToken *tokens, unsigned int num_tokens)
+ * @brief Parse len bytes of JSON and fill tokens, js does not have to be NUL terminated.
+ * @param parser
+ * @param js
+ * @param len
+ * @param tokens
+ * @param num_tokens
+ */
+JsonError json_parseJsonLen(JsonParser *parser, const char *js, unsigned int len, JsonToken *tokens, unsigned int num_tokens)
+{
+    /* The tokens are being rewritten, the old index is stale */
+    if (json_activeIndex != NULL && json_activeIndex->tokens == tokens)
+        json_activeIndex = NULL;
+
+    return json_scanJson(parser, js, len, tokens, NULL, num_tokens);
+}
+
+/**
+ * @fn JsonError json_parsePackedLen(JsonParser *parser, const char *js, unsigned int len, JsonPackedToken *tokens, unsigned int num_tokens)
+ * @brief Like json_parseJsonLen() with 8 bytes tokens, see JsonPackedToken.
+ * @param parser
+ * @param js
+ * @param len       at most JSON_PACKED_MAX_LEN
+ * @param tokens
+ * @param num_tokens
+ */
+JsonError json_parsePackedLen(JsonParser *parser, const char *js, unsigned int len, JsonPackedToken *tokens, unsigned int num_tokens)
+{
+    if (len > JSON_PACKED_MAX_LEN)
+        return json_setError(parser, JSON_ERROR_INVAL, JSON_ERRC_TOO_LONG, JSON_PACKED_MAX_LEN);
+
+    return json_scanJson(parser, js, len, NULL, tokens, num_tokens);
+}
+
+/**
+ * @fn int json_packedEnd(const char *js, const JsonPackedToken *tok)
+ * @brief End position of a packed token, like JsonToken.end.
+ * The end of a container is found from its last token : only blanks and the
+ * brackets of the containers closing there follow it. The subtree is read
+ * once, use it to cut a raw value rather than in a walk.
+ * @param js
+ * @param tok
+ */
+int json_packedEnd(const char *js, const JsonPackedToken *tok)
+{
+    const JsonPackedToken *last, *t;
+    unsigned int pos;
+    int open = 0;
+
+    if (!JSON_PACKED_IS_CONTAINER(tok)) return tok->start + JSON_PACKED_LEN(tok);
+
+    /* Containers of the subtree closing right after last, last included */
+    last = tok + JSON_PACKED_LEN(tok) - 1;
+    for (t = tok; t <= last; t++)
+        if (JSON_PACKED_IS_CONTAINER(t) && t + JSON_PACKED_LEN(t) - 1 == last) open++;
+
+    if (JSON_PACKED_IS_CONTAINER(last)) pos = last->start + 1;
+    else pos = last->start + JSON_PACKED_LEN(last) + (JSON_PACKED_TYPE(last) == JSON_STRING);
+
+    for (; open > 0; pos++)
+        if (js[pos] == '}' || js[pos] == ']') open--;
+    return pos;
+}
+
+/**
+ * @fn int json_packedSize(const JsonPackedToken *tok)
+ * @brief Children of a packed container like JsonToken.size, an object counts keys and values.
+ * @param tok
+ */
+int json_packedSize(const JsonPackedToken *tok)
+{
+    unsigned int i, skip;
+    int n = 0;
+
+    if (!JSON_PACKED_IS_CONTAINER(tok)) return 0;
+
+    skip = JSON_PACKED_LEN(tok);
+    for (i = 1; i < skip; i += JSON_PACKED_SKIP(&tok[i])) n++;
+    return n;
+}
+
+/**
+ * @fn const JsonPackedToken *json_packedMember(const char *js, const JsonPackedToken *obj, const char *key)
+ * @brief Value of a direct member of a packed object, NULL if not found.
+ * @param js
+ * @param obj
+ * @param key
+ */
+const JsonPackedToken *json_packedMember(const char *js, const JsonPackedToken *obj, const char *key)
+{
+    const JsonPackedToken *k, *end;
+    unsigned int len = strlen(key);
+
+    if (JSON_PACKED_TYPE(obj) != JSON_OBJECT) return NULL;
+
+    end = obj + JSON_PACKED_LEN(obj);
+    for (k = obj + 1; k + 1 < end; k = k + 1 + JSON_PACKED_SKIP(k + 1))
+    {
+        if (JSON_PACKED_LEN(k) == len && !memcmp(&js[k->start], key, len)) return k + 1;
+    }
+    return NULL;
+}
+
+/**
+ * @fn JsonError json_parseJson(JsonParser *parser, const char *js, JsonToken *tokens, unsigned int num_tokens) 
+ * @brief Parse JSON string and fill tokens.
+ * @param parser
+ * @param js
+ * @param tokens
+ * @param num_tokens
+ */
+JsonError json_parseJson(JsonParser *parser, const char *js, JsonToken *tokens, unsigned int num_tokens) 
+{
+    return json_parseJsonLen(parser, js, strlen(js), tokens, num_tokens);
+}
+
+/**
+ * @fn const char *json_strerror(JsonErrorCode errcode)
+ * @brief Readable name of a parse error.
+ * @param errcode
+ */
+const char *json_strerror(JsonErrorCode errcode)
+{
+    switch (errcode)
+    {
+        case JSON_ERRC_NONE:                return "no error";
+        case JSON_ERRC_NO_TOKEN:            return "token array is full";
+        case JSON_ERRC_TOO_DEEP:            return "nesting is too deep";
+        case JSON_ERRC_UNMATCHED_CLOSE:     return "closing bracket without an open container";
+        case JSON_ERRC_MISMATCHED_CLOSE:    return "closing bracket does not match the open container";
+        case JSON_ERRC_BAD_ESCAPE:          return "invalid escape in a string";
+        case JSON_ERRC_BAD_CHAR:            return "invalid character in a primitive";
+        case JSON_ERRC_UNEXPECTED_CHAR:     return "unexpected character";
+        case JSON_ERRC_OPEN_STRING:         return "string is not terminated";
+        case JSON_ERRC_OPEN_PRIMITIVE:      return "primitive is not terminated";
+        case JSON_ERRC_OPEN_CONTAINER:      return "object or array is not closed";
+        case JSON_ERRC_TOO_LONG:            return "document is too long for packed tokens";
+        case JSON_ERRC_BAD_UTF8:            return "invalid UTF-8 in a string";
+        case JSON_ERRC_READ:                return "read of the input failed";
+    }
+    return "unknown error";
+}
+
 /**
  * @fn void json_initJsonParser(JsonParser *parser)
  * @brief Creates a new parser based over a given buffer with an array of tokens available.
@@ -440,642 +1769,4206 @@ void json_initJsonParser(JsonParser *parser)
     parser->pos = 0;
     parser->toknext = 0;
     parser->toksuper = -1;
+    parser->depth = 0;
+    parser->errcode = JSON_ERRC_NONE;
+    parser->errpos = 0;
+    parser->stream = 0;
+    parser->partial = JSON_PARTIAL_NONE;
+    parser->partStart = 0;
+    parser->partHi = 0;
+    parser->partEsc = 0;
 }
 
-int json_object_index_get(char *json_str, JsonToken *tokens, char *str)
+/* Context of each thread, the arena lives as long as the thread */
+static __thread JsonContext json_threadContext;
+
+/**
+ * @fn JsonContext *json_getContext(void)
+ * @brief Parse context of the calling thread.
+ */
+JsonContext *json_getContext(void)
 {
-    int i;
-    char    tmpStr[HTTPF_MSG_BUFSIZE];
+    return &json_threadContext;
+}
+
+/**
+ * @fn char *json_contextScratch(JsonContext *ctx, size_t size)
+ * @brief Work buffer of at least size bytes, valid until the next call on ctx.
+ *        The content is not kept when it grows.
+ * @param ctx
+ * @param size
+ * @return NULL if out of memory
+ */
+char *json_contextScratch(JsonContext *ctx, size_t size)
+{
+    size_t cap;
 
-    for (i=0; i < MAX_JSON_TOKEN_SIZE; i++) {
-        if (tokens[i].start == 0 && tokens[i].end == 0) break;
-        strncpy(tmpStr, &json_str[tokens[i].start], tokens[i].end - tokens[i].start);
-        tmpStr[tokens[i].end - tokens[i].start] = 0;
-        if (!strcmp(tmpStr, str)) return i;
+    if (size <= ctx->scratchCap) return ctx->scratch;
+
+    for (cap = ctx->scratchCap ? ctx->scratchCap : JSON_SCRATCH_MIN; cap < size; cap *= 2) ;
+    free(ctx->scratch);
+    if ((ctx->scratch = (char *)malloc(cap)) == NULL)
+    {
+        ctx->scratchCap = 0;
+        return NULL;
     }
+    ctx->scratchCap = cap;
+    return ctx->scratch;
+}
 
-    return -1;
+/**
+ * @fn static int json_growContext(JsonContext *ctx)
+ * @brief Doubles the token arena, the tokens already filled are kept.
+ * @param ctx
+ */
+static int json_growContext(JsonContext *ctx)
+{
+    JsonToken *tokens;
+    unsigned int cap;
+
+    cap = ctx->tokenCap ? ctx->tokenCap * 2 : JSON_ARENA_MIN_TOKEN;
+    tokens = (JsonToken *)realloc(ctx->tokens, sizeof(JsonToken) * cap);
+    if (tokens == NULL) return -1;
+
+    ctx->tokens = tokens;
+    ctx->tokenCap = cap;
+    return 1;
 }
 
-int get_int_from_json_new(char *json_str, JsonToken *tokens, char *key, int *result)
+/**
+ * @fn static JsonError json_runContext(JsonContext *ctx, const char *js, unsigned int len)
+ * @brief Runs the parser of ctx up to len, growing the arena on demand.
+ * @param ctx
+ * @param js
+ * @param len
+ */
+static JsonError json_runContext(JsonContext *ctx, const char *js, unsigned int len)
 {
-    int     i, length;
-    char    str_ptr[1024];
+    JsonError r;
+
+    if (ctx->tokens == NULL && json_growContext(ctx) < 0)
+        return json_setError(&ctx->parser, JSON_ERROR_NOMEM, JSON_ERRC_NO_TOKEN, 0);
+
+    /* A resumed run reports only its own failure */
+    ctx->parser.errcode = JSON_ERRC_NONE;
+    ctx->parser.errpos = 0;
+
+    /* Out of tokens : the parser stopped before the token it could not
+     * allocate, it resumes from there once the arena is larger */
+    while ((r = json_parseJsonLen(&ctx->parser, js, len, ctx->tokens, ctx->tokenCap)) == JSON_ERROR_NOMEM &&
+           ctx->parser.errcode == JSON_ERRC_NO_TOKEN)
+    {
+        if (json_growContext(ctx) < 0) break;
+        ctx->parser.errcode = JSON_ERRC_NONE;
+        ctx->parser.errpos = 0;
+    }
+
+    ctx->tokenNum = ctx->parser.toknext;
+    return r;
+}
+
+/**
+ * @fn JsonError json_parseContext(JsonContext *ctx, const char *js, unsigned int len)
+ * @brief Parses a document into the arena of ctx and indexes its keys.
+ * @param ctx
+ * @param js
+ * @param len
+ * @return JSON_SUCCESS, the tokens are ctx->tokens[0..ctx->tokenNum)
+ */
+JsonError json_parseContext(JsonContext *ctx, const char *js, unsigned int len)
+{
+    JsonError r;
+
+    /* The tokens are being rewritten, the old index is stale */
+    if (json_activeIndex == &ctx->index)
+        json_activeIndex = NULL;
+
+    json_initJsonParser(&ctx->parser);
+    ctx->tokenNum = 0;
+
+    r = json_runContext(ctx, js, len);
+    if (r == JSON_SUCCESS)
+        json_buildKeyIndex(&ctx->index, js, ctx->tokens, ctx->tokenNum);
+
+    return r;
+}
+
+/**
+ * @fn void json_freeContext(JsonContext *ctx)
+ * @brief Releases the arena and the key index of ctx.
+ * @param ctx
+ */
+void json_freeContext(JsonContext *ctx)
+{
+    json_freeKeyIndex(&ctx->index);
+
+    free(ctx->tokens);
+    free(ctx->scratch);
+    memset(ctx, 0, sizeof(JsonContext));
+}
+
+/**
+ * @fn void json_initStream(JsonStream *st)
+ * @brief Prepares an empty stream, the buffers are allocated on the first feed.
+ * @param st
+ */
+void json_initStream(JsonStream *st)
+{
+    memset(st, 0, sizeof(JsonStream));
+    json_initJsonParser(&st->ctx.parser);
+    st->ctx.parser.stream = 1;
+}
+
+/**
+ * @fn JsonError json_feedStream(JsonStream *st, const char *chunk, unsigned int n)
+ * @brief Appends a chunk and tokenizes its bytes.
+ * @param st
+ * @param chunk
+ * @param n
+ * @return JSON_SUCCESS once the top level value is closed, JSON_ERROR_PART while more is expected
+ */
+JsonError json_feedStream(JsonStream *st, const char *chunk, unsigned int n)
+{
+    JsonParser *parser = &st->ctx.parser;
+    JsonError r;
+    unsigned int cap;
+    char *buf;
+
+    if (st->len + n + 1 > st->cap)
+    {
+        for (cap = st->cap ? st->cap : JSON_STREAM_MIN_BUF; cap < st->len + n + 1; cap *= 2) ;
+        buf = (char *)realloc(st->buf, cap);
+        if (buf == NULL) return json_setError(parser, JSON_ERROR_NOMEM, JSON_ERRC_NONE, st->len);
+        st->buf = buf;
+        st->cap = cap;
+    }
+    memcpy(st->buf + st->len, chunk, n);
+    st->len += n;
+    st->buf[st->len] = '\0';
+
+    /* The buffer may have moved, the index of the last document is stale */
+    if (json_activeIndex == &st->ctx.index)
+        json_activeIndex = NULL;
+
+    r = json_runContext(&st->ctx, st->buf, st->len);
+    if (r == JSON_ERROR_PART && parser->depth == 0 && parser->partial == JSON_PARTIAL_NONE && parser->toknext > 0)
+        r = JSON_SUCCESS;
+    if (r == JSON_SUCCESS)
+        json_buildKeyIndex(&st->ctx.index, st->buf, st->ctx.tokens, st->ctx.tokenNum);
+
+    return r;
+}
+
+/**
+ * @fn JsonError json_finishStream(JsonStream *st)
+ * @brief End of input : a pending primitive is complete, anything else still open is an error.
+ * @param st
+ */
+JsonError json_finishStream(JsonStream *st)
+{
+    JsonParser *parser = &st->ctx.parser;
+    JsonError r;
+
+    parser->stream = 0;
+    r = json_runContext(&st->ctx, st->buf != NULL ? st->buf : "", st->len);
+    parser->stream = 1;
+
+    if (r == JSON_SUCCESS)
+        json_buildKeyIndex(&st->ctx.index, st->buf, st->ctx.tokens, st->ctx.tokenNum);
+
+    return r;
+}
+
+/**
+ * @fn void json_resetStream(JsonStream *st)
+ * @brief Starts the next document, the buffer and the arena are kept.
+ * @param st
+ */
+void json_resetStream(JsonStream *st)
+{
+    if (json_activeIndex == &st->ctx.index)
+        json_activeIndex = NULL;
+
+    json_initJsonParser(&st->ctx.parser);
+    st->ctx.parser.stream = 1;
+    st->ctx.tokenNum = 0;
+    st->len = 0;
+}
+
+/**
+ * @fn void json_freeStream(JsonStream *st)
+ * @brief Releases the buffer, the arena and the key index of st.
+ * @param st
+ */
+void json_freeStream(JsonStream *st)
+{
+    json_freeContext(&st->ctx);
+    free(st->buf);
+    memset(st, 0, sizeof(JsonStream));
+}
+
+/**
+ * @fn static unsigned int json_hashSpan(const char *str, int len)
+ * @brief FNV-1a hash of a key span.
+ * @param str
+ * @param len
+ */
+static unsigned int json_hashSpan(const char *str, int len)
+{
+    unsigned int hash = 2166136261u;
+
+    while (len-- > 0)
+    {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @fn int json_buildKeyIndex(JsonKeyIndex *index, const char *js, JsonToken *tokens, int tokenNum)
+ * @brief Hashes every object key of tokens[0..tokenNum) and activates the index.
+ * The caller owns index : json_activeIndex keeps its address, so it must
+ * outlive its use and be released with json_freeKeyIndex(), never left on a
+ * stack frame that returns.
+ * @param index     zeroed the first time, its entries are reused afterwards
+ * @param js
+ * @param tokens
+ * @param tokenNum  parser.toknext of the parse
+ */
+int json_buildKeyIndex(JsonKeyIndex *index, const char *js, JsonToken *tokens, int tokenNum)
+{
+    int i, sp = 0, cap;
+    int stack[JSON_MAX_DEPTH]; /* open containers, json_parseJson() bounds the depth */
+    int left[JSON_MAX_DEPTH]; /* children not yet seen */
+    int bucket;
+    JsonKeyEntry *entry;
+
+    /* A document has fewer keys than tokens */
+    if (tokenNum > index->entryCap)
+    {
+        for (cap = index->entryCap ? index->entryCap : JSON_ARENA_MIN_TOKEN; cap < tokenNum; cap *= 2) ;
+        entry = (JsonKeyEntry *)realloc(index->entry, sizeof(JsonKeyEntry) * cap);
+        if (entry == NULL)
+        {
+            json_activeIndex = NULL;
+            return JSON_ERROR_NOMEM;
+        }
+        index->entry = entry;
+        index->entryCap = cap;
+    }
+
+    index->js = js;
+    index->tokens = tokens;
+    index->tokenNum = tokenNum;
+    index->entryNum = 0;
+    memset(index->bucket, 0xff, sizeof(index->bucket));
+
+    /* Collect the keys in document order, the chains are linked afterwards */
+    for (i = 0; i < tokenNum; i++)
+    {
+        while (sp > 0 && left[sp - 1] == 0) sp--;
+
+        if (sp > 0)
+        {
+            /* Children of an object alternate key, value */
+            if (tokens[stack[sp - 1]].type == JSON_OBJECT &&
+                ((tokens[stack[sp - 1]].size - left[sp - 1]) & 1) == 0)
+            {
+                entry = &index->entry[index->entryNum++];
+                entry->keyIdx = i;
+                entry->hash = json_hashSpan(&js[tokens[i].start], tokens[i].end - tokens[i].start);
+            }
+            left[sp - 1]--;
+        }
+
+        if ((tokens[i].type == JSON_OBJECT || tokens[i].type == JSON_ARRAY) && tokens[i].size > 0)
+        {
+            stack[sp] = i;
+            left[sp] = tokens[i].size;
+            sp++;
+        }
+    }
+
+    /* Push to the head from the last key : every chain ends up in document order */
+    for (i = index->entryNum - 1; i >= 0; i--)
+    {
+        entry = &index->entry[i];
+        bucket = entry->hash & (JSON_KEY_BUCKET - 1);
+        entry->next = index->bucket[bucket];
+        index->bucket[bucket] = i;
+    }
+
+    json_activeIndex = index;
+    return index->entryNum;
+}
+
+/**
+ * @fn void json_freeKeyIndex(JsonKeyIndex *index)
+ * @brief Clears json_activeIndex if it is index, then frees the entries.
+ * @param index
+ */
+void json_freeKeyIndex(JsonKeyIndex *index)
+{
+    if (json_activeIndex == index)
+        json_activeIndex = NULL;
+
+    free(index->entry);
+    index->entry = NULL;
+    index->entryCap = 0;
+    index->entryNum = 0;
+}
+
+/**
+ * @fn static int json_lookupKeyIndex(JsonKeyIndex *index, int base, const char *key, int len)
+ * @brief First key named key inside the subtree of tokens[base].
+ * @param index
+ * @param base
+ * @param key
+ * @param len
+ */
+static int json_lookupKeyIndex(JsonKeyIndex *index, int base, const char *key, int len)
+{
+    JsonToken *tokens = index->tokens;
+    JsonKeyEntry *entry;
+    unsigned int hash;
+    int e, k;
+
+    hash = json_hashSpan(key, len);
+
+    for (e = index->bucket[hash & (JSON_KEY_BUCKET - 1)]; e >= 0; e = entry->next)
+    {
+        entry = &index->entry[e];
+        k = entry->keyIdx;
+        if (k < base) continue;
+        /* Chains are in document order : nothing left in the subtree */
+        if (k > base && tokens[k].start >= tokens[base].end) break;
+        if (entry->hash != hash) continue;
+
+        if (tokens[k].end - tokens[k].start == len && !memcmp(&index->js[tokens[k].start], key, len))
+            return k;
+    }
+
+    return -1;
+}
+
+int json_object_index_get(char *json_str, JsonToken *tokens, char *str)
+{
+    int i, len = strlen(str);
+    JsonKeyIndex *index = json_activeIndex;
+
+    if (index != NULL && index->js == json_str &&
+        tokens >= index->tokens && tokens < index->tokens + index->tokenNum)
+    {
+        i = json_lookupKeyIndex(index, tokens - index->tokens, str, len);
+        return (i < 0) ? -1 : i - (tokens - index->tokens);
+    }
+
+    /* Not indexed : scan the subtree, still without copying the tokens */
+    for (i=0; i < tokens[0].skip; i++) {
+        if (tokens[i].end - tokens[i].start == len && !memcmp(&json_str[tokens[i].start], str, len)) return i;
+    }
+
+    return -1;
+}
+
+/*
+ * Span decoders : typed values straight from the token span, nothing is copied.
+ * All of them return 1, or -1 when the span is not a valid value of the type.
+ */
+
+/**
+ * @fn int json_spanToLong(const char *ptr, int len, long long *result)
+ * @brief Decimal integer with overflow detection.
+ * @param ptr
+ * @param len
+ * @param result
+ */
+int json_spanToLong(const char *ptr, int len, long long *result)
+{
+    const char *end = ptr + len;
+    unsigned long long value = 0, limit = LLONG_MAX;
+    unsigned int d;
+    int neg = 0;
+
+    if (ptr < end && *ptr == '-') { neg = 1; limit++; ptr++; }
+    if (ptr == end) return -1;
+
+    for (; ptr < end; ptr++)
+    {
+        d = (unsigned char)*ptr - '0';
+        if (d > 9) return -1;
+        if (value > (limit - d) / 10) return -1;
+        value = value * 10 + d;
+    }
+
+    *result = neg ? (long long)(0ULL - value) : (long long)value;
+    return 1;
+}
+
+/**
+ * @fn int json_spanToInt(const char *ptr, int len, int *result)
+ * @brief json_spanToLong() limited to the int range.
+ * @param ptr
+ * @param len
+ * @param result
+ */
+int json_spanToInt(const char *ptr, int len, int *result)
+{
+    long long value;
+
+    if (json_spanToLong(ptr, len, &value) < 0 || value < INT_MIN || value > INT_MAX) return -1;
+
+    *result = (int)value;
+    return 1;
+}
+
+#define JSON_DOUBLE_MAX_LEN			512
+
+/**
+ * @fn int json_spanToDouble(const char *ptr, int len, double *result)
+ * @brief JSON number. A significand below 2^53 scaled by at most 10^22 is exact in
+ *        one multiply or divide ( Clinger's fast path ), the rest goes through strtod().
+ * @param ptr
+ * @param len
+ * @param result
+ */
+int json_spanToDouble(const char *ptr, int len, double *result)
+{
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char *p = ptr, *end = ptr + len;
+    unsigned long long mant = 0;
+    int neg = 0, digits = 0, scale = 0, exp = 0, expNeg = 0;
+    char buf[JSON_DOUBLE_MAX_LEN + 1];
+    double value;
+
+    if (p < end && *p == '-') { neg = 1; p++; }
+    if (p == end || *p < '0' || *p > '9') return -1;
+
+    /* Leading zeros do not count as significant digits */
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        if (mant || *p != '0') digits++;
+        mant = mant * 10 + (*p - '0');
+    }
+    if (p < end && *p == '.')
+    {
+        if (++p == end || *p < '0' || *p > '9') return -1;
+        for (; p < end && *p >= '0' && *p <= '9'; p++, scale--)
+        {
+            if (mant || *p != '0') digits++;
+            mant = mant * 10 + (*p - '0');
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        if (p < end && (*p == '+' || *p == '-')) expNeg = (*p++ == '-');
+        if (p == end || *p < '0' || *p > '9') return -1;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+            if (exp < 100000) exp = exp * 10 + (*p - '0');
+    }
+    if (p != end) return -1;
+
+    scale += expNeg ? -exp : exp;
+    if (digits <= 19 && mant <= (1ULL << 53) && scale >= -22 && scale <= 22)
+    {
+        value = (double)mant;
+        value = (scale < 0) ? value / pow10[-scale] : value * pow10[scale];
+        *result = neg ? -value : value;
+        return 1;
+    }
+
+    if (len > JSON_DOUBLE_MAX_LEN) return -1;
+    memcpy(buf, ptr, len);
+    buf[len] = 0;
+    *result = strtod(buf, NULL);
+    return 1;
+}
+
+/**
+ * @fn int json_spanToBitMask(const char *ptr, int len, int *result)
+ * @brief "1111100" -> 0x7c, any digit other than '0' is a set bit.
+ * @param ptr
+ * @param len
+ * @param result
+ */
+int json_spanToBitMask(const char *ptr, int len, int *result)
+{
+    int i, ibitmask = 0;
+
+    /* The sign bit is left out so that -1 still means absent */
+    if (len > 31) return -1;
+
+    for (i = 0; i < len; i++)
+    {
+        if (ptr[i] < '0' || ptr[i] > '9') return -1;
+        ibitmask = (ibitmask << 1) | (ptr[i] != '0');
+    }
+
+    *result = ibitmask;
+    return 1;
+}
+
+#define JSON_TIME_LEN				19		// YYYY-MM-DDTHH:MM:SS
+
+/**
+ * @fn int json_spanToTime(const char *ptr, int len, time_t *result)
+ * @brief UTC epoch of "YYYY-MM-DDTHH:MM:SS", ' ' is accepted for 'T' and a trailing 'Z' is allowed.
+ *        24:00:00 is the end of the day.
+ * @param ptr
+ * @param len
+ * @param result
+ */
+int json_spanToTime(const char *ptr, int len, time_t *result)
+{
+    static const unsigned char mdays[] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    const unsigned char *p = (const unsigned char *)ptr;
+    int year, mon, day, hour, min, sec, leap, era, yoe, doy;
+    long long days;
+
+    if (len != JSON_TIME_LEN && !(len == JSON_TIME_LEN + 1 && p[JSON_TIME_LEN] == 'Z')) return -1;
+    if (p[4] != '-' || p[7] != '-' || (p[10] != 'T' && p[10] != ' ') || p[13] != ':' || p[16] != ':') return -1;
+
+    #ifdef __SSE2__
+    {
+        /* Digits of the first 16 bytes in one compare, the separators are masked out */
+        __m128i d = _mm_sub_epi8(_mm_loadu_si128((const __m128i *)p), _mm_set1_epi8('0'));
+        int ok = _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(d, _mm_set1_epi8(-1)),
+                                                 _mm_cmplt_epi8(d, _mm_set1_epi8(10))));
+        if ((ok & 0xdb6f) != 0xdb6f || (unsigned)(p[17] - '0') > 9 || (unsigned)(p[18] - '0') > 9) return -1;
+    }
+    #else
+    {
+        int i;
+        for (i = 0; i < JSON_TIME_LEN; i++)
+            if (i != 4 && i != 7 && i != 10 && i != 13 && i != 16 && (unsigned)(p[i] - '0') > 9) return -1;
+    }
+    #endif
+
+    #define JSON_2DIGIT(i)	((p[i] - '0') * 10 + (p[(i) + 1] - '0'))
+    year = JSON_2DIGIT(0) * 100 + JSON_2DIGIT(2);
+    mon = JSON_2DIGIT(5);
+    day = JSON_2DIGIT(8);
+    hour = JSON_2DIGIT(11);
+    min = JSON_2DIGIT(14);
+    sec = JSON_2DIGIT(17);
+    #undef JSON_2DIGIT
+
+    leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    if (mon < 1 || mon > 12 || day < 1 || day > mdays[mon - 1] || (mon == 2 && day == 29 && !leap)) return -1;
+    if (min > 59 || sec > 59 || hour > 24 || (hour == 24 && (min || sec))) return -1;
+
+    /* Days since 1970-01-01 of a proleptic Gregorian date, years counted from March */
+    if (mon <= 2) year--;
+    era = year / 400;
+    yoe = year - era * 400;
+    doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    days = (long long)era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+
+    *result = (time_t)(days * 86400 + hour * 3600 + min * 60 + sec);
+    return 1;
+}
+
+/**
+ * @fn static int json_hex4(const char *p)
+ * @brief Value of 4 hex digits, -1 if one is not.
+ * @param p
+ */
+static int json_hex4(const char *p)
+{
+    int i, d, value = 0;
+
+    for (i = 0; i < 4; i++)
+    {
+        d = (unsigned char)p[i];
+        if (d >= '0' && d <= '9') d -= '0';
+        else if ((d | 0x20) >= 'a' && (d | 0x20) <= 'f') d = (d | 0x20) - 'a' + 10;
+        else return -1;
+        value = value * 16 + d;
+    }
+    return value;
+}
+
+/**
+ * @fn int json_spanUnescape(const char *ptr, int len, char *result, int max_len)
+ * @brief Value of a string span, escapes decoded and \uXXXX written as UTF-8 ( NUL terminated ).
+ *        The runs between escapes are copied 16 bytes at a time.
+ * @param ptr
+ * @param len
+ * @param result
+ * @param max_len   longest value accepted, result holds max_len+1 bytes
+ * @return length, -1 on a bad escape, a lone surrogate or a value too long
+ */
+int json_spanUnescape(const char *ptr, int len, char *result, int max_len)
+{
+    const char *end = ptr + len;
+    char *out = result, *outEnd = result + max_len;
+    int cp, lo;
+
+    while (ptr < end)
+    {
+        #ifdef __SSE2__
+        /* No backslash in the next 16 bytes : copied at once */
+        while (end - ptr >= 16 && outEnd - out >= 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)ptr);
+            int bs = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+
+            _mm_storeu_si128((__m128i *)out, v);
+            if (bs != 0)
+            {
+                ptr += __builtin_ctz(bs);
+                out += __builtin_ctz(bs);
+                break;
+            }
+            ptr += 16;
+            out += 16;
+        }
+        if (ptr == end) break;
+        #endif
+
+        if (*ptr != '\\')
+        {
+            if (out == outEnd) return -1;
+            *out++ = *ptr++;
+            continue;
+        }
+
+        if (end - ptr < 2) return -1;
+        switch (ptr[1])
+        {
+            case '\"': cp = '\"'; break;
+            case '/': cp = '/'; break;
+            case '\\': cp = '\\'; break;
+            case 'b': cp = '\b'; break;
+            case 'f': cp = '\f'; break;
+            case 'r': cp = '\r'; break;
+            case 'n': cp = '\n'; break;
+            case 't': cp = '\t'; break;
+            case 'u':
+                if (end - ptr < 6 || (cp = json_hex4(ptr + 2)) < 0) return -1;
+                if (cp >= 0xdc00 && cp <= 0xdfff) return -1;
+                if (cp >= 0xd800 && cp <= 0xdbff)
+                {
+                    /* High surrogate : the low one must follow */
+                    if (end - ptr < 12 || ptr[6] != '\\' || ptr[7] != 'u' ||
+                        (lo = json_hex4(ptr + 8)) < 0xdc00 || lo > 0xdfff) return -1;
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                    ptr += 6;
+                }
+                ptr += 4;
+                break;
+            default:
+                return -1;
+        }
+        ptr += 2;
+
+        if (cp < 0x80)
+        {
+            if (outEnd - out < 1) return -1;
+            *out++ = cp;
+        }
+        else if (cp < 0x800)
+        {
+            if (outEnd - out < 2) return -1;
+            *out++ = 0xc0 | (cp >> 6);
+            *out++ = 0x80 | (cp & 0x3f);
+        }
+        else if (cp < 0x10000)
+        {
+            if (outEnd - out < 3) return -1;
+            *out++ = 0xe0 | (cp >> 12);
+            *out++ = 0x80 | ((cp >> 6) & 0x3f);
+            *out++ = 0x80 | (cp & 0x3f);
+        }
+        else
+        {
+            if (outEnd - out < 4) return -1;
+            *out++ = 0xf0 | (cp >> 18);
+            *out++ = 0x80 | ((cp >> 12) & 0x3f);
+            *out++ = 0x80 | ((cp >> 6) & 0x3f);
+            *out++ = 0x80 | (cp & 0x3f);
+        }
+    }
+
+    *out = 0;
+    return out - result;
+}
+
+/**
+ * @fn static int json_copyString(const char *js, const JsonToken *tok, char *result, int max_len)
+ * @brief Value of a string or primitive token into result ( NUL terminated ), decoded only if it has escapes.
+ * @param js
+ * @param tok
+ * @param result
+ * @param max_len   longest value accepted, result holds max_len+1 bytes
+ * @return length, -1 if too long or badly escaped
+ */
+static int json_copyString(const char *js, const JsonToken *tok, char *result, int max_len)
+{
+    int length = tok->end - tok->start;
+
+    if (JSON_TOKEN_ESCAPED(tok)) return json_spanUnescape(&js[tok->start], length, result, max_len);
+    if (length > max_len) return -1;
+
+    memcpy(result, &js[tok->start], length);
+    result[length] = 0;
+    return length;
+}
+
+int get_int_from_json_new(char *json_str, JsonToken *tokens, char *key, int *result)
+{
+    int     i;
 
     if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
         printf("[%s] can't get %s\n", __func__, key);
         return -1;
     }
 
-    i++;
-    length = tokens[i].end - tokens[i].start;
-    strncpy(str_ptr, &json_str[tokens[i].start], length);
-    str_ptr[length] = 0;
+    i++;
+    if (json_spanToInt(&json_str[tokens[i].start], tokens[i].end - tokens[i].start, result) < 0) {
+        printf("[%s] %s is not an int\n", __func__, key);
+        return -1;
+    }
+
+    return 1;
+}
+
+int get_string_from_json_new(char *json_str, JsonToken *tokens, char *key, char *result, int max_len)
+{
+    int     i;
+
+    if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
+        printf("[%s] can't get %s\n", __func__, key);
+        return -1;
+	}
+
+	i++;
+	if (json_copyString(json_str, &tokens[i], result, max_len) < 0) {
+        printf("[%s] can't get(%s) too long or bad escape\n", __func__, key);
+        return -1;
+	}
+
+    return 1;
+}
+
+int get_address_array_from_json_new(char *json_str, JsonToken *tokens, char *key, char array_str[10][32+1], int max_item, int max_len)
+{
+	int    num, array_num, i, j;
+    struct json_object *aso, *rso;
+    const char *str_ptr;
+
+    if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
+        printf("[%s] can't get %s\n", __func__, key);
+        return -1;
+    }
+	i++;
+    if (i >= tokens[0].skip) {
+        printf("[%s] can't get key(%s) array number(%d) from json token size\n", __func__, key, i);
+        return -1;
+	}
+	array_num = tokens[i].size;
+    if (array_num > max_item || array_num <= 0) {
+        printf("[%s] key(%s) array number(%d) is over %d\n", __func__, key, array_num, max_item);
+        return -1;
+    }
+
+    for (j=0; j < array_num; j++) {
+		i++;
+        if (i >= tokens[0].skip) {
+        	printf("[%s] can't get %s[%d] is too big in json token\n", __func__, key, j);
+        	return -1;
+		}
+		if (json_copyString(json_str, &tokens[i], array_str[j], max_len) < 0) {
+        	printf("[%s] can't get(%s) too long or bad escape\n", __func__, key);
+        	return -1;
+		}
+    }
+    return array_num;
+}
+
+
+int get_evttype_array_from_json_new(char *json_str, JsonToken *tokens, char *key, char array_str[MAX_SCS_EVT_TYPE_NUM][MAX_SCS_EVT_TYPE_LEN+1], int max_item, int max_len)
+{
+    int     num, array_num, i, j;
+    struct json_object *aso, *rso;
+    const char *str_ptr;
+
+	if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
+        printf("[%s] can't get %s\n", __func__, key);
+        return -1;
+    }
+    i++;
+    if (i >= tokens[0].skip) {
+        printf("[%s] can't get key(%s) array number(%d) from json token\n", __func__, key, i);
+        return -1;
+    }
+    array_num = tokens[i].size;
+    if (array_num > max_item || array_num <= 0) {
+        printf("[%s] key(%s) array number(%d) is over %d\n", __func__, key, array_num, max_item);
+        return -1;
+    }
+
+    for (j=0; j < array_num; j++) {
+		i++;
+        if (i >= tokens[0].skip) {
+            printf("[%s] can't get %s[%d] is too big in json token\n", __func__, key, j);
+            return -1;
+        }
+		if (json_copyString(json_str, &tokens[i], array_str[j], max_len) < 0) {
+            printf("[%s] can't get(%s) too long or bad escape\n", __func__, key);
+            return -1;
+        }
+    }
+    return array_num;
+}
+
+
+int get_assomon_array_from_json_new(char *json_str, JsonToken *tokens, char *key, char array_str[MAX_SCS_ASS_TYPE_NUM][MAX_SCS_ASSO_MON_LEN+1], int max_item, int max_len)
+{
+    int    num, array_num, i, j;
+    struct json_object *aso, *rso;
+    const char *str_ptr;
+
+    if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
+        printf("[%s] can't get %s\n", __func__, key);
+        return -1;
+    }
+    i++;
+    if (i >= tokens[0].skip) {
+        printf("[%s] can't get key(%s) array number(%d) from json token\n", __func__, key, i);
+        return -1;
+    }
+    array_num = tokens[i].size;
+    if (array_num > max_item || array_num <= 0) {
+        printf("[%s] key(%s) array number(%d) is over %d\n", __func__, key, array_num, max_item);
+        return -1;
+    }
+
+    for (j=0; j < array_num; j++) {
+        i++;
+        if (i >= tokens[0].skip) {
+            printf("[%s] can't get %s[%d] is too big in json token\n", __func__, key, j);
+            return -1;
+        }
+        if (json_copyString(json_str, &tokens[i], array_str[j], max_len) < 0) {
+            printf("[%s] can't get(%s) too long or bad escape\n", __func__, key);
+            return -1;
+        }
+    }
+    return array_num;
+}
+
+
+int get_validity_from_json_new(char *json_str, JsonToken *tokens, char *key, Scs_validity_t *validity)
+{
+	int    num, data_num, i, j, length, max_item = 4;
+    struct json_object *aso, *rso;
+    const char *str_ptr;
+
+    if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
+        printf("[%s] can't get %s\n", __func__, key);
+        return -1;
+    }
+	i++;
+    if (i >= tokens[0].skip) {
+        printf("[%s] can't get key(%s) from json token\n", __func__, key);
+        return -1;
+	}
+	data_num = tokens[i].size;
+    if (data_num > max_item || data_num <= 0) {
+        printf("[%s] key(%s) array number(%d) is over %d\n", __func__, key, data_num, max_item);
+        return -1;
+    }
+
+	// startTime (Mandatory)
+ 	if ( get_string_from_json_new(json_str, &tokens[i], "startTime", validity->start_time, MAX_SCS_TIME_LEN) < 0) {
+		printf("can't get(%s) data from json: i=[%d]\n", "startTime", i);
+		return;
+	} else {
+		printf("[DATA] %s:[%s]\n", "startTime", validity->start_time);
+	}
+
+	// expiryTime (Mandatory)
+    if ( get_string_from_json_new(json_str, &tokens[i], "expiryTime", validity->expiry_time, MAX_SCS_TIME_LEN) < 0) {
+        printf("can't get(%s) data from json: i=[%d]\n", "expiryTime", i);
+        return;
+    } else {
+		printf("[DATA] %s:[%s]\n", "expiryTime", validity->expiry_time);
+    }
+
+    return data_num;
+}
+
+
+JsonToken *json_object_object_get_new(char *json_str, JsonToken *tokens, char *key) 
+{
+	int    num, data_num, i, j, length, max_item = 4;
+    struct json_object *aso, *rso;
+    const char *str_ptr;
+
+    if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
+        printf("[%s] can't get %s\n", __func__, key);
+        return NULL;
+    }
+	i++;
+	if (i >= tokens[0].skip) {
+        printf("[%s] can't get key(%s) object number(%d) from json token\n", __func__, key, i);
+        return NULL;
+	}
+
+	return &tokens[i];
+}
+
+
+JsonToken *json_object_array_get_idx_new(char *json_str, JsonToken *tokens, int idx) 
+{
+	int i, array_cnt = 0, next_array_offset = -1;
+
+    for (i=0; i < tokens[0].skip; i++) {
+		if (tokens[i].start <= next_array_offset) continue;
+		if (tokens[i].type == JSON_OBJECT) {
+			array_cnt++;
+			next_array_offset = tokens[i].end;
+		}
+		if (array_cnt == (idx+1)) return &tokens[i];
+    }
+
+	return NULL;
+}
+
+
+int get_int_bit_mask_from_json_new(char *json_str, JsonToken *tokens, char *key, int *result)
+{
+    int     i;
+
+    if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
+        printf("[%s] can't get %s\n", __func__, key);
+        return -1;
+    }
+
+    i++;
+    if (json_spanToBitMask(&json_str[tokens[i].start], tokens[i].end - tokens[i].start, result) < 0) {
+        printf("[%s] %s is not a bit mask\n", __func__, key);
+        return -1;
+    }
+
+    return 1;
+}
+
+
+/**
+ * @fn JsonView json_viewOf(const char *js, JsonToken *tok)
+ * @brief View of a token and its subtree.
+ * @param js
+ * @param tok
+ */
+JsonView json_viewOf(const char *js, JsonToken *tok)
+{
+    JsonView v;
+
+    v.js = js;
+    v.tok = tok;
+    v.end = (tok != NULL) ? tok + tok->skip : NULL;
+    return v;
+}
+
+/**
+ * @fn JsonView json_viewChild(JsonView v)
+ * @brief First child of an object or array, empty if there is none.
+ * @param v
+ */
+JsonView json_viewChild(JsonView v)
+{
+    JsonView c = { v.js, NULL, NULL };
+
+    if (v.tok == NULL || v.tok->size == 0 ||
+        (v.tok->type != JSON_OBJECT && v.tok->type != JSON_ARRAY)) return c;
+
+    c.tok = v.tok + 1;
+    c.end = v.tok + v.tok->skip;
+    return c;
+}
+
+/**
+ * @fn JsonView json_viewNext(JsonView v)
+ * @brief Next sibling, skipping the whole subtree of v in O(1).
+ * @param v
+ */
+JsonView json_viewNext(JsonView v)
+{
+    if (v.tok == NULL) return v;
+
+    v.tok += v.tok->skip;
+    if (v.tok >= v.end) v.tok = NULL;
+    return v;
+}
+
+/**
+ * @fn int json_viewEquals(JsonView v, const char *str)
+ * @brief Compares the span of v with str in place.
+ * @param v
+ * @param str
+ */
+int json_viewEquals(JsonView v, const char *str)
+{
+    int len;
+
+    if (v.tok == NULL) return 0;
+    len = v.tok->end - v.tok->start;
+    return ((int)strlen(str) == len && !memcmp(&v.js[v.tok->start], str, len));
+}
+
+/**
+ * @fn JsonView json_viewMember(JsonView obj, const char *key)
+ * @brief Value of a direct member of an object, empty if not found.
+ * @param obj
+ * @param key
+ */
+JsonView json_viewMember(JsonView obj, const char *key)
+{
+    JsonView k, val;
+
+    if (obj.tok == NULL || obj.tok->type != JSON_OBJECT) return json_viewOf(obj.js, NULL);
+
+    for (k = json_viewChild(obj); k.tok != NULL; k = json_viewNext(val))
+    {
+        val = json_viewNext(k);
+        if (val.tok == NULL) break;
+        if (json_viewEquals(k, key)) return val;
+    }
+    return json_viewOf(obj.js, NULL);
+}
+
+/**
+ * @fn JsonView json_viewAt(JsonView arr, int idx)
+ * @brief idx-th element of an array, empty if out of range.
+ * @param arr
+ * @param idx
+ */
+JsonView json_viewAt(JsonView arr, int idx)
+{
+    JsonView e;
+
+    if (arr.tok == NULL || arr.tok->type != JSON_ARRAY || idx < 0 || idx >= arr.tok->size)
+        return json_viewOf(arr.js, NULL);
+
+    for (e = json_viewChild(arr); e.tok != NULL && idx > 0; idx--) e = json_viewNext(e);
+    return e;
+}
+
+/**
+ * @fn int json_viewCount(JsonView v)
+ * @brief Members of an object or elements of an array.
+ * @param v
+ */
+int json_viewCount(JsonView v)
+{
+    if (v.tok == NULL) return -1;
+    if (v.tok->type == JSON_OBJECT) return v.tok->size / 2;
+    if (v.tok->type == JSON_ARRAY) return v.tok->size;
+    return 0;
+}
+
+/**
+ * @fn int json_viewString(JsonView v, char *result, int max_len)
+ * @brief Copies a string or primitive into result ( NUL terminated ), escapes decoded.
+ * @param v
+ * @param result
+ * @param max_len   longest value accepted, result holds max_len+1 bytes
+ * @return length, -1 if missing, not a scalar, too long or badly escaped
+ */
+int json_viewString(JsonView v, char *result, int max_len)
+{
+    if (v.tok == NULL || v.tok->type == JSON_OBJECT || v.tok->type == JSON_ARRAY) return -1;
+    return json_copyString(v.js, v.tok, result, max_len);
+}
+
+/**
+ * @fn int json_viewText(JsonView v, char *buf, int max_len, const char **text)
+ * @brief Value of a string or primitive without a copy : its span, unless it has escapes
+ *        and is decoded into buf. text is not NUL terminated when it is the span.
+ * @param v
+ * @param buf       used for an escaped string only, holds max_len+1 bytes
+ * @param max_len
+ * @param text
+ * @return length, -1 if missing, not a scalar or badly escaped
+ */
+int json_viewText(JsonView v, char *buf, int max_len, const char **text)
+{
+    int length;
+
+    if (v.tok == NULL || v.tok->type == JSON_OBJECT || v.tok->type == JSON_ARRAY) return -1;
+
+    if (JSON_TOKEN_ESCAPED(v.tok))
+    {
+        *text = buf;
+        return json_spanUnescape(&v.js[v.tok->start], v.tok->end - v.tok->start, buf, max_len);
+    }
+    *text = &v.js[v.tok->start];
+    return v.tok->end - v.tok->start;
+}
+
+/* Span of a string or primitive, -1 for a missing value or a container */
+#define JSON_VIEW_SPAN(v, ptr, len) \
+    ((v).tok == NULL || (v).tok->type == JSON_OBJECT || (v).tok->type == JSON_ARRAY ? -1 : \
+     ((ptr) = &(v).js[(v).tok->start], (len) = (v).tok->end - (v).tok->start, 1))
+
+/**
+ * @fn int json_viewInt(JsonView v, int *result)
+ * @brief Decimal value of a primitive or of a quoted number.
+ * @param v
+ * @param result
+ */
+int json_viewInt(JsonView v, int *result)
+{
+    const char *ptr;
+    int len;
+
+    if (JSON_VIEW_SPAN(v, ptr, len) < 0) return -1;
+    return json_spanToInt(ptr, len, result);
+}
+
+/**
+ * @fn int json_viewLong(JsonView v, long long *result)
+ * @brief Like json_viewInt() for 64 bits values.
+ * @param v
+ * @param result
+ */
+int json_viewLong(JsonView v, long long *result)
+{
+    const char *ptr;
+    int len;
+
+    if (JSON_VIEW_SPAN(v, ptr, len) < 0) return -1;
+    return json_spanToLong(ptr, len, result);
+}
+
+/**
+ * @fn int json_viewDouble(JsonView v, double *result)
+ * @brief Value of a number, quoted or not.
+ * @param v
+ * @param result
+ */
+int json_viewDouble(JsonView v, double *result)
+{
+    const char *ptr;
+    int len;
+
+    if (JSON_VIEW_SPAN(v, ptr, len) < 0) return -1;
+    return json_spanToDouble(ptr, len, result);
+}
+
+/**
+ * @fn int json_viewBitMask(JsonView v, int *result)
+ * @brief "1111100" -> 0x7c, any digit other than '0' is a set bit.
+ * @param v
+ * @param result
+ */
+int json_viewBitMask(JsonView v, int *result)
+{
+    const char *ptr;
+    int len;
+
+    if (JSON_VIEW_SPAN(v, ptr, len) < 0) return -1;
+    return json_spanToBitMask(ptr, len, result);
+}
+
+/**
+ * @fn int json_viewTime(JsonView v, time_t *result)
+ * @brief Epoch of an ISO 8601 timestamp, see json_spanToTime().
+ * @param v
+ * @param result
+ */
+int json_viewTime(JsonView v, time_t *result)
+{
+    const char *ptr;
+    int len;
+
+    if (JSON_VIEW_SPAN(v, ptr, len) < 0) return -1;
+    return json_spanToTime(ptr, len, result);
+}
+
+
+/**
+ * @fn static int json_splitPointer(const char *pointer, char *text, int *textLen, int textCap, JsonPathStep *step)
+ * @brief Splits a JSON Pointer into steps, "~1" is '/' and "~0" is '~' in a key.
+ * @param pointer   "" for the whole document, otherwise starts with '/'
+ * @param text      receives the unescaped keys from *textLen on
+ * @param textLen
+ * @param textCap
+ * @param step      JSON_PATH_MAX_STEP entries
+ * @return number of steps, -1 if the pointer is invalid or too long
+ */
+static int json_splitPointer(const char *pointer, char *text, int *textLen, int textCap, JsonPathStep *step)
+{
+    const char *p = pointer;
+    int n = 0, len = *textLen;
+    JsonPathStep *s;
+
+    if (*p != 0 && *p != '/') return -1;
+
+    while (*p == '/')
+    {
+        if (n == JSON_PATH_MAX_STEP) return -1;
+
+        s = &step[n++];
+        s->keyOff = len;
+        for (p++; *p != 0 && *p != '/'; p++)
+        {
+            if (len == textCap) return -1;
+            if (*p == '~')
+            {
+                if (p[1] != '0' && p[1] != '1') return -1;
+                text[len++] = (*++p == '1') ? '/' : '~';
+            }
+            else text[len++] = *p;
+        }
+        s->keyLen = len - s->keyOff;
+        s->hash = json_hashSpan(&text[s->keyOff], s->keyLen);
+
+        /* A number is also an array index, "0" but no leading zeros */
+        s->index = -1;
+        if (s->keyLen > 0 && s->keyLen <= 9 && (text[s->keyOff] != '0' || s->keyLen == 1) &&
+            json_spanToInt(&text[s->keyOff], s->keyLen, &s->index) < 0)
+            s->index = -1;
+    }
+
+    *textLen = len;
+    return n;
+}
+
+/**
+ * @fn int json_compilePath(JsonPath *path, const char *pointer)
+ * @brief Compiles a JSON Pointer for json_viewPath().
+ * @param path
+ * @param pointer
+ * @return 1, -1 if the pointer is invalid or over JSON_PATH_MAX_STEP / JSON_PATH_MAX_TEXT
+ */
+int json_compilePath(JsonPath *path, const char *pointer)
+{
+    int textLen = 0;
+
+    path->stepNum = json_splitPointer(pointer, path->text, &textLen, JSON_PATH_MAX_TEXT, path->step);
+    if (path->stepNum < 0) {
+        printf("[%s] invalid path [%s]\n", __func__, pointer);
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @fn static int json_stepMatches(const char *text, const JsonPathStep *s, JsonView k)
+ * @brief Key k is the key of step s.
+ * @param text
+ * @param s
+ * @param k
+ */
+static int json_stepMatches(const char *text, const JsonPathStep *s, JsonView k)
+{
+    return (k.tok->end - k.tok->start == s->keyLen && !memcmp(&k.js[k.tok->start], &text[s->keyOff], s->keyLen));
+}
+
+/**
+ * @fn JsonView json_viewPath(JsonView v, const JsonPath *path)
+ * @brief Value at path below v, empty if there is none.
+ * @param v
+ * @param path
+ */
+JsonView json_viewPath(JsonView v, const JsonPath *path)
+{
+    const JsonPathStep *s;
+    JsonView k, val;
+    int i;
+
+    for (i = 0; i < path->stepNum && v.tok != NULL; i++)
+    {
+        s = &path->step[i];
+        if (v.tok->type == JSON_ARRAY) {
+            v = (s->index < 0) ? json_viewOf(v.js, NULL) : json_viewAt(v, s->index);
+            continue;
+        }
+        if (v.tok->type != JSON_OBJECT) return json_viewOf(v.js, NULL);
+
+        for (k = json_viewChild(v); k.tok != NULL; k = json_viewNext(val))
+        {
+            val = json_viewNext(k);
+            if (val.tok == NULL) break;
+            if (json_stepMatches(path->text, s, k)) break;
+        }
+        v = (k.tok != NULL) ? val : json_viewOf(v.js, NULL);
+    }
+    return v;
+}
+
+/**
+ * @fn void json_initPathSet(JsonPathSet *set)
+ * @brief Empty set, the root node only.
+ * @param set
+ */
+void json_initPathSet(JsonPathSet *set)
+{
+    set->nodeNum = 1;
+    set->pathNum = 0;
+    set->textLen = 0;
+    set->node[0].child = set->node[0].sibling = -1;
+    set->node[0].childNum = 0;
+    set->node[0].path = -1;
+}
+
+/**
+ * @fn int json_addPath(JsonPathSet *set, const char *pointer)
+ * @brief Adds a pointer, the steps shared with the pointers already in the set are merged.
+ * @param set
+ * @param pointer
+ * @return index of the pointer in the results of json_viewPathSet(), -1 if it does not fit
+ */
+int json_addPath(JsonPathSet *set, const char *pointer)
+{
+    JsonPathStep step[JSON_PATH_MAX_STEP];
+    JsonPathNode *node;
+    int i, n, cur = 0, c, textLen = set->textLen;
+
+    if (set->pathNum == JSON_PATHSET_MAX_PATH ||
+        (n = json_splitPointer(pointer, set->text, &textLen, sizeof(set->text), step)) < 0) {
+        printf("[%s] can't add path [%s]\n", __func__, pointer);
+        return -1;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        for (c = set->node[cur].child; c >= 0; c = set->node[c].sibling)
+            if (set->node[c].step.keyLen == step[i].keyLen &&
+                !memcmp(&set->text[set->node[c].step.keyOff], &set->text[step[i].keyOff], step[i].keyLen)) break;
+
+        if (c < 0) {
+            if (set->nodeNum == JSON_PATHSET_MAX_NODE) {
+                printf("[%s] can't add path [%s], over %d steps\n", __func__, pointer, JSON_PATHSET_MAX_NODE);
+                return -1;
+            }
+            c = set->nodeNum++;
+            node = &set->node[c];
+            node->step = step[i];
+            node->child = -1;
+            node->childNum = 0;
+            node->path = -1;
+            node->sibling = set->node[cur].child;
+            set->node[cur].child = c;
+            set->node[cur].childNum++;
+        }
+        cur = c;
+    }
+
+    /* The keys of merged steps are kept in the text as well, they are short */
+    set->textLen = textLen;
+    set->samePath[set->pathNum] = set->node[cur].path;
+    set->node[cur].path = set->pathNum;
+    return set->pathNum++;
+}
+
+/**
+ * @fn static void json_walkPathSet(JsonView v, const JsonPathSet *set, int n, JsonView *result)
+ * @brief Matches the members of v against the children of node n, each member is visited once.
+ * @param v
+ * @param set
+ * @param n
+ * @param result
+ */
+static void json_walkPathSet(JsonView v, const JsonPathSet *set, int n, JsonView *result)
+{
+    const JsonPathNode *node = &set->node[n], *child;
+    JsonView k, val;
+    unsigned long long found = 0; /* child nodes matched, the first of duplicate keys wins */
+    unsigned int hash = 0;
+    int c, p, idx, left = node->childNum;
+
+    for (p = node->path; p >= 0; p = set->samePath[p])
+        result[p] = v;
+
+    if (left == 0) return;
+
+    if (v.tok->type == JSON_ARRAY) {
+        for (idx = 0, val = json_viewChild(v); val.tok != NULL && left > 0; idx++, val = json_viewNext(val))
+            for (c = node->child; c >= 0; c = child->sibling) {
+                child = &set->node[c];
+                if (child->step.index == idx) {
+                    json_walkPathSet(val, set, c, result);
+                    left--;
+                }
+            }
+        return;
+    }
+    if (v.tok->type != JSON_OBJECT) return;
+
+    /* Stops as soon as every child step has been found */
+    for (k = json_viewChild(v); k.tok != NULL && left > 0; k = json_viewNext(val))
+    {
+        val = json_viewNext(k);
+        if (val.tok == NULL) break;
+
+        if (node->childNum >= JSON_PATHSET_HASH_MIN)
+            hash = json_hashSpan(&k.js[k.tok->start], k.tok->end - k.tok->start);
+
+        for (c = node->child; c >= 0; c = child->sibling) {
+            child = &set->node[c];
+            if (node->childNum >= JSON_PATHSET_HASH_MIN && child->step.hash != hash) continue;
+            if (!(found & (1ULL << c)) && json_stepMatches(set->text, &child->step, k)) {
+                found |= 1ULL << c;
+                json_walkPathSet(val, set, c, result);
+                left--;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @fn int json_viewPathSet(JsonView v, const JsonPathSet *set, JsonView *result)
+ * @brief Evaluates every pointer of set below v in one walk.
+ * @param v
+ * @param set
+ * @param result    set->pathNum views, empty for the pointers not found
+ * @return number of pointers found
+ */
+int json_viewPathSet(JsonView v, const JsonPathSet *set, JsonView *result)
+{
+    int i, found = 0;
+
+    for (i = 0; i < set->pathNum; i++)
+        result[i] = json_viewOf(v.js, NULL);
+
+    if (v.tok == NULL) return 0;
+    json_walkPathSet(v, set, 0, result);
+
+    for (i = 0; i < set->pathNum; i++)
+        if (result[i].tok != NULL) found++;
+    return found;
+}
+
+
+/*
+ * Selective parse : only the values reached by a path set are tokenized.
+ * The text is walked along the steps of the set, every other member is
+ * jumped over by json_skipScan() or json_skipString() without producing
+ * tokens, and the walk
+ * stops as soon as every path has been found.
+ */
+typedef struct
+{
+    const JsonPathSet *set;
+    JsonContext *ctx;
+    const char *js;
+    unsigned int len;
+    int tokIdx[JSON_PATHSET_MAX_PATH]; /* first token of each result, -1 if not found */
+    int endIdx[JSON_PATHSET_MAX_PATH];
+    int found;
+    JsonError r;
+} JsonSelect;
+
+/* Bit i set when an odd number of quotes are at or before i : the bytes of a string and its opening quote */
+static JsonBitmap json_prefixXor(JsonBitmap x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/**
+ * @fn static JsonBitmap json_findEscaped(JsonBitmap bs, JsonBitmap *carry)
+ * @brief Bytes escaped by a backslash : the one after every odd-length run of backslashes.
+ * @param bs
+ * @param carry     the first byte of the next block is escaped
+ */
+static JsonBitmap json_findEscaped(JsonBitmap bs, JsonBitmap *carry)
+{
+    const JsonBitmap even = 0x5555555555555555ULL;
+    JsonBitmap follows, oddStarts, evenSeq;
+
+    bs &= ~*carry;
+    follows = (bs << 1) | *carry;
+    oddStarts = bs & ~even & ~follows;
+    *carry = __builtin_uaddll_overflow(oddStarts, bs, &evenSeq);
+    return (even ^ (evenSeq << 1)) & follows;
+}
+
+/**
+ * @fn static int json_skipScan(const char *js, unsigned int len, unsigned int pos, int depth, unsigned int *end)
+ * @brief Finds where the containers open at pos close. Strings are masked a block at a time,
+ *        only the brackets outside of them are visited. Bracket kinds are not checked.
+ * @param js
+ * @param len
+ * @param pos       first byte to scan, outside a string
+ * @param depth     containers open at pos
+ * @param end       byte after the last closing bracket
+ * @return 1, -1 if the data ends first
+ */
+static int json_skipScan(const char *js, unsigned int len, unsigned int pos, int depth, unsigned int *end)
+{
+    JsonBlockMask mask;
+    JsonBitmap inString, strCarry = 0, escCarry = 0, ops;
+    char pad[JSON_SCAN_BLOCK];
+    const char *block;
+    unsigned int base, p;
+    char c;
+
+    for (base = pos; base < len; base += JSON_SCAN_BLOCK)
+    {
+        block = js + base;
+        if (len - base < JSON_SCAN_BLOCK)
+        {
+            memset(pad, ' ', sizeof(pad));
+            memcpy(pad, block, len - base);
+            block = pad;
+        }
+        json_classify(block, &mask);
+
+        inString = json_prefixXor(mask.quote & ~json_findEscaped(mask.bs, &escCarry)) ^ strCarry;
+        strCarry = (JsonBitmap)((long long)inString >> (JSON_SCAN_BLOCK - 1));
+
+        for (ops = mask.op & ~inString; ops != 0; ops &= ops - 1)
+        {
+            p = base + __builtin_ctzll(ops);
+            c = js[p];
+            if (c == '{' || c == '[') depth++;
+            else if (--depth == 0)
+            {
+                *end = p + 1;
+                return 1;
+            }
+        }
+    }
+    return -1;
+}
+
+/**
+ * @fn static int json_skipString(const char *js, unsigned int len, unsigned int pos, unsigned int *end)
+ * @brief Closing quote of the string whose first byte is pos : a quote after an even run of backslashes.
+ * @param js
+ * @param len
+ * @param pos
+ * @param end       byte after the closing quote
+ */
+static int json_skipString(const char *js, unsigned int len, unsigned int pos, unsigned int *end)
+{
+    const char *q, *b;
+
+    while ((q = (const char *)memchr(js + pos, '\"', len - pos)) != NULL)
+    {
+        for (b = q; b > js + pos && b[-1] == '\\'; b--);
+        if (((q - b) & 1) == 0)
+        {
+            *end = q - js + 1;
+            return 1;
+        }
+        pos = q - js + 1;
+    }
+    return -1;
+}
+
+/**
+ * @fn static int json_skipValue(JsonSelect *sel, unsigned int pos, unsigned int *end)
+ * @brief End of the value starting at pos.
+ * @param sel
+ * @param pos
+ * @param end
+ */
+static int json_skipValue(JsonSelect *sel, unsigned int pos, unsigned int *end)
+{
+    const char *js = sel->js;
+    unsigned int p;
+
+    if (pos >= sel->len) return -1;
+
+    switch (js[pos])
+    {
+        case '{':
+        case '[':
+            return json_skipScan(js, sel->len, pos + 1, 1, end);
+        case '\"':
+            return json_skipString(js, sel->len, pos + 1, end);
+        case '}':
+        case ']':
+        case ',':
+        case ':':
+            return -1;
+    }
+
+    for (p = pos; p < sel->len && !(json_charClass[(unsigned char)js[p]] & (JSON_CC_SEP | JSON_CC_OP | JSON_CC_QUOTE)); p++);
+    *end = p;
+    return 1;
+}
+
+/* Next byte that is not a blank */
+static unsigned int json_skipBlank(const char *js, unsigned int len, unsigned int pos)
+{
+    while (pos < len && (js[pos] == ' ' || js[pos] == '\t' || js[pos] == '\r' || js[pos] == '\n')) pos++;
+    return pos;
+}
+
+/**
+ * @fn static int json_selectFound(JsonSelect *sel, int n, unsigned int pos, unsigned int end)
+ * @brief Tokenizes the value of a node where paths end, the paths below it are resolved on its tokens.
+ * @param sel
+ * @param n
+ * @param pos
+ * @param end
+ * @return 1, 0 once every path is found, -1 on a parse error
+ */
+static int json_selectFound(JsonSelect *sel, int n, unsigned int pos, unsigned int end)
+{
+    JsonContext *ctx = sel->ctx;
+    JsonView val[JSON_PATHSET_MAX_PATH];
+    unsigned int first = ctx->tokenNum;
+    int i;
+
+    /* Appended to the arena after the values found so far */
+    json_initJsonParser(&ctx->parser);
+    ctx->parser.pos = pos;
+    ctx->parser.toknext = first;
+    if ((sel->r = json_runContext(ctx, sel->js, end)) != JSON_SUCCESS) return -1;
+
+    for (i = 0; i < sel->set->pathNum; i++) val[i].tok = NULL;
+    json_walkPathSet(json_viewOf(sel->js, ctx->tokens + first), sel->set, n, val);
+
+    /* Indexes, not pointers : the arena may still move */
+    for (i = 0; i < sel->set->pathNum; i++)
+    {
+        if (val[i].tok == NULL || sel->tokIdx[i] >= 0) continue;
+        sel->tokIdx[i] = val[i].tok - ctx->tokens;
+        sel->endIdx[i] = val[i].end - ctx->tokens;
+        sel->found++;
+    }
+    return (sel->found == sel->set->pathNum) ? 0 : 1;
+}
+
+/**
+ * @fn static int json_selectValue(JsonSelect *sel, int n, unsigned int pos, unsigned int *end)
+ * @brief Follows the children of node n into the value at pos, skipping the members they do not name.
+ * @param sel
+ * @param n
+ * @param pos   first byte of the value
+ * @param end   byte after the value
+ * @return 1, 0 once every path is found ( end is not set ), -1 on a parse error ( sel->r )
+ */
+static int json_selectValue(JsonSelect *sel, int n, unsigned int pos, unsigned int *end)
+{
+    const JsonPathSet *set = sel->set;
+    const JsonPathNode *node = &set->node[n], *child;
+    const char *js = sel->js, *key;
+    unsigned long long matched = 0;
+    unsigned int len = sel->len, p, keyEnd, hash = 0;
+    int c, r, idx, keyLen, isObject;
+
+    p = pos;
+    if (node->path >= 0)
+    {
+        if (json_skipValue(sel, pos, end) < 0) goto fail;
+        return json_selectFound(sel, n, pos, *end);
+    }
+
+    if (js[pos] != '{' && js[pos] != '[')
+    {
+        if (json_skipValue(sel, pos, end) < 0) goto fail;
+        return 1;
+    }
+
+    isObject = (js[pos] == '{');
+    p = json_skipBlank(js, len, pos + 1);
+    if (p < len && js[p] == (isObject ? '}' : ']'))
+    {
+        *end = p + 1;
+        return 1;
+    }
+
+    for (idx = 0; p < len; idx++)
+    {
+        c = -1;
+        if (isObject)
+        {
+            if (js[p] != '\"' || json_skipString(js, len, p + 1, &keyEnd) < 0) goto fail;
+            key = &js[p + 1];
+            keyLen = keyEnd - p - 2;
+
+            p = json_skipBlank(js, len, keyEnd);
+            if (p >= len || js[p] != ':') goto fail;
+            p = json_skipBlank(js, len, p + 1);
+
+            if (node->childNum >= JSON_PATHSET_HASH_MIN) hash = json_hashSpan(key, keyLen);
+            for (c = node->child; c >= 0; c = child->sibling)
+            {
+                child = &set->node[c];
+                if (node->childNum >= JSON_PATHSET_HASH_MIN && child->step.hash != hash) continue;
+                if (!(matched & (1ULL << c)) && child->step.keyLen == keyLen &&
+                    !memcmp(key, &set->text[child->step.keyOff], keyLen)) break;
+            }
+        }
+        else
+        {
+            for (c = node->child; c >= 0 && set->node[c].step.index != idx; c = set->node[c].sibling);
+        }
+
+        if (p >= len) goto fail;
+        if (c >= 0)
+        {
+            matched |= 1ULL << c;
+            if ((r = json_selectValue(sel, c, p, &p)) <= 0) return r;
+        }
+        else if (json_skipValue(sel, p, &p) < 0) goto fail;
+
+        /* Every child found : the rest of the container is jumped over at once */
+        if (matched != 0 && __builtin_popcountll(matched) == node->childNum)
+        {
+            if (json_skipScan(js, len, p, 1, end) < 0) goto fail;
+            return 1;
+        }
+
+        p = json_skipBlank(js, len, p);
+        if (p < len && js[p] == ',')
+        {
+            p = json_skipBlank(js, len, p + 1);
+            continue;
+        }
+        if (p < len && js[p] == (isObject ? '}' : ']'))
+        {
+            *end = p + 1;
+            return 1;
+        }
+        goto fail;
+    }
+
+    fail:
+    if (p >= len)
+        sel->r = json_setError(&sel->ctx->parser, JSON_ERROR_PART, JSON_ERRC_OPEN_CONTAINER, pos);
+    else
+        sel->r = json_setError(&sel->ctx->parser, JSON_ERROR_INVAL, JSON_ERRC_UNEXPECTED_CHAR, p);
+    return -1;
+}
+
+/**
+ * @fn JsonError json_parseSelect(JsonContext *ctx, const JsonPathSet *set, const char *js, unsigned int len, JsonView *result)
+ * @brief Parses only what the paths of set need and stops once they are all found.
+ *        The text past the last value found is not looked at, nor checked, and the
+ *        strings skipped over are not checked for UTF-8 : only the values found are.
+ * @param ctx       receives the tokens of the values found, it has no key index
+ * @param set
+ * @param js
+ * @param len
+ * @param result    set->pathNum views, empty for the paths not in the document
+ * @return JSON_SUCCESS, or the error of the parse ( ctx->parser.errcode, errpos )
+ */
+JsonError json_parseSelect(JsonContext *ctx, const JsonPathSet *set, const char *js, unsigned int len, JsonView *result)
+{
+    JsonSelect sel;
+    unsigned int pos, end;
+    int i;
+
+    if (json_activeIndex == &ctx->index)
+        json_activeIndex = NULL;
+    json_getScanner();
+
+    sel.set = set;
+    sel.ctx = ctx;
+    sel.js = js;
+    sel.len = len;
+    sel.found = 0;
+    sel.r = JSON_SUCCESS;
+    for (i = 0; i < set->pathNum; i++)
+    {
+        sel.tokIdx[i] = sel.endIdx[i] = -1;
+        result[i] = json_viewOf(js, NULL);
+    }
+
+    json_initJsonParser(&ctx->parser);
+    ctx->tokenNum = 0;
+    if (set->pathNum == 0) return JSON_SUCCESS;
+
+    pos = json_skipBlank(js, len, 0);
+    if (pos >= len) return json_setError(&ctx->parser, JSON_ERROR_PART, JSON_ERRC_OPEN_CONTAINER, pos);
+    if (json_selectValue(&sel, 0, pos, &end) < 0) return sel.r;
+
+    for (i = 0; i < set->pathNum; i++)
+    {
+        if (sel.tokIdx[i] < 0) continue;
+        result[i].tok = ctx->tokens + sel.tokIdx[i];
+        result[i].end = ctx->tokens + sel.endIdx[i];
+    }
+    return JSON_SUCCESS;
+}
+
+
+/*
+ * Field tables of the SCEF resources.
+ * X(T, kind, key, member, arg, count, flag)
+ *   kind    JSON_FIELD_<kind> entry builder
+ *   arg     longest string for STRING kinds, sub binding for OBJECT kinds,
+ *           name table for ENUM kinds
+ *   count   int member receiving the element number of ARRAY kinds,
+ *           time_t member receiving the epoch of TIME kinds, _ otherwise
+ */
+#define JSON_MEMBER_ITEMS(T, m)		(int)(sizeof(((T *)0)->m) / sizeof(((T *)0)->m[0]))
+#define JSON_MEMBER_ELEM(T, m)		sizeof(((T *)0)->m[0])
+
+#define JSON_FIELD_STRING(T, key, m, arg, cnt, flag) \
+    { key, sizeof(key) - 1, JSON_FT_STRING, flag, offsetof(T, m), arg, 0, 0, 0, NULL, NULL }
+#define JSON_FIELD_INT(T, key, m, arg, cnt, flag) \
+    { key, sizeof(key) - 1, JSON_FT_INT, flag, offsetof(T, m), 0, 0, 0, 0, NULL, NULL }
+#define JSON_FIELD_BITMASK(T, key, m, arg, cnt, flag) \
+    { key, sizeof(key) - 1, JSON_FT_BITMASK, flag, offsetof(T, m), 0, 0, 0, 0, NULL, NULL }
+#define JSON_FIELD_TIME(T, key, m, arg, cnt, flag) \
+    { key, sizeof(key) - 1, JSON_FT_TIME, flag, offsetof(T, m), arg, 0, 0, offsetof(T, cnt), NULL, NULL }
+#define JSON_FIELD_OBJECT(T, key, m, arg, cnt, flag) \
+    { key, sizeof(key) - 1, JSON_FT_OBJECT, flag, offsetof(T, m), 0, 0, 0, 0, &arg, NULL }
+#define JSON_FIELD_STRING_ARRAY(T, key, m, arg, cnt, flag) \
+    { key, sizeof(key) - 1, JSON_FT_STRING_ARRAY, flag, offsetof(T, m), arg, JSON_MEMBER_ITEMS(T, m), JSON_MEMBER_ELEM(T, m), offsetof(T, cnt), NULL, NULL }
+#define JSON_FIELD_OBJECT_ARRAY(T, key, m, arg, cnt, flag) \
+    { key, sizeof(key) - 1, JSON_FT_OBJECT_ARRAY, flag, offsetof(T, m), 0, JSON_MEMBER_ITEMS(T, m), JSON_MEMBER_ELEM(T, m), offsetof(T, cnt), &arg, NULL }
+#define JSON_FIELD_ENUM(T, key, m, arg, cnt, flag) \
+    { key, sizeof(key) - 1, JSON_FT_ENUM, flag, offsetof(T, m), 0, 0, 0, 0, NULL, &arg }
+#define JSON_FIELD_ENUM_ARRAY(T, key, m, arg, cnt, flag) \
+    { key, sizeof(key) - 1, JSON_FT_ENUM_ARRAY, flag, offsetof(T, m), 0, JSON_MEMBER_ITEMS(T, m), JSON_MEMBER_ELEM(T, m), offsetof(T, cnt), NULL, &arg }
+
+#define JSON_BIND_ENTRY(T, kind, key, m, arg, cnt, flag)	JSON_FIELD_##kind(T, key, m, arg, cnt, flag),
+
+#define JSON_DEFINE_BINDING(name, T, LIST) \
+    static const JsonFieldDesc name##Field[] = { LIST(JSON_BIND_ENTRY, T) }; \
+    static JsonBinding name = { #T, name##Field, sizeof(name##Field) / sizeof(name##Field[0]), sizeof(T), 0, 0, 0, { 0 } }
+
+#define JSON_DEFINE_ENUM(name, LIST) \
+    static const char *const name##Name[] = { LIST(JSON_ENUM_NAME) }; \
+    static JsonEnum name = { #LIST, name##Name, sizeof(name##Name) / sizeof(name##Name[0]), 0, { 0 }, 0, 0, { 0 } }
+
+JSON_DEFINE_ENUM(json_enumMonType, SCS_MON_TYPE_LIST);
+JSON_DEFINE_ENUM(json_enumEvtType, SCS_EVT_TYPE_LIST);
+JSON_DEFINE_ENUM(json_enumLocType, SCS_LOC_TYPE_LIST);
+JSON_DEFINE_ENUM(json_enumAccuracy, SCS_ACCURACY_LIST);
+JSON_DEFINE_ENUM(json_enumGrpType, SCS_GRP_TYPE_LIST);
+JSON_DEFINE_ENUM(json_enumAssoMon, SCS_ASSO_MON_LIST);
+JSON_DEFINE_ENUM(json_enumCommInd, SCS_COMM_IND_LIST);
+JSON_DEFINE_ENUM(json_enumStationary, SCS_STATIONARY_LIST);
+
+#define SCS_VALIDITY_FIELDS(X, T) \
+    X(T, TIME,          "startTime",        start_time,     MAX_SCS_TIME_LEN,       start_epoch,    JSON_FIELD_REQUIRED) \
+    X(T, TIME,          "expiryTime",       expiry_time,    MAX_SCS_TIME_LEN,       expiry_epoch,   JSON_FIELD_REQUIRED)
+
+#define SCS_RCHBLE_MON_FIELDS(X, T) \
+    X(T, ENUM_ARRAY,    "eventType",        event_type,     json_enumEvtType,       event_number,   JSON_FIELD_REQUIRED) \
+    X(T, INT,           "maximumLatency",   max_latency,    0,                      _,              JSON_FIELD_REQUIRED) \
+    X(T, INT,           "maximumResponse",  max_resp,       0,                      _,              JSON_FIELD_REQUIRED)
+
+#define SCS_LOC_MON_FIELDS(X, T) \
+    X(T, ENUM,          "locationType",     loc_type,       json_enumLocType,       _,              JSON_FIELD_REQUIRED) \
+    X(T, ENUM,          "accuracy",         accuracy,       json_enumAccuracy,      _,              JSON_FIELD_REQUIRED)
+
+#define SCS_GROUP_MON_FIELDS(X, T) \
+    X(T, ENUM,          "groupType",        group_type,     json_enumGrpType,       _,              JSON_FIELD_REQUIRED) \
+    X(T, STRING,        "groupValue",       group_value,    MAX_SCS_GRP_VAL_LEN,    _,              JSON_FIELD_REQUIRED)
+
+JSON_DEFINE_BINDING(json_bindValidity, Scs_validity_t, SCS_VALIDITY_FIELDS);
+JSON_DEFINE_BINDING(json_bindRchbleMon, Scs_rchble_mon_t, SCS_RCHBLE_MON_FIELDS);
+JSON_DEFINE_BINDING(json_bindLocMon, Scs_loc_mon_t, SCS_LOC_MON_FIELDS);
+JSON_DEFINE_BINDING(json_bindGroupMon, Scs_group_mon_t, SCS_GROUP_MON_FIELDS);
+
+#define SCS_MON_SET_FIELDS(X, T) \
+    X(T, ENUM,          "monitorType",      mon_type,       json_enumMonType,       _,              JSON_FIELD_REQUIRED) \
+    X(T, OBJECT,        "validity",         validity,       json_bindValidity,      _,              JSON_FIELD_REQUIRED) \
+    X(T, INT,           "reportNumber",     report_num,     0,                      _,              JSON_FIELD_REQUIRED) \
+    X(T, STRING,        "chargingNumber",   charging_num,   MAX_SCS_CHARGE_NUM_LEN, _,              JSON_FIELD_REQUIRED) \
+    X(T, OBJECT,        "reachableMonitor", rch_mon,        json_bindRchbleMon,     _,              JSON_FIELD_REQUIRED) \
+    X(T, ENUM_ARRAY,    "associationMonitor", ass_mon,      json_enumAssoMon,       ass_number,     JSON_FIELD_REQUIRED) \
+    X(T, OBJECT,        "locationMonitor",  loc_mon,        json_bindLocMon,        _,              JSON_FIELD_REQUIRED) \
+    X(T, OBJECT,        "groupMonitor",     grp_mon,        json_bindGroupMon,      _,              JSON_FIELD_REQUIRED)
+
+#define SCS_SCHEDULE_COMM_FIELDS(X, T) \
+    X(T, INT,           "timeOfDayStart",   time_of_day_start, 0,                   _,              JSON_FIELD_OPTIONAL) \
+    X(T, INT,           "timeOfDayEnd",     time_of_day_end, 0,                     _,              JSON_FIELD_OPTIONAL) \
+    X(T, BITMASK,       "dayOfWeekMask",    day_of_week_mask, 0,                    _,              JSON_FIELD_OPTIONAL) \
+    X(T, INT,           "timezoneFlag",     timezone_flag,  0,                      _,              JSON_FIELD_OPTIONAL)
+
+#define SCS_PERIOD_COMM_FIELDS(X, T) \
+    X(T, ENUM,          "commIndicator",    comm_indicator, json_enumCommInd,       _,              JSON_FIELD_OPTIONAL) \
+    X(T, INT,           "duration",         duration,       0,                      _,              JSON_FIELD_OPTIONAL) \
+    X(T, INT,           "interval",         interval,       0,                      _,              JSON_FIELD_OPTIONAL)
+
+JSON_DEFINE_BINDING(json_bindMonSet, Scs_mon_set_t, SCS_MON_SET_FIELDS);
+JSON_DEFINE_BINDING(json_bindScheduleComm, Scs_schedule_comm_t, SCS_SCHEDULE_COMM_FIELDS);
+JSON_DEFINE_BINDING(json_bindPeriodComm, Scs_period_comm_t, SCS_PERIOD_COMM_FIELDS);
+
+#define SCS_PARAM_SET_FIELDS(X, T) \
+    X(T, OBJECT,        "periodicCommunication", period_comm, json_bindPeriodComm,  _,              JSON_FIELD_REQUIRED) \
+    X(T, OBJECT_ARRAY,  "scheduledCommunication", sched_comm, json_bindScheduleComm, sched_comm_number, JSON_FIELD_REQUIRED) \
+    X(T, ENUM,          "stationary",       stationary,     json_enumStationary,    _,              JSON_FIELD_OPTIONAL)
+
+JSON_DEFINE_BINDING(json_bindParamSet, Scs_param_set_t, SCS_PARAM_SET_FIELDS);
+
+#define SCS_NIDD_INFO_FIELDS(X, T) \
+    X(T, STRING,        "scsRefereneId",    scs_ref_id,     MAX_SCS_REF_ID_LEN,     _,              JSON_FIELD_REQUIRED) \
+    X(T, STRING,        "scsId",            scs_id,         MAX_SCS_ID_LEN,         _,              JSON_FIELD_REQUIRED) \
+    X(T, STRING_ARRAY,  "address",          address,        MAX_SCS_ADDRESS_LEN,    address_number, JSON_FIELD_REQUIRED) \
+    X(T, OBJECT,        "validity",         validity,       json_bindValidity,      _,              JSON_FIELD_REQUIRED)
+
+#define SCS_CP_INFO_FIELDS(X, T) \
+    X(T, STRING,        "scsRefereneId",    scs_ref_id,     MAX_SCS_REF_ID_LEN,     _,              JSON_FIELD_REQUIRED) \
+    X(T, STRING,        "scsId",            scs_id,         MAX_SCS_ID_LEN,         _,              JSON_FIELD_OPTIONAL) \
+    X(T, STRING_ARRAY,  "address",          address,        MAX_SCS_ADDRESS_LEN,    address_number, JSON_FIELD_REQUIRED) \
+    X(T, OBJECT,        "validity",         validity,       json_bindValidity,      _,              JSON_FIELD_REQUIRED) \
+    X(T, OBJECT,        "parameterSet",     param_set,      json_bindParamSet,      _,              JSON_FIELD_REQUIRED)
+
+#define SCS_EVT_INFO_FIELDS(X, T) \
+    X(T, STRING,        "scsRefereneId",    scs_ref_id,     MAX_SCS_REF_ID_LEN,     _,              JSON_FIELD_REQUIRED) \
+    X(T, STRING,        "scsId",            scs_id,         MAX_SCS_ID_LEN,         _,              JSON_FIELD_OPTIONAL) \
+    X(T, STRING_ARRAY,  "address",          address,        MAX_SCS_ADDRESS_LEN,    address_number, JSON_FIELD_REQUIRED) \
+    X(T, OBJECT_ARRAY,  "monitorSet",       mon_set,        json_bindMonSet,        monset_number,  JSON_FIELD_REQUIRED) \
+    X(T, STRING,        "destinationAddress", dest_addr,    MAX_SCS_DEST_ADDR_LEN,  _,              JSON_FIELD_OPTIONAL)
+
+JSON_DEFINE_BINDING(json_bindNiddInfo, Scs_nidd_info_t, SCS_NIDD_INFO_FIELDS);
+JSON_DEFINE_BINDING(json_bindCpInfo, Scs_cp_info_t, SCS_CP_INFO_FIELDS);
+JSON_DEFINE_BINDING(json_bindEvtInfo, Scs_evt_info_t, SCS_EVT_INFO_FIELDS);
+
+/**
+ * @fn static unsigned int json_bindHash(const char *key, int len, unsigned int seed)
+ * @brief Seeded FNV-1a, the seed is searched until the keys of a table do not collide.
+ * @param key
+ * @param len
+ * @param seed
+ */
+static unsigned int json_bindHash(const char *key, int len, unsigned int seed)
+{
+    unsigned int hash = 2166136261u ^ seed;
+    int i;
+
+    for (i = 0; i < len; i++)
+        hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+
+    return hash ^ (hash >> 15);
+}
+
+/**
+ * @fn static int json_buildBinding(JsonBinding *bind)
+ * @brief Builds the perfect hash of a field table, json_initLock held.
+ * @param bind
+ */
+static int json_buildBinding(JsonBinding *bind)
+{
+    unsigned int seed, mask, slot;
+    int i;
+
+    if (bind->fieldNum > JSON_BIND_MAX_FIELD) {
+        printf("[%s] %s has %d fields, max %d\n", __func__, bind->name, bind->fieldNum, JSON_BIND_MAX_FIELD);
+        return -1;
+    }
+
+    for (mask = 7; mask + 1 < (unsigned int)bind->fieldNum * 2; mask = mask * 2 + 1) ;
+
+    for (; mask < JSON_BIND_SLOT; mask = mask * 2 + 1) {
+        for (seed = 0; seed < 4096; seed++) {
+            memset(bind->slot, 0, sizeof(bind->slot));
+            for (i = 0; i < bind->fieldNum; i++) {
+                slot = json_bindHash(bind->field[i].key, bind->field[i].keyLen, seed) & mask;
+                if (bind->slot[slot] != 0) break;
+                bind->slot[slot] = i + 1;
+            }
+            if (i == bind->fieldNum) {
+                bind->seed = seed;
+                bind->mask = mask;
+                JSON_SET_READY(bind->ready);
+                return 1;
+            }
+        }
+    }
+
+    printf("[%s] no perfect hash for %s\n", __func__, bind->name);
+    return -1;
+}
+
+/**
+ * @fn static int json_initBinding(JsonBinding *bind)
+ * @brief Perfect hash of a field table, built by the first thread needing it.
+ * @param bind
+ */
+static int json_initBinding(JsonBinding *bind)
+{
+    int r = 1;
+
+    pthread_mutex_lock(&json_initLock);
+    if (!bind->ready) r = json_buildBinding(bind);
+    pthread_mutex_unlock(&json_initLock);
+    return r;
+}
+
+/**
+ * @fn static const JsonFieldDesc *json_bindLookup(JsonBinding *bind, const char *key, int len)
+ * @brief Field of a key, NULL if the table does not have it.
+ * @param bind
+ * @param key
+ * @param len
+ */
+static const JsonFieldDesc *json_bindLookup(JsonBinding *bind, const char *key, int len)
+{
+    const JsonFieldDesc *f;
+    int idx;
+
+    idx = bind->slot[json_bindHash(key, len, bind->seed) & bind->mask];
+    if (idx == 0) return NULL;
+
+    f = &bind->field[idx - 1];
+    if (f->keyLen != len || memcmp(f->key, key, len)) return NULL;
+    return f;
+}
+
+/* ASCII lower case, the names are compared without the locale of strncasecmp() */
+#define JSON_ENUM_FOLD(c)			((unsigned int)((unsigned char)(c) - 'A') < 26 ? (unsigned char)(c) | 0x20 : (unsigned char)(c))
+
+/**
+ * @fn static unsigned int json_enumHash(const char *name, int len, unsigned int seed)
+ * @brief Seeded hash of the length and of the first, middle and last bytes folded to lower case.
+ *        The names of a table are few and short, these bytes tell them apart
+ *        without reading the whole value; the compare checks the rest.
+ * @param name
+ * @param len
+ * @param seed
+ */
+static unsigned int json_enumHash(const char *name, int len, unsigned int seed)
+{
+    unsigned int hash;
+
+    if (len <= 0) return seed;
+
+    hash = (unsigned int)len ^ (JSON_ENUM_FOLD(name[0]) << 8) ^
+           (JSON_ENUM_FOLD(name[len / 2]) << 16) ^ (JSON_ENUM_FOLD(name[len - 1]) << 24);
+    hash = (hash ^ seed) * 0x9e3779b1u;
+    return hash ^ (hash >> 15);
+}
+
+/**
+ * @fn static int json_buildEnum(JsonEnum *tab)
+ * @brief Builds the perfect hash of a name table, json_initLock held.
+ * @param tab
+ */
+static int json_buildEnum(JsonEnum *tab)
+{
+    unsigned int seed, slot;
+    int i;
+
+    if (tab->nameNum * 2 > JSON_ENUM_SLOT) {
+        printf("[%s] %s has %d names, max %d\n", __func__, tab->name, tab->nameNum, JSON_ENUM_SLOT / 2);
+        return -1;
+    }
+
+    for (i = 0; i < tab->nameNum; i++)
+        tab->nameLen[i] = strlen(tab->names[i]);
+
+    for (tab->mask = 7; tab->mask + 1 < (unsigned int)tab->nameNum * 2; tab->mask = tab->mask * 2 + 1) ;
+
+    for (; tab->mask < JSON_ENUM_SLOT; tab->mask = tab->mask * 2 + 1) {
+        for (seed = 0; seed < 4096; seed++) {
+            memset(tab->slot, 0, sizeof(tab->slot));
+            for (i = 0; i < tab->nameNum; i++) {
+                slot = json_enumHash(tab->names[i], tab->nameLen[i], seed) & tab->mask;
+                if (tab->slot[slot] != 0) break;
+                tab->slot[slot] = i + 1;
+            }
+            if (i == tab->nameNum) {
+                tab->seed = seed;
+                JSON_SET_READY(tab->ready);
+                return 1;
+            }
+        }
+    }
+
+    printf("[%s] no perfect hash for %s\n", __func__, tab->name);
+    return -1;
+}
+
+/**
+ * @fn static int json_initEnum(JsonEnum *tab)
+ * @brief Perfect hash of a name table, built by the first thread needing it.
+ * @param tab
+ */
+static int json_initEnum(JsonEnum *tab)
+{
+    int r = 1;
+
+    pthread_mutex_lock(&json_initLock);
+    if (!tab->ready) r = json_buildEnum(tab);
+    pthread_mutex_unlock(&json_initLock);
+    return r;
+}
+
+/**
+ * @fn int json_enumCode(JsonEnum *tab, const char *str, int len)
+ * @brief Code of a name, the case is ignored.
+ * @param tab
+ * @param str
+ * @param len
+ * @return code, -1 if the name is not in the table
+ */
+int json_enumCode(JsonEnum *tab, const char *str, int len)
+{
+    const char *name;
+    int idx, i;
+
+    if (!JSON_IS_READY(tab->ready) && json_initEnum(tab) < 0) return -1;
+
+    idx = tab->slot[json_enumHash(str, len, tab->seed) & tab->mask];
+    if (idx == 0) return -1;
+
+    name = tab->names[idx - 1];
+    if (tab->nameLen[idx - 1] != len) return -1;
+    if (!memcmp(name, str, len)) return idx - 1;
+    for (i = 0; i < len; i++)
+        if (JSON_ENUM_FOLD(name[i]) != JSON_ENUM_FOLD(str[i])) return -1;
+    return idx - 1;
+}
+
+/**
+ * @fn const char *json_enumName(const JsonEnum *tab, int code)
+ * @brief Name of a code, "" if the code is not in the table ( e.g. -1 of an absent field ).
+ * @param tab
+ * @param code
+ */
+const char *json_enumName(const JsonEnum *tab, int code)
+{
+    if (code < 0 || code >= tab->nameNum) return "";
+    return tab->names[code];
+}
+
+/**
+ * @fn int json_viewEnum(JsonView v, JsonEnum *tab, int *result)
+ * @brief Code of a string or primitive in tab.
+ * @param v
+ * @param tab
+ * @param result
+ * @return 1, -1 if missing, not a scalar or not in tab
+ */
+int json_viewEnum(JsonView v, JsonEnum *tab, int *result)
+{
+    const char *ptr;
+    int len, code;
+
+    if (JSON_VIEW_SPAN(v, ptr, len) < 0) return -1;
+    if ((code = json_enumCode(tab, ptr, len)) < 0) return -1;
+
+    *result = code;
+    return 1;
+}
+
+/**
+ * @fn static void json_clearField(const JsonFieldDesc *f, char *base)
+ * @brief Value of an absent optional field : "" for strings, -1 for numbers, 0 elements for arrays.
+ * @param f
+ * @param base
+ */
+static void json_clearField(const JsonFieldDesc *f, char *base)
+{
+    int i;
+
+    switch (f->type) {
+        case JSON_FT_STRING:
+            base[f->offset] = 0;
+            break;
+        case JSON_FT_TIME:
+            base[f->offset] = 0;
+            *(time_t *)(base + f->countOffset) = -1;
+            break;
+        case JSON_FT_INT:
+        case JSON_FT_BITMASK:
+        case JSON_FT_ENUM:
+            *(int *)(base + f->offset) = -1;
+            break;
+        case JSON_FT_OBJECT:
+            for (i = 0; i < f->sub->fieldNum; i++)
+                json_clearField(&f->sub->field[i], base + f->offset);
+            break;
+        case JSON_FT_STRING_ARRAY:
+        case JSON_FT_OBJECT_ARRAY:
+        case JSON_FT_ENUM_ARRAY:
+            *(int *)(base + f->countOffset) = 0;
+            break;
+    }
+}
+
+/**
+ * @fn static int json_decodeField(JsonView val, const JsonFieldDesc *f, char *base)
+ * @brief Stores one value at its place in the struct.
+ * @param val
+ * @param f
+ * @param base
+ */
+static int json_decodeField(JsonView val, const JsonFieldDesc *f, char *base)
+{
+    JsonView elem;
+    int num;
+
+    switch (f->type) {
+        case JSON_FT_STRING:
+            return json_viewString(val, base + f->offset, f->maxLen);
+        case JSON_FT_INT:
+            return json_viewInt(val, (int *)(base + f->offset));
+        case JSON_FT_BITMASK:
+            return json_viewBitMask(val, (int *)(base + f->offset));
+        case JSON_FT_ENUM:
+            if (json_viewEnum(val, f->names, (int *)(base + f->offset)) < 0) {
+                printf("[%s] key(%s) value is not one of %s\n", __func__, f->key, f->names->name);
+                return -1;
+            }
+            return 1;
+        case JSON_FT_TIME:
+            if (json_viewTime(val, (time_t *)(base + f->countOffset)) < 0) return -1;
+            return json_viewString(val, base + f->offset, f->maxLen);
+        case JSON_FT_OBJECT:
+            return json_decodeObject(val, f->sub, base + f->offset);
+        case JSON_FT_STRING_ARRAY:
+        case JSON_FT_OBJECT_ARRAY:
+        case JSON_FT_ENUM_ARRAY:
+            num = json_viewCount(val);
+            if (val.tok->type != JSON_ARRAY || num > f->maxItem) {
+                printf("[%s] key(%s) array number(%d) is over %d\n", __func__, f->key, num, f->maxItem);
+                return -1;
+            }
+            if (num == 0 && (f->flag & JSON_FIELD_REQUIRED)) return -1;
+
+            for (num = 0, elem = json_viewChild(val); elem.tok != NULL; num++, elem = json_viewNext(elem)) {
+                if (f->type == JSON_FT_STRING_ARRAY) {
+                    if (json_viewString(elem, base + f->offset + num * f->elemSize, f->maxLen) < 0) return -1;
+                } else if (f->type == JSON_FT_ENUM_ARRAY) {
+                    if (json_viewEnum(elem, f->names, (int *)(base + f->offset + num * f->elemSize)) < 0) {
+                        printf("[%s] key(%s) value is not one of %s\n", __func__, f->key, f->names->name);
+                        return -1;
+                    }
+                } else {
+                    if (json_decodeObject(elem, f->sub, base + f->offset + num * f->elemSize) < 0) return -1;
+                }
+            }
+            *(int *)(base + f->countOffset) = num;
+            return num;
+    }
+    return -1;
+}
+
+/**
+ * @fn int json_decodeObject(JsonView obj, JsonBinding *bind, void *out)
+ * @brief Fills out from the members of obj in one walk, unknown keys are ignored.
+ * @param obj
+ * @param bind
+ * @param out
+ * @return 1, -1 if a value does not fit its field or a required field is missing
+ */
+int json_decodeObject(JsonView obj, JsonBinding *bind, void *out)
+{
+    const JsonFieldDesc *f;
+    JsonView k, val;
+    unsigned int seen = 0;
+    int i;
+
+    if (obj.tok == NULL || obj.tok->type != JSON_OBJECT) return -1;
+    if (!JSON_IS_READY(bind->ready) && json_initBinding(bind) < 0) return -1;
+
+    for (k = json_viewChild(obj); k.tok != NULL; k = json_viewNext(val)) {
+        val = json_viewNext(k);
+        if (val.tok == NULL) break;
+
+        f = json_bindLookup(bind, &k.js[k.tok->start], k.tok->end - k.tok->start);
+        if (f == NULL) continue;
+
+        if (json_decodeField(val, f, (char *)out) < 0) {
+            printf("[%s] can't get(%s) data from json\n", bind->name, f->key);
+            return -1;
+        }
+        seen |= 1u << (f - bind->field);
+    }
+
+    for (i = 0; i < bind->fieldNum; i++) {
+        if (seen & (1u << i)) continue;
+
+        f = &bind->field[i];
+        if (f->flag & JSON_FIELD_REQUIRED) {
+            printf("[%s] can't get(%s) data from json\n", bind->name, f->key);
+            return -1;
+        }
+        json_clearField(f, (char *)out);
+    }
+
+    return 1;
+}
+
+/**
+ * @fn int json_decodeResource(const char *js, JsonToken *tokens, int tokenNum, const char *name, JsonBinding *bind, void *out)
+ * @brief Decodes { "<name>" : { ... } } into out.
+ * @param js
+ * @param tokens
+ * @param tokenNum
+ * @param name
+ * @param bind
+ * @param out
+ */
+int json_decodeResource(const char *js, JsonToken *tokens, int tokenNum, const char *name, JsonBinding *bind, void *out)
+{
+    JsonView res;
+
+    if (tokenNum <= 0) return -1;
+
+    res = json_viewMember(json_viewOf(js, tokens), name);
+    if (res.tok == NULL) {
+        printf("[%s] can't get resource(%s)\n", __func__, name);
+        return -1;
+    }
+
+    return json_decodeObject(res, bind, out);
+}
+
+
+/* Escape of every byte : 0 copied as is, 'u' written as \u00XX */
+static const char json_escapeChar[256] =
+{
+    ['"'] = '"', ['\\'] = '\\', ['\b'] = 'b', ['\f'] = 'f', ['\n'] = 'n', ['\r'] = 'r', ['\t'] = 't',
+    [0x00] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u', [0x04] = 'u', [0x05] = 'u', [0x06] = 'u', [0x07] = 'u',
+    [0x0b] = 'u', [0x0e] = 'u', [0x0f] = 'u',
+    [0x10] = 'u', [0x11] = 'u', [0x12] = 'u', [0x13] = 'u', [0x14] = 'u', [0x15] = 'u', [0x16] = 'u', [0x17] = 'u',
+    [0x18] = 'u', [0x19] = 'u', [0x1a] = 'u', [0x1b] = 'u', [0x1c] = 'u', [0x1d] = 'u', [0x1e] = 'u', [0x1f] = 'u'
+};
+
+static const char json_digitPair[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/**
+ * @fn void json_initWriter(JsonWriter *w, char *buf, size_t size)
+ * @brief Starts a document in buf, more buffers may be chained with json_addWriterBuffer().
+ * @param w
+ * @param buf
+ * @param size
+ */
+void json_initWriter(JsonWriter *w, char *buf, size_t size)
+{
+    w->segNum = 0;
+    w->cur = 0;
+    w->iovNum = 0;
+    w->total = 0;
+    w->depth = 0;
+    w->error = 0;
+    w->ptr = w->end = w->mark = NULL;
+    json_addWriterBuffer(w, buf, size);
+}
+
+/**
+ * @fn int json_addWriterBuffer(JsonWriter *w, char *buf, size_t size)
+ * @brief Chains one more output buffer.
+ * @param w
+ * @param buf
+ * @param size
+ */
+int json_addWriterBuffer(JsonWriter *w, char *buf, size_t size)
+{
+    if (w->segNum >= JSON_WRITER_MAX_SEG) return -1;
+
+    w->seg[w->segNum] = buf;
+    w->segSize[w->segNum] = size;
+    if (w->segNum++ == w->cur)
+    {
+        w->ptr = w->mark = buf;
+        w->end = buf + size;
+    }
+    return 1;
+}
+
+/**
+ * @fn static int json_pushIov(JsonWriter *w, const char *base, size_t len)
+ * @brief Appends a piece of output to iov, merging it with the last one when contiguous.
+ * @param w
+ * @param base
+ * @param len
+ */
+static int json_pushIov(JsonWriter *w, const char *base, size_t len)
+{
+    struct iovec *last;
+
+    if (len == 0) return 1;
+
+    last = (w->iovNum > 0) ? &w->iov[w->iovNum - 1] : NULL;
+    if (last != NULL && (char *)last->iov_base + last->iov_len == base)
+        last->iov_len += len;
+    else
+    {
+        if (w->iovNum >= JSON_WRITER_MAX_IOV)
+        {
+            w->error = 1;
+            return -1;
+        }
+        w->iov[w->iovNum].iov_base = (void *)base;
+        w->iov[w->iovNum].iov_len = len;
+        w->iovNum++;
+    }
+    w->total += len;
+    return 1;
+}
+
+/**
+ * @fn static int json_nextSegment(JsonWriter *w)
+ * @brief Closes the full buffer and switches to the next one of the chain.
+ * @param w
+ */
+static int json_nextSegment(JsonWriter *w)
+{
+    if (json_pushIov(w, w->mark, w->ptr - w->mark) < 0) return -1;
+
+    if (w->cur + 1 >= w->segNum)
+    {
+        w->error = 1;
+        w->mark = w->ptr;
+        return -1;
+    }
+    w->cur++;
+    w->ptr = w->mark = w->seg[w->cur];
+    w->end = w->ptr + w->segSize[w->cur];
+    return 1;
+}
+
+/**
+ * @fn static int json_writeRaw(JsonWriter *w, const char *src, size_t len)
+ * @brief Copies bytes, splitting them over the buffers of the chain.
+ * @param w
+ * @param src
+ * @param len
+ */
+static int json_writeRaw(JsonWriter *w, const char *src, size_t len)
+{
+    size_t room;
+
+    while (len > 0)
+    {
+        if (w->ptr == w->end && json_nextSegment(w) < 0) return -1;
+
+        room = w->end - w->ptr;
+        if (room > len) room = len;
+        memcpy(w->ptr, src, room);
+        w->ptr += room;
+        src += room;
+        len -= room;
+    }
+    return 1;
+}
+
+#define JSON_PUTC(w, c) \
+    (((w)->ptr < (w)->end) ? (*(w)->ptr++ = (c), 1) : json_writeRaw((w), &(char){ (c) }, 1))
+
+/**
+ * @fn static int json_writeEscaped(JsonWriter *w, const char *str, size_t len)
+ * @brief Writes the body of a string, runs without escapes are copied at once.
+ * @param w
+ * @param str
+ * @param len
+ */
+static int json_writeEscaped(JsonWriter *w, const char *str, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    char esc[6];
+    size_t i, run = 0;
+    unsigned char c;
+
+    for (i = 0; i < len; i++)
+    {
+        c = (unsigned char)str[i];
+        if (json_escapeChar[c] == 0) continue;
+
+        if (json_writeRaw(w, str + run, i - run) < 0) return -1;
+        esc[0] = '\\';
+        esc[1] = json_escapeChar[c];
+        if (esc[1] == 'u')
+        {
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 0xf];
+            if (json_writeRaw(w, esc, 6) < 0) return -1;
+        }
+        else if (json_writeRaw(w, esc, 2) < 0) return -1;
+        run = i + 1;
+    }
+    return json_writeRaw(w, str + run, len - run);
+}
+
+/**
+ * @fn static int json_writePrefix(JsonWriter *w, const char *key)
+ * @brief Separator and key of the next value.
+ * @param w
+ * @param key
+ */
+static int json_writePrefix(JsonWriter *w, const char *key)
+{
+    int d = w->depth - 1;
+
+    if (w->error) return -1;
+    if (d < 0) return 1;
+
+    if (!w->first[d] && JSON_PUTC(w, ',') < 0) return -1;
+    w->first[d] = 0;
+
+    if (!w->object[d]) return 1;
+    if (key == NULL)
+    {
+        w->error = 1;
+        return -1;
+    }
+    if (JSON_PUTC(w, '"') < 0 || json_writeEscaped(w, key, strlen(key)) < 0) return -1;
+    return json_writeRaw(w, "\":", 2);
+}
+
+/**
+ * @fn static int json_writeOpen(JsonWriter *w, const char *key, char c)
+ * @brief Opens an object or an array.
+ * @param w
+ * @param key
+ * @param c
+ */
+static int json_writeOpen(JsonWriter *w, const char *key, char c)
+{
+    if (json_writePrefix(w, key) < 0) return -1;
+    if (w->depth >= JSON_MAX_DEPTH)
+    {
+        w->error = 1;
+        return -1;
+    }
+    w->first[w->depth] = 1;
+    w->object[w->depth] = (c == '{');
+    w->depth++;
+    return JSON_PUTC(w, c);
+}
+
+/**
+ * @fn static int json_writeClose(JsonWriter *w, char c)
+ * @brief Closes the innermost container, which must be of the same kind.
+ * @param w
+ * @param c
+ */
+static int json_writeClose(JsonWriter *w, char c)
+{
+    if (w->error) return -1;
+    if (w->depth == 0 || w->object[w->depth - 1] != (c == '}'))
+    {
+        w->error = 1;
+        return -1;
+    }
+    w->depth--;
+    return JSON_PUTC(w, c);
+}
+
+int json_writeObjectStart(JsonWriter *w, const char *key) { return json_writeOpen(w, key, '{'); }
+int json_writeObjectEnd(JsonWriter *w) { return json_writeClose(w, '}'); }
+int json_writeArrayStart(JsonWriter *w, const char *key) { return json_writeOpen(w, key, '['); }
+int json_writeArrayEnd(JsonWriter *w) { return json_writeClose(w, ']'); }
+
+/**
+ * @fn int json_writeString(JsonWriter *w, const char *key, const char *str, size_t len)
+ * @brief Writes an escaped copy of str.
+ * @param w
+ * @param key
+ * @param str
+ * @param len
+ */
+int json_writeString(JsonWriter *w, const char *key, const char *str, size_t len)
+{
+    if (json_writePrefix(w, key) < 0) return -1;
+    if (JSON_PUTC(w, '"') < 0 || json_writeEscaped(w, str, len) < 0) return -1;
+    return JSON_PUTC(w, '"');
+}
+
+/**
+ * @fn int json_writeStringRef(JsonWriter *w, const char *key, const char *str, size_t len)
+ * @brief Like json_writeString(), but str is referenced from iov when it needs no escape.
+ *        str must then stay valid until the iovec has been written.
+ * @param w
+ * @param key
+ * @param str
+ * @param len
+ */
+int json_writeStringRef(JsonWriter *w, const char *key, const char *str, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        if (json_escapeChar[(unsigned char)str[i]]) return json_writeString(w, key, str, len);
+
+    if (json_writePrefix(w, key) < 0 || JSON_PUTC(w, '"') < 0) return -1;
+
+    /* Close the copied bytes, the value goes in its own iovec */
+    if (json_pushIov(w, w->mark, w->ptr - w->mark) < 0) return -1;
+    w->mark = w->ptr;
+    if (json_pushIov(w, str, len) < 0) return -1;
+
+    return JSON_PUTC(w, '"');
+}
+
+/**
+ * @fn static int json_formatInt(char *out, long long value)
+ * @brief Decimal text of value, two digits per step. out holds 21 bytes.
+ * @param out
+ * @param value
+ */
+static int json_formatInt(char *out, long long value)
+{
+    char tmp[20], *p = tmp + sizeof(tmp);
+    unsigned long long v;
+    int len, n = 0;
+
+    v = (value < 0) ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+
+    while (v >= 100)
+    {
+        p -= 2;
+        memcpy(p, &json_digitPair[(v % 100) * 2], 2);
+        v /= 100;
+    }
+    if (v >= 10)
+    {
+        p -= 2;
+        memcpy(p, &json_digitPair[v * 2], 2);
+    }
+    else
+        *--p = '0' + v;
+
+    if (value < 0) out[n++] = '-';
+    len = tmp + sizeof(tmp) - p;
+    memcpy(out + n, p, len);
+    return n + len;
+}
+
+/**
+ * @fn int json_writeInt(JsonWriter *w, const char *key, long long value)
+ * @brief Writes a number.
+ * @param w
+ * @param key
+ * @param value
+ */
+int json_writeInt(JsonWriter *w, const char *key, long long value)
+{
+    char num[21];
+
+    if (json_writePrefix(w, key) < 0) return -1;
+    return json_writeRaw(w, num, json_formatInt(num, value));
+}
+
+int json_writeBool(JsonWriter *w, const char *key, int value)
+{
+    if (json_writePrefix(w, key) < 0) return -1;
+    return value ? json_writeRaw(w, "true", 4) : json_writeRaw(w, "false", 5);
+}
+
+int json_writeNull(JsonWriter *w, const char *key)
+{
+    if (json_writePrefix(w, key) < 0) return -1;
+    return json_writeRaw(w, "null", 4);
+}
+
+/**
+ * @fn struct iovec *json_finishWriter(JsonWriter *w, int *iovcnt, size_t *total)
+ * @brief Output of the document for writev().
+ * @param w
+ * @param iovcnt
+ * @param total     bytes in the iovec
+ * @return NULL if the output did not fit or a container is still open
+ */
+struct iovec *json_finishWriter(JsonWriter *w, int *iovcnt, size_t *total)
+{
+    if (json_pushIov(w, w->mark, w->ptr - w->mark) < 0) return NULL;
+    w->mark = w->ptr;
+
+    if (w->error || w->depth != 0) return NULL;
+
+    *iovcnt = w->iovNum;
+    if (total != NULL) *total = w->total;
+    return w->iov;
+}
+
+/**
+ * @fn int json_writeMoIndication(JsonWriter *w, const Scs_mo_indication_t *mo)
+ * @brief {"nidd:moIndication":{"scsId":..,"scsReferenceId":..,"moData":[{"address":..,"niddData":..}]}}
+ * @param w
+ * @param mo
+ */
+int json_writeMoIndication(JsonWriter *w, const Scs_mo_indication_t *mo)
+{
+    const Scs_mo_data_t *mo_data;
+    int i;
+
+    json_writeObjectStart(w, NULL);
+    json_writeObjectStart(w, "nidd:moIndication");
+    json_writeString(w, "scsId", mo->scs_id, strlen(mo->scs_id));
+    json_writeString(w, "scsReferenceId", mo->scs_ref_id, strlen(mo->scs_ref_id));
+    json_writeArrayStart(w, "moData");
+    for (i = 0; i < mo->mo_data_number; i++) {
+        mo_data = &mo->mo_data[i];
+        json_writeObjectStart(w, NULL);
+        json_writeString(w, "address", mo_data->address, strlen(mo_data->address));
+        json_writeStringRef(w, "niddData", mo_data->nidd_data, mo_data->nidd_len);
+        json_writeObjectEnd(w);
+    }
+    json_writeArrayEnd(w);
+    json_writeObjectEnd(w);
+    json_writeObjectEnd(w);
+
+    /* Errors are sticky, one check covers every call */
+    return w->error ? -1 : 1;
+}
+
+/**
+ * @fn void json_initPatch(JsonPatch *p, const char *js, unsigned int len, char *buf, size_t size)
+ * @brief Starts the edits of the document js, whose tokens the views passed later point to.
+ * @param p
+ * @param js
+ * @param len
+ * @param buf       receives the fragments, it must outlive the iovec
+ * @param size
+ */
+void json_initPatch(JsonPatch *p, const char *js, unsigned int len, char *buf, size_t size)
+{
+    p->js = js;
+    p->len = len;
+    p->buf = buf;
+    p->size = size;
+    p->used = 0;
+    p->editNum = 0;
+    p->iovNum = 0;
+    p->total = 0;
+    p->error = 0;
+}
+
+/**
+ * @fn static void json_tokenSpan(const JsonToken *tok, unsigned int *start, unsigned int *end)
+ * @brief Bytes of a value in the text, quotes of a string included.
+ * @param tok
+ * @param start
+ * @param end
+ */
+static void json_tokenSpan(const JsonToken *tok, unsigned int *start, unsigned int *end)
+{
+    *start = tok->start - (tok->type == JSON_STRING);
+    *end = tok->end + (tok->type == JSON_STRING);
+}
+
+/**
+ * @fn static JsonPatchEdit *json_addEdit(JsonPatch *p, int kind, unsigned int start, unsigned int end)
+ * @brief Records an edit, its fragment is then appended with json_patchPut().
+ * @param p
+ * @param kind
+ * @param start
+ * @param end
+ */
+static JsonPatchEdit *json_addEdit(JsonPatch *p, int kind, unsigned int start, unsigned int end)
+{
+    JsonPatchEdit *e;
+
+    if (p->error) return NULL;
+    if (p->editNum >= JSON_PATCH_MAX_EDIT)
+    {
+        p->error = 1;
+        return NULL;
+    }
+
+    e = &p->edit[p->editNum++];
+    e->kind = kind;
+    e->start = start;
+    e->end = end;
+    e->fragOff = p->used;
+    e->fragLen = 0;
+    e->parent = e->tok = NULL;
+    return e;
+}
+
+/**
+ * @fn static int json_patchPut(JsonPatch *p, JsonPatchEdit *e, const char *src, size_t len, int escape)
+ * @brief Appends bytes to the fragment of the last edit, escaped as a string body if asked.
+ * @param p
+ * @param e
+ * @param src
+ * @param len
+ * @param escape
+ */
+static int json_patchPut(JsonPatch *p, JsonPatchEdit *e, const char *src, size_t len, int escape)
+{
+    static const char hex[] = "0123456789abcdef";
+    unsigned char c;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        c = (unsigned char)src[i];
+        if (!escape || json_escapeChar[c] == 0)
+        {
+            if (p->used >= p->size) goto full;
+            p->buf[p->used++] = c;
+            continue;
+        }
+        if (p->used + 6 > p->size) goto full;
+        p->buf[p->used++] = '\\';
+        p->buf[p->used++] = json_escapeChar[c];
+        if (json_escapeChar[c] == 'u')
+        {
+            p->buf[p->used++] = '0';
+            p->buf[p->used++] = '0';
+            p->buf[p->used++] = hex[c >> 4];
+            p->buf[p->used++] = hex[c & 0xf];
+        }
+    }
+    e->fragLen = p->used - e->fragOff;
+    return 1;
+
+    full:
+    p->error = 1;
+    return -1;
+}
+
+/**
+ * @fn int json_patchReplace(JsonPatch *p, JsonView v, const char *text, size_t len)
+ * @brief Replaces the value v by text, which is JSON as it is ( e.g. "123", "{\"a\":1}" ).
+ * @param p
+ * @param v
+ * @param text
+ * @param len
+ */
+int json_patchReplace(JsonPatch *p, JsonView v, const char *text, size_t len)
+{
+    JsonPatchEdit *e;
+    unsigned int start, end;
+
+    if (v.tok == NULL)
+    {
+        p->error = 1;
+        return -1;
+    }
+    json_tokenSpan(v.tok, &start, &end);
+    if ((e = json_addEdit(p, JSON_PATCH_REPLACE, start, end)) == NULL) return -1;
+    e->tok = v.tok;
+    return json_patchPut(p, e, text, len, 0);
+}
+
+/**
+ * @fn int json_patchReplaceString(JsonPatch *p, JsonView v, const char *str, size_t len)
+ * @brief Replaces the value v by the string str, quoted and escaped.
+ * @param p
+ * @param v
+ * @param str
+ * @param len
+ */
+int json_patchReplaceString(JsonPatch *p, JsonView v, const char *str, size_t len)
+{
+    JsonPatchEdit *e;
+    unsigned int start, end;
+
+    if (v.tok == NULL)
+    {
+        p->error = 1;
+        return -1;
+    }
+    json_tokenSpan(v.tok, &start, &end);
+    if ((e = json_addEdit(p, JSON_PATCH_REPLACE, start, end)) == NULL) return -1;
+    e->tok = v.tok;
+    if (json_patchPut(p, e, "\"", 1, 0) < 0 || json_patchPut(p, e, str, len, 1) < 0) return -1;
+    return json_patchPut(p, e, "\"", 1, 0);
+}
+
+/**
+ * @fn int json_patchReplaceInt(JsonPatch *p, JsonView v, long long value)
+ * @brief Replaces the value v by a number.
+ * @param p
+ * @param v
+ * @param value
+ */
+int json_patchReplaceInt(JsonPatch *p, JsonView v, long long value)
+{
+    char num[21];
+
+    return json_patchReplace(p, v, num, json_formatInt(num, value));
+}
+
+/**
+ * @fn int json_patchDelete(JsonPatch *p, JsonView parent, JsonView v)
+ * @brief Removes the member of the object parent whose value is v, or the element v of the array parent.
+ *        The comma after it goes too, the one before it when no member is left after it.
+ * @param p
+ * @param parent
+ * @param v
+ */
+int json_patchDelete(JsonPatch *p, JsonView parent, JsonView v)
+{
+    JsonPatchEdit *e;
+    JsonView c, prev;
+    unsigned int start, end, tmp;
+    int i, isObject;
+
+    if (parent.tok == NULL || v.tok == NULL || (parent.tok->type != JSON_OBJECT && parent.tok->type != JSON_ARRAY)) goto bad;
+    isObject = (parent.tok->type == JSON_OBJECT);
+
+    /* A member of an object spans its key, which is the token before the value */
+    prev = json_viewOf(parent.js, NULL);
+    for (c = json_viewChild(parent); c.tok != NULL; c = json_viewNext(c))
+    {
+        if (isObject && (c = json_viewNext(c)).tok == NULL) break;
+        if (c.tok == v.tok) break;
+        prev = c;
+    }
+    if (c.tok == NULL) goto bad;
+
+    /* The same member twice would be counted twice by the inserts */
+    for (i = 0; i < p->editNum; i++)
+        if (p->edit[i].kind == JSON_PATCH_DELETE && p->edit[i].tok == v.tok) goto bad;
+
+    /* The comma taken with it is known once every delete is, see json_finishPatch() */
+    json_tokenSpan(isObject ? v.tok - 1 : v.tok, &start, &tmp);
+    json_tokenSpan(v.tok, &tmp, &end);
+    if ((e = json_addEdit(p, JSON_PATCH_DELETE, start, end)) == NULL) return -1;
+    e->parent = parent.tok;
+    e->tok = v.tok;
+    e->next = json_viewNext(c);
+    if (isObject && e->next.tok != NULL) e->next = json_viewNext(e->next);
+    e->prevEnd = 0;
+    if (prev.tok != NULL) json_tokenSpan(prev.tok, &tmp, &e->prevEnd);
+    return 1;
+
+    bad:
+    p->error = 1;
+    return -1;
+}
+
+/**
+ * @fn static void json_patchComma(JsonPatch *p, JsonPatchEdit *e)
+ * @brief Widens a delete to a comma : up to the next member when one is kept after it,
+ *        else from the end of the previous member.
+ * @param p
+ * @param e
+ */
+static void json_patchComma(JsonPatch *p, JsonPatchEdit *e)
+{
+    JsonView c;
+    unsigned int tmp;
+    int i, isObject;
+
+    isObject = (e->parent->type == JSON_OBJECT);
+    for (c = e->next; c.tok != NULL; )
+    {
+        for (i = 0; i < p->editNum; i++)
+            if (p->edit[i].kind == JSON_PATCH_DELETE && p->edit[i].tok == c.tok) break;
+        if (i == p->editNum)
+        {
+            json_tokenSpan(isObject ? e->next.tok - 1 : e->next.tok, &e->end, &tmp);
+            return;
+        }
+        c = json_viewNext(c);
+        if (isObject && c.tok != NULL) c = json_viewNext(c);
+    }
+    if (e->prevEnd != 0) e->start = e->prevEnd;
+}
+
+/**
+ * @fn int json_patchInsert(JsonPatch *p, JsonView parent, const char *key, const char *text, size_t len)
+ * @brief Appends "key":text to the object parent, or text to the array parent ( key NULL ).
+ * @param p
+ * @param parent
+ * @param key
+ * @param text      JSON as it is
+ * @param len
+ */
+int json_patchInsert(JsonPatch *p, JsonView parent, const char *key, const char *text, size_t len)
+{
+    JsonPatchEdit *e;
+    unsigned int pos;
+
+    if (parent.tok == NULL || (parent.tok->type != JSON_OBJECT && parent.tok->type != JSON_ARRAY) ||
+        (parent.tok->type == JSON_OBJECT) != (key != NULL))
+    {
+        p->error = 1;
+        return -1;
+    }
+
+    /* Before the closing bracket, the comma is kept or not by json_finishPatch() */
+    pos = parent.tok->end - 1;
+    if ((e = json_addEdit(p, JSON_PATCH_INSERT, pos, pos)) == NULL) return -1;
+    e->parent = parent.tok;
+    if (json_patchPut(p, e, ",", 1, 0) < 0) return -1;
+    if (key != NULL)
+    {
+        if (json_patchPut(p, e, "\"", 1, 0) < 0 || json_patchPut(p, e, key, strlen(key), 1) < 0 ||
+            json_patchPut(p, e, "\":", 2, 0) < 0) return -1;
+    }
+    return json_patchPut(p, e, text, len, 0);
+}
+
+/**
+ * @fn static int json_patchIov(JsonPatch *p, const char *base, size_t len)
+ * @brief Appends a piece of output to iov, merging it with the last one when contiguous.
+ * @param p
+ * @param base
+ * @param len
+ */
+static int json_patchIov(JsonPatch *p, const char *base, size_t len)
+{
+    struct iovec *last;
+
+    if (len == 0) return 1;
+
+    last = (p->iovNum > 0) ? &p->iov[p->iovNum - 1] : NULL;
+    if (last != NULL && (char *)last->iov_base + last->iov_len == base)
+        last->iov_len += len;
+    else
+    {
+        if (p->iovNum >= JSON_PATCH_MAX_IOV) return -1;
+        p->iov[p->iovNum].iov_base = (void *)base;
+        p->iov[p->iovNum].iov_len = len;
+        p->iovNum++;
+    }
+    p->total += len;
+    return 1;
+}
+
+/**
+ * @fn struct iovec *json_finishPatch(JsonPatch *p, int *iovcnt, size_t *total)
+ * @brief Output of the edited document for writev().
+ *        Deletes next to each other are merged, other edits may not overlap.
+ * @param p
+ * @param iovcnt
+ * @param total     bytes in the iovec
+ * @return NULL if an edit failed or two edits overlap
+ */
+struct iovec *json_finishPatch(JsonPatch *p, int *iovcnt, size_t *total)
+{
+    JsonPatchEdit tmp, *e, *prev;
+    unsigned int pos;
+    int i, j, members, skip;
+
+    if (p->error) return NULL;
+
+    for (i = 0; i < p->editNum; i++)
+        if (p->edit[i].kind == JSON_PATCH_DELETE) json_patchComma(p, &p->edit[i]);
+
+    /* By position, inserts at the same bracket keep their order */
+    for (i = 1; i < p->editNum; i++)
+    {
+        tmp = p->edit[i];
+        for (j = i; j > 0 && p->edit[j - 1].start > tmp.start; j--) p->edit[j] = p->edit[j - 1];
+        p->edit[j] = tmp;
+    }
+
+    p->iovNum = 0;
+    p->total = 0;
+    pos = 0;
+    prev = NULL;
+    for (i = 0; i < p->editNum; i++)
+    {
+        e = &p->edit[i];
+        if (e->start < pos)
+        {
+            /* Deletes of neighbours share a comma, merged */
+            if (prev == NULL || prev->kind != JSON_PATCH_DELETE || e->kind != JSON_PATCH_DELETE) goto bad;
+            if (e->end > pos) pos = e->end;
+            continue;
+        }
+        if (json_patchIov(p, p->js + pos, e->start - pos) < 0) goto bad;
+
+        skip = 0;
+        if (e->kind == JSON_PATCH_INSERT)
+        {
+            /* The comma goes when nothing is left before it in the container */
+            members = (e->parent->type == JSON_OBJECT) ? e->parent->size / 2 : e->parent->size;
+            for (j = 0; j < p->editNum; j++)
+            {
+                if (p->edit[j].parent != e->parent) continue;
+                if (p->edit[j].kind == JSON_PATCH_DELETE) members--;
+                else if (j < i) members++;
+            }
+            skip = (members == 0);
+        }
+        if (json_patchIov(p, p->buf + e->fragOff + skip, e->fragLen - skip) < 0) goto bad;
+        pos = e->end;
+        prev = e;
+    }
+    if (json_patchIov(p, p->js + pos, p->len - pos) < 0) goto bad;
+
+    *iovcnt = p->iovNum;
+    if (total != NULL) *total = p->total;
+    return p->iov;
+
+    bad:
+    p->error = 1;
+    return NULL;
+}
+
+/**
+ * @fn static int json_binTag(unsigned char *out, int type, unsigned int len)
+ * @brief Writes the tag of a node, 1 to 5 bytes.
+ * @param out
+ * @param type
+ * @param len
+ */
+static int json_binTag(unsigned char *out, int type, unsigned int len)
+{
+    if (len < 24)
+    {
+        out[0] = (type << 5) | len;
+        return 1;
+    }
+    if (len <= 0xff)
+    {
+        out[0] = (type << 5) | 24;
+        out[1] = len;
+        return 2;
+    }
+    if (len <= 0xffff)
+    {
+        out[0] = (type << 5) | 25;
+        out[1] = len;
+        out[2] = len >> 8;
+        return 3;
+    }
+    out[0] = (type << 5) | 26;
+    JSON_BIN_PUT32(out + 1, len);
+    return 5;
+}
+
+/**
+ * @fn static int json_binIsInt(const char *ptr, int len, long long *value)
+ * @brief An integer written the way json_formatInt() writes it back, so the text survives the trip.
+ * @param ptr
+ * @param len
+ * @param value
+ */
+static int json_binIsInt(const char *ptr, int len, long long *value)
+{
+    int neg = (len > 0 && ptr[0] == '-');
+
+    if (len - neg < 1 || (ptr[neg] == '0' && (len - neg > 1 || neg))) return 0;
+    return json_spanToLong(ptr, len, value) > 0;
+}
+
+/**
+ * @fn long json_encodeBin(const char *js, JsonToken *tokens, int tokenNum, unsigned char *out, size_t size)
+ * @brief Binary form of a parsed document, in one pass over its tokens.
+ *        JSON_BIN_HEAD_LEN + tokenNum * 13 + the text length bytes are always enough.
+ * @param js
+ * @param tokens    complete document, as left by json_parseJsonLen()
+ * @param tokenNum
+ * @param out
+ * @param size
+ * @return bytes written, -1 if out is too small
+ */
+long json_encodeBin(const char *js, JsonToken *tokens, int tokenNum, unsigned char *out, size_t size)
+{
+    JsonToken *tok;
+    unsigned long long u;
+    unsigned int len;
+    long long value;
+    size_t pos;
+    int i, n;
+
+    pos = JSON_BIN_HEAD_LEN + (size_t)tokenNum * 4;
+    if (pos > size) return -1;
+
+    for (i = 0; i < tokenNum; i++)
+    {
+        tok = &tokens[i];
+        len = tok->end - tok->start;
+
+        /* Room for the biggest tag, its count and a full int */
+        if (pos + 9 > size) return -1;
+        JSON_BIN_PUT32(out + JSON_BIN_HEAD_LEN + i * 4, pos);
+
+        switch (tok->type)
+        {
+            case JSON_OBJECT:
+            case JSON_ARRAY:
+                pos += json_binTag(out + pos, tok->type == JSON_OBJECT ? JSON_BIN_OBJECT : JSON_BIN_ARRAY,
+                    tok->type == JSON_OBJECT ? tok->size / 2 : tok->size);
+                JSON_BIN_PUT32(out + pos, tok->skip);
+                pos += 4;
+                continue;
+            case JSON_PRIMITIVE:
+                if (js[tok->start] == 'n') { out[pos++] = JSON_BIN_NULL << 5; continue; }
+                if (js[tok->start] == 't' || js[tok->start] == 'f')
+                {
+                    out[pos++] = (JSON_BIN_BOOL << 5) | (js[tok->start] == 't');
+                    continue;
+                }
+                if (json_binIsInt(&js[tok->start], len, &value))
+                {
+                    /* Fewest bytes keeping the sign */
+                    for (n = 1; n < 8 && (value < -(1LL << (n * 8 - 1)) || value >= (1LL << (n * 8 - 1))); n++) ;
+                    out[pos++] = (JSON_BIN_INT << 5) | n;
+                    for (u = (unsigned long long)value; n > 0; n--, u >>= 8) out[pos++] = (unsigned char)u;
+                    continue;
+                }
+                n = JSON_BIN_NUMBER;
+                break;
+            default:
+                n = JSON_BIN_STRING;
+                break;
+        }
+
+        if (pos + 5 + len > size) return -1;
+        pos += json_binTag(out + pos, n, len);
+        memcpy(out + pos, &js[tok->start], len);
+        pos += len;
+    }
+
+    out[0] = 'J';
+    out[1] = 'B';
+    out[2] = JSON_BIN_VERSION;
+    out[3] = 0;
+    JSON_BIN_PUT32(out + 4, tokenNum);
+    JSON_BIN_PUT32(out + 8, pos);
+    return pos;
+}
+
+/**
+ * @fn int json_openBin(JsonBin *bin, const unsigned char *buf, size_t len)
+ * @brief Checks the header of a binary document, nodes are checked when read so opening costs nothing.
+ * @param bin
+ * @param buf
+ * @param len
+ */
+int json_openBin(JsonBin *bin, const unsigned char *buf, size_t len)
+{
+    unsigned int nodeNum;
+
+    if (len < JSON_BIN_HEAD_LEN || buf[0] != 'J' || buf[1] != 'B' || buf[2] != JSON_BIN_VERSION) return -1;
+
+    nodeNum = JSON_BIN_GET32(buf + 4);
+    if (JSON_BIN_GET32(buf + 8) != len || nodeNum == 0 || nodeNum > (len - JSON_BIN_HEAD_LEN) / 4) return -1;
+
+    bin->buf = buf;
+    bin->len = len;
+    bin->nodeNum = nodeNum;
+    return 1;
+}
+
+/**
+ * @fn static const unsigned char *json_binNode(JsonBinView v, int *type, unsigned int *len)
+ * @brief Tag of a node : its type, its length and where its bytes start.
+ * @param v
+ * @param type
+ * @param len
+ * @return NULL for an empty view or a node running past the document
+ */
+static const unsigned char *json_binNode(JsonBinView v, int *type, unsigned int *len)
+{
+    const unsigned char *p, *end;
+    unsigned int n;
+
+    if (v.node >= v.end) return NULL;
+
+    end = v.bin->buf + v.bin->len;
+    n = JSON_BIN_GET32(v.bin->buf + JSON_BIN_HEAD_LEN + v.node * 4);
+    if (n >= v.bin->len) return NULL;
+    p = v.bin->buf + n;
+    *type = p[0] >> 5;
+    n = p[0] & 0x1f;
+    p++;
+    if (n == 24 || n == 25 || n == 26)
+    {
+        n = (n == 24) ? 1 : (n == 25) ? 2 : 4;
+        if (p + n > end) return NULL;
+        *len = (n == 1) ? p[0] : (n == 2) ? (unsigned int)(p[0] | p[1] << 8) : JSON_BIN_GET32(p);
+        p += n;
+    }
+    else
+        *len = n;
+
+    /* What follows the tag */
+    switch (*type)
+    {
+        case JSON_BIN_OBJECT:
+        case JSON_BIN_ARRAY: n = 4; break;
+        case JSON_BIN_INT: n = *len; break;
+        case JSON_BIN_NUMBER:
+        case JSON_BIN_STRING: n = *len; break;
+        default: n = 0; break;
+    }
+    if (n > (unsigned int)(end - p)) return NULL;
+    return p;
+}
 
-    *result = atoi(str_ptr);
+/**
+ * @fn JsonBinView json_binRoot(const JsonBin *bin)
+ * @brief View of the whole document.
+ * @param bin
+ */
+JsonBinView json_binRoot(const JsonBin *bin)
+{
+    JsonBinView v;
 
-    return 1;
+    v.bin = bin;
+    v.node = 0;
+    v.end = bin->nodeNum;
+    return v;
 }
 
-int get_string_from_json_new(char *json_str, JsonToken *tokens, char *key, char *result, int max_len)
+/**
+ * @fn int json_binType(JsonBinView v)
+ * @brief JSON_BIN_xxx of a node, -1 if the view is empty.
+ * @param v
+ */
+int json_binType(JsonBinView v)
 {
-    int     i, length;
+    unsigned int len;
+    int type;
 
-    if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
-        printf("[%s] can't get %s\n", __func__, key);
-        return -1;
-	}
+    return (json_binNode(v, &type, &len) == NULL) ? -1 : type;
+}
 
-	i++;
-	length = tokens[i].end - tokens[i].start;
-	if (length > max_len) {
-        printf("[%s] can't get(%s) length(%d) is too big\n", __func__, key, length);
-        return -1;
-	}
+/**
+ * @fn static unsigned int json_binSkip(JsonBinView v)
+ * @brief Nodes of the subtree of v, 0 if it can't be read.
+ * @param v
+ */
+static unsigned int json_binSkip(JsonBinView v)
+{
+    const unsigned char *p;
+    unsigned int len, skip;
+    int type;
 
-	strncpy(result, &json_str[tokens[i].start], length);
-	result[length] = 0;
+    if ((p = json_binNode(v, &type, &len)) == NULL) return 0;
+    if (type != JSON_BIN_OBJECT && type != JSON_BIN_ARRAY) return 1;
 
-    return 1;
+    skip = JSON_BIN_GET32(p);
+    return (skip == 0 || skip > v.end - v.node) ? 0 : skip;
 }
 
-int get_address_array_from_json_new(char *json_str, JsonToken *tokens, char *key, char array_str[10][32+1], int max_item, int max_len)
+/**
+ * @fn JsonBinView json_binChild(JsonBinView v)
+ * @brief First child of an object or array, empty if there is none.
+ * @param v
+ */
+JsonBinView json_binChild(JsonBinView v)
 {
-	int    num, array_num, i, j, length;
-    struct json_object *aso, *rso;
-    const char *str_ptr;
-	char	arr_str[1024];
+    const unsigned char *p;
+    unsigned int len;
+    int type;
 
-    if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
-        printf("[%s] can't get %s\n", __func__, key);
-        return -1;
-    }
-	i++;
-    if ((i >= MAX_JSON_TOKEN_SIZE) || (tokens[i].start == 0 && tokens[i].end == 0)) {
-        printf("[%s] can't get key(%s) array number(%d) from json token size\n", __func__, key, i);
-        return -1;
-	}
-	array_num = tokens[i].size;
-    if (array_num > max_item || array_num <= 0) {
-        printf("[%s] key(%s) array number(%d) is over %d\n", __func__, key, array_num, max_item);
-        return -1;
+    if ((p = json_binNode(v, &type, &len)) == NULL || len == 0 ||
+        (type != JSON_BIN_OBJECT && type != JSON_BIN_ARRAY))
+    {
+        v.node = v.end;
+        return v;
     }
 
-    for (j=0; j < array_num; j++) {
-		i++;
-        if ((i >= MAX_JSON_TOKEN_SIZE) || (tokens[i].start == 0 && tokens[i].end == 0)) {
-        	printf("[%s] can't get %s[%d] is too big in json token\n", __func__, key, j);
-        	return -1;
-		}
-		length = tokens[i].end - tokens[i].start;
-		if (length > max_len) {
-        	printf("[%s] can't get(%s) length(%d) is too big\n", __func__, key, length);
-        	return -1;
-		}
-
-		strncpy(array_str[j], &json_str[tokens[i].start], length);
-		array_str[j][length] = 0;
-    }
-    return array_num;
+    v.end = v.node + json_binSkip(v);
+    v.node++;
+    return v;
 }
 
+/**
+ * @fn JsonBinView json_binNext(JsonBinView v)
+ * @brief Next sibling, skipping the whole subtree of v.
+ * @param v
+ */
+JsonBinView json_binNext(JsonBinView v)
+{
+    unsigned int skip = json_binSkip(v);
+
+    v.node = (skip == 0) ? v.end : v.node + skip;
+    return v;
+}
 
-int get_evttype_array_from_json_new(char *json_str, JsonToken *tokens, char *key, char array_str[MAX_SCS_EVT_TYPE_NUM][MAX_SCS_EVT_TYPE_LEN+1], int max_item, int max_len)
+/**
+ * @fn JsonBinView json_binMember(JsonBinView obj, const char *key)
+ * @brief Value of a direct member of an object, empty if not found.
+ * @param obj
+ * @param key
+ */
+JsonBinView json_binMember(JsonBinView obj, const char *key)
 {
-    int     num, array_num, i, j, length;
-    struct json_object *aso, *rso;
-    const char *str_ptr;
+    JsonBinView k, val;
+    const char *ptr = NULL;
+    int len, keyLen = strlen(key);
 
-	if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
-        printf("[%s] can't get %s\n", __func__, key);
-        return -1;
-    }
-    i++;
-    if ((i >= MAX_JSON_TOKEN_SIZE) || (tokens[i].start == 0 && tokens[i].end == 0)) {
-        printf("[%s] can't get key(%s) array number(%d) from json token\n", __func__, key, i);
-        return -1;
-    }
-    array_num = tokens[i].size;
-    if (array_num > max_item || array_num <= 0) {
-        printf("[%s] key(%s) array number(%d) is over %d\n", __func__, key, array_num, max_item);
-        return -1;
+    if (json_binType(obj) != JSON_BIN_OBJECT)
+    {
+        obj.node = obj.end;
+        return obj;
     }
 
-    for (j=0; j < array_num; j++) {
-		i++;
-        if ((i >= MAX_JSON_TOKEN_SIZE) || (tokens[i].start == 0 && tokens[i].end == 0)) {
-            printf("[%s] can't get %s[%d] is too big in json token\n", __func__, key, j);
-            return -1;
-        }
-        length = tokens[i].end - tokens[i].start;
-        if (length > max_len) {
-            printf("[%s] can't get(%s) length is too big", __func__, key, length);
-            return -1;
-        }
-
-		strncpy(array_str[j], &json_str[tokens[i].start], length);
-        array_str[j][length] = 0;
+    for (k = json_binChild(obj); k.node < k.end; k = json_binNext(val))
+    {
+        val = json_binNext(k);
+        if (val.node >= val.end) break;
+        len = json_binSpan(k, &ptr);
+        if (len == keyLen && !memcmp(ptr, key, len)) return val;
     }
-    return array_num;
+    k.node = k.end;
+    return k;
 }
 
-
-int get_assomon_array_from_json_new(char *json_str, JsonToken *tokens, char *key, char array_str[MAX_SCS_ASS_TYPE_NUM][MAX_SCS_ASSO_MON_LEN+1], int max_item, int max_len)
+/**
+ * @fn JsonBinView json_binAt(JsonBinView arr, int idx)
+ * @brief idx-th element of an array, empty if out of range.
+ * @param arr
+ * @param idx
+ */
+JsonBinView json_binAt(JsonBinView arr, int idx)
 {
-    int    num, array_num, i, j, length;
-    struct json_object *aso, *rso;
-    const char *str_ptr;
-    char    arr_str[1024];
+    JsonBinView e;
 
-    if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
-        printf("[%s] can't get %s\n", __func__, key);
-        return -1;
-    }
-    i++;
-    if ((i >= MAX_JSON_TOKEN_SIZE) || (tokens[i].start == 0 && tokens[i].end == 0)) {
-        printf("[%s] can't get key(%s) array number(%d) from json token\n", __func__, key, i);
-        return -1;
-    }
-    array_num = tokens[i].size;
-    if (array_num > max_item || array_num <= 0) {
-        printf("[%s] key(%s) array number(%d) is over %d\n", __func__, key, array_num, max_item);
-        return -1;
+    if (json_binType(arr) != JSON_BIN_ARRAY || idx < 0 || idx >= json_binCount(arr))
+    {
+        arr.node = arr.end;
+        return arr;
     }
 
-    for (j=0; j < array_num; j++) {
-        i++;
-        if ((i >= MAX_JSON_TOKEN_SIZE) || (tokens[i].start == 0 && tokens[i].end == 0)) {
-            printf("[%s] can't get %s[%d] is too big in json token\n", __func__, key, j);
-            return -1;
-        }
-        length = tokens[i].end - tokens[i].start;
-        if (length > max_len) {
-            printf("[%s] can't get(%s) length(%d) is too big\n", __func__, key, length);
-            return -1;
-        }
-
-        strncpy(array_str[j], &json_str[tokens[i].start], length);
-        array_str[j][length] = 0;
-    }
-    return array_num;
+    for (e = json_binChild(arr); e.node < e.end && idx > 0; idx--) e = json_binNext(e);
+    return e;
 }
 
-
-int get_validity_from_json_new(char *json_str, JsonToken *tokens, char *key, Scs_validity_t *validity)
+/**
+ * @fn int json_binCount(JsonBinView v)
+ * @brief Members of an object or elements of an array.
+ * @param v
+ */
+int json_binCount(JsonBinView v)
 {
-	int    num, data_num, i, j, length, max_item = 4;
-    struct json_object *aso, *rso;
-    const char *str_ptr;
-	char	arr_str[1024];
+    unsigned int len;
+    int type;
 
-    if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
-        printf("[%s] can't get %s\n", __func__, key);
-        return -1;
-    }
-	i++;
-    if ((i >= MAX_JSON_TOKEN_SIZE) || (tokens[i].start == 0 && tokens[i].end == 0)) {
-        printf("[%s] can't get key(%s) from json token\n", __func__, key);
-        return -1;
-	}
-	data_num = tokens[i].size;
-    if (data_num > max_item || data_num <= 0) {
-        printf("[%s] key(%s) array number(%d) is over %d\n", __func__, key, data_num, max_item);
-        return -1;
-    }
+    if (json_binNode(v, &type, &len) == NULL) return -1;
+    return (type == JSON_BIN_OBJECT || type == JSON_BIN_ARRAY) ? (int)len : 0;
+}
 
-	// startTime (Mandatory)
- 	if ( get_string_from_json_new(json_str, &tokens[i], "startTime", validity->start_time, MAX_SCS_TIME_LEN) < 0) {
-		printf("can't get(%s) data from json: i=[%d]\n", "startTime", i);
-		return;
-	} else {
-		printf("[DATA] %s:[%s]\n", "startTime", validity->start_time);
-	}
+/**
+ * @fn int json_binSpan(JsonBinView v, const char **ptr)
+ * @brief Bytes of a string or non integer number, in place.
+ * @param v
+ * @param ptr
+ * @return length, -1 for any other node
+ */
+int json_binSpan(JsonBinView v, const char **ptr)
+{
+    const unsigned char *p;
+    unsigned int len;
+    int type;
 
-	// expiryTime (Mandatory)
-    if ( get_string_from_json_new(json_str, &tokens[i], "expiryTime", validity->expiry_time, MAX_SCS_TIME_LEN) < 0) {
-        printf("can't get(%s) data from json: i=[%d]\n", "expiryTime", i);
-        return;
-    } else {
-		printf("[DATA] %s:[%s]\n", "expiryTime", validity->expiry_time);
-    }
+    if ((p = json_binNode(v, &type, &len)) == NULL || (type != JSON_BIN_STRING && type != JSON_BIN_NUMBER)) return -1;
 
-    return data_num;
+    *ptr = (const char *)p;
+    return len;
 }
 
+/**
+ * @fn int json_binLong(JsonBinView v, long long *result)
+ * @brief Value of an int, or of a string or number holding a decimal integer.
+ * @param v
+ * @param result
+ */
+int json_binLong(JsonBinView v, long long *result)
+{
+    const unsigned char *p;
+    unsigned long long u;
+    unsigned int len;
+    int type, i;
+
+    if ((p = json_binNode(v, &type, &len)) == NULL) return -1;
+    if (type == JSON_BIN_STRING || type == JSON_BIN_NUMBER) return json_spanToLong((const char *)p, len, result);
+    if (type != JSON_BIN_INT || len == 0 || len > 8) return -1;
+
+    /* Sign extended from the top byte */
+    u = (p[len - 1] & 0x80) ? ~0ULL : 0;
+    for (i = len - 1; i >= 0; i--) u = (u << 8) | p[i];
+    *result = (long long)u;
+    return 1;
+}
 
-JsonToken *json_object_object_get_new(char *json_str, JsonToken *tokens, char *key) 
+/**
+ * @fn int json_binString(JsonBinView v, char *result, int max_len)
+ * @brief Copies a scalar into result ( NUL terminated ), like json_viewString() : strings decoded, others as JSON text.
+ * @param v
+ * @param result
+ * @param max_len   longest value accepted, result holds max_len+1 bytes
+ * @return length, -1 if missing, not a scalar or too long
+ */
+int json_binString(JsonBinView v, char *result, int max_len)
 {
-	int    num, data_num, i, j, length, max_item = 4;
-    struct json_object *aso, *rso;
-    const char *str_ptr;
-	char	arr_str[1024];
+    const unsigned char *p;
+    const char *text;
+    char num[21];
+    unsigned int len;
+    long long value;
+    int type, length;
 
-    if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
-        printf("[%s] can't get %s\n", __func__, key);
-        return NULL;
+    if ((p = json_binNode(v, &type, &len)) == NULL) return -1;
+
+    /* Strings keep their escapes, see json_encodeBin() */
+    if (type == JSON_BIN_STRING && memchr(p, '\\', len) != NULL)
+        return json_spanUnescape((const char *)p, len, result, max_len);
+
+    switch (type)
+    {
+        case JSON_BIN_STRING:
+        case JSON_BIN_NUMBER: text = (const char *)p; length = len; break;
+        case JSON_BIN_NULL: text = "null"; length = 4; break;
+        case JSON_BIN_BOOL: text = len ? "true" : "false"; length = len ? 4 : 5; break;
+        case JSON_BIN_INT:
+            if (json_binLong(v, &value) < 0) return -1;
+            text = num;
+            length = json_formatInt(num, value);
+            break;
+        default: return -1;
     }
-	i++;
-	if ((i >= MAX_JSON_TOKEN_SIZE) || (tokens[i].start == 0 && tokens[i].end == 0)) {
-        printf("[%s] can't get key(%s) object number(%d) from json token\n", __func__, key, i);
-        return NULL;
-	}
+    if (length > max_len) return -1;
 
-	return &tokens[i];
+    memcpy(result, text, length);
+    result[length] = 0;
+    return length;
 }
 
 
-JsonToken *json_object_array_get_idx_new(char *json_str, JsonToken *tokens, int idx) 
+/* Chunk waiting for its turn when the batch is ordered */
+typedef struct JsonBatchSlot
 {
-	int i, array_cnt = 0, next_array_offset = -1;
-
-    for (i=0; i < MAX_JSON_TOKEN_SIZE; i++) {
-        if (tokens[i].start == 0 && tokens[i].end == 0) break;
-		if (tokens[i].start <= next_array_offset) continue;
-		if (tokens[i].type == JSON_OBJECT) {
-			array_cnt++;
-			next_array_offset = tokens[i].end;
-		}
-		if (array_cnt == (idx+1)) return &tokens[i];
-    }
+    int done; /* parsed, not delivered yet */
+    int docNum;
+    int docCap;
+    JsonBatchDoc *doc;
+    int *rc;
+    char *result; /* docCap results of resultSize bytes */
+} JsonBatchSlot;
 
-	return NULL;
+/**
+ * @fn void json_initBatch(JsonBatch *b, JsonBatchDecodeFunc decode, JsonBatchDeliverFunc deliver, size_t resultSize, void *arg)
+ * @brief Sets the callbacks, threadNum and flag may be changed before json_runBatch().
+ * @param b
+ * @param decode        NULL : rc is 1 for a parsed document, -1 otherwise
+ * @param deliver
+ * @param resultSize    bytes given to decode for each document
+ * @param arg
+ */
+void json_initBatch(JsonBatch *b, JsonBatchDecodeFunc decode, JsonBatchDeliverFunc deliver, size_t resultSize, void *arg)
+{
+    memset(b, 0, sizeof(JsonBatch));
+    b->decode = decode;
+    b->deliver = deliver;
+    b->resultSize = resultSize;
+    b->arg = arg;
+    b->threadNum = 0;
+    b->flag = JSON_BATCH_UNORDERED;
 }
 
-
-int get_int_bit_mask_from_json_new(char *json_str, JsonToken *tokens, char *key, int *result)
+/**
+ * @fn static const char *json_batchBound(JsonBatch *b, long c)
+ * @brief Start of chunk c : the first line starting at or after c * JSON_BATCH_CHUNK.
+ * @param b
+ * @param c
+ */
+static const char *json_batchBound(JsonBatch *b, long c)
 {
-    int     i, length, ibitmask=0;
-    char    str_ptr[1024];
+    size_t off = (size_t)c * JSON_BATCH_CHUNK;
+    const char *nl;
 
-    if ((i = json_object_index_get(json_str, tokens, key)) < 0) {
-        printf("[%s] can't get %s\n", __func__, key);
-        return -1;
-    }
+    if (c == 0) return b->buf;
+    if (off >= b->len) return b->buf + b->len;
 
-    i++;
-    length = tokens[i].end - tokens[i].start;
-    strncpy(str_ptr, &json_str[tokens[i].start], length);
-    str_ptr[length] = 0;
+    nl = (const char *)memchr(b->buf + off - 1, '\n', b->len - off + 1);
+    return (nl != NULL) ? nl + 1 : b->buf + b->len;
+}
 
-    length = strlen(str_ptr);
-    for (i=0; i<length; i++) {
-        if (str_ptr[i] != '0') ibitmask = (ibitmask<<1) | 1;
-        else ibitmask <<= 1;
+/**
+ * @fn static int json_batchGrowSlot(JsonBatch *b, JsonBatchSlot *slot)
+ * @brief Doubles the documents a slot holds.
+ * @param b
+ * @param slot
+ */
+static int json_batchGrowSlot(JsonBatch *b, JsonBatchSlot *slot)
+{
+    int cap = slot->docCap ? slot->docCap * 2 : 256;
+    JsonBatchDoc *doc;
+    int *rc;
+    char *result;
+
+    if ((doc = (JsonBatchDoc *)realloc(slot->doc, sizeof(JsonBatchDoc) * cap)) == NULL) return -1;
+    slot->doc = doc;
+    if ((rc = (int *)realloc(slot->rc, sizeof(int) * cap)) == NULL) return -1;
+    slot->rc = rc;
+    if (b->resultSize > 0) {
+        if ((result = (char *)realloc(slot->result, b->resultSize * cap)) == NULL) return -1;
+        slot->result = result;
     }
-
-    *result = ibitmask;
+    slot->docCap = cap;
     return 1;
 }
 
+/**
+ * @fn static void json_batchDeliver(JsonBatch *b, JsonBatchSlot *slot)
+ * @brief Hands the done chunks to deliver in order; whoever finds the next one done delivers it.
+ *        Called and returns with b->lock held.
+ * @param b
+ * @param slot  chunk just parsed
+ */
+static void json_batchDeliver(JsonBatch *b, JsonBatchSlot *slot)
+{
+    JsonBatchSlot *s;
+    int i;
 
-#define MAX_SCS_SCHEDULE_COMM_NUM   10
-
-typedef struct  {
-    int     time_of_day_start;
-    int     time_of_day_end;
-    int     day_of_week_mask;
-    int     timezone_flag;
-} Scs_schedule_comm_t;
+    slot->done = 1;
+    if (b->delivering) return;
 
+    b->delivering = 1;
+    while (b->nextDeliver < b->chunkNum && (s = &b->slot[b->nextDeliver % b->windowNum])->done)
+    {
+        pthread_mutex_unlock(&b->lock);
+        if (b->deliver != NULL)
+            for (i = 0; i < s->docNum; i++)
+                b->deliver(b->arg, &s->doc[i], s->result + i * b->resultSize, s->rc[i]);
+        pthread_mutex_lock(&b->lock);
+
+        s->done = 0;
+        b->nextDeliver++;
+        pthread_cond_broadcast(&b->cond);
+    }
+    b->delivering = 0;
+}
 
-int get_sched_comm_array_from_json_new(char *json_str, JsonToken *tokens, char *key, Scs_schedule_comm_t sched_comm[MAX_SCS_SCHEDULE_COMM_NUM], int max_item)
+/**
+ * @fn static void *json_batchWorker(void *arg)
+ * @brief Takes chunks until there is none left and parses their lines.
+ * @param arg   JsonBatch
+ */
+static void *json_batchWorker(void *arg)
 {
-    int     num, array_num, i, j, length, ret;
-    struct json_object *aso, *rso;
-    Scs_schedule_comm_t *sched_comm_ptr;
-	char        schedCommStr[HTTPF_MSG_BUFSIZE], bb[1024], cc[1024];
-    JsonToken   schedCommTokens[MAX_JSON_TOKEN_SIZE], *tokenPtr;
-    JsonParser  schedCommParser;
+    JsonBatch *b = (JsonBatch *)arg;
+    JsonContext *ctx = json_getContext();
+    JsonBatchSlot *slot = NULL;
+    JsonBatchDoc doc;
+    const char *ptr, *end, *nl, *js;
+    char *own = NULL, *result;
+    long c, docNum = 0, errorNum = 0;
+    int ordered = (b->flag & JSON_BATCH_ORDERED), rc, error = 0;
+
+    if (!ordered && b->resultSize > 0 && (own = (char *)malloc(b->resultSize)) == NULL)
+        error = 1;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&b->lock);
+        if (error) b->error = 1;
+        while (ordered && !b->error && b->nextChunk < b->chunkNum && b->nextChunk >= b->nextDeliver + b->windowNum)
+            pthread_cond_wait(&b->cond, &b->lock);
+        c = (b->error || b->nextChunk >= b->chunkNum) ? -1 : b->nextChunk++;
+        pthread_mutex_unlock(&b->lock);
+        if (c < 0) break;
+
+        if (ordered) {
+            slot = &b->slot[c % b->windowNum];
+            slot->docNum = 0;
+        }
 
-    if ((tokenPtr = json_object_object_get_new(json_str, tokens, key)) == NULL) {
-        printf("[%s] can't get %s\n", __func__, key);
-        return -1;
-    }
-	strncpy(schedCommStr, &json_str[tokenPtr->start], tokenPtr->end - tokenPtr->start);
-    json_initJsonParser(&schedCommParser);
-    memset(&schedCommTokens[0], 0, sizeof(JsonToken)*MAX_JSON_TOKEN_SIZE);
-    if ((ret = json_parseJson(&schedCommParser, (const char *)schedCommStr, schedCommTokens, MAX_JSON_TOKEN_SIZE)) < 0) {
-        printf("[%s] can't parse periodicCommunication(%s) ret(%d)\n", __func__, schedCommStr, ret);
-        return -1;
-    }
+        end = json_batchBound(b, c + 1);
+        for (ptr = json_batchBound(b, c); ptr < end; ptr = nl + 1)
+        {
+            if ((nl = (const char *)memchr(ptr, '\n', end - ptr)) == NULL) nl = end;
+
+            doc.line = ptr;
+            doc.lineLen = nl - ptr;
+            if (doc.lineLen > 0 && ptr[doc.lineLen - 1] == '\r') doc.lineLen--;
+            if (doc.lineLen == 0) continue;
+
+            for (js = ptr; js < ptr + doc.lineLen && *js != '{' && *js != '['; js++);
+            if (js == ptr + doc.lineLen) js = ptr;
+
+            doc.offset = ptr - b->buf;
+            doc.js = js;
+            doc.len = ptr + doc.lineLen - js;
+            doc.r = json_parseContext(ctx, doc.js, doc.len);
+            doc.tokens = ctx->tokens;
+            doc.tokenNum = ctx->tokenNum;
+            docNum++;
+            if (doc.r != JSON_SUCCESS) errorNum++;
+
+            if (ordered) {
+                if (slot->docNum == slot->docCap && json_batchGrowSlot(b, slot) < 0) {
+                    error = 1;
+                    break;
+                }
+                result = slot->result + slot->docNum * b->resultSize;
+            }
+            else result = own;
 
-	array_num = tokenPtr->size;
-    if (array_num > max_item || array_num <= 0) {
-        printf("[%s] key(%s) array number(%d) is over %d\n", __func__, key, array_num, max_item);
-        return -1;
-    } else {
-        printf("[%s] key(%s) array number(%d) and max array number(%d).\n", __func__, key, array_num, max_item);
-	}
+            if (b->decode != NULL)
+                rc = b->decode(b->arg, &doc, result);
+            else
+                rc = (doc.r == JSON_SUCCESS) ? 1 : -1;
 
-#if 0
-	printf("\n\n\n###############################################\nschedCommStr:\n");
+            /* The tokens are reused by the next line */
+            doc.tokens = NULL;
+            doc.tokenNum = 0;
 
-	for (i=0; i < MAX_JSON_TOKEN_SIZE; i++) {
-		if (schedCommTokens[i].start == 0 && schedCommTokens[i].end == 0)
-			break;
-	
-		strncpy(bb, &schedCommStr[schedCommTokens[i].start], schedCommTokens[i].end - schedCommTokens[i].start);
-		bb[schedCommTokens[i].end - schedCommTokens[i].start] = 0;
-		printf("i=%d %d %d %d %d [%s]\n", 
-				i, schedCommTokens[i].type, schedCommTokens[i].start, schedCommTokens[i].end, schedCommTokens[i].size, bb);
+            if (!ordered) {
+                if (b->deliver != NULL) b->deliver(b->arg, &doc, result, rc);
+                continue;
+            }
+            slot->doc[slot->docNum] = doc;
+            slot->rc[slot->docNum++] = rc;
+        }
 
-	}
-	printf("####################################################\n");
-#endif
+        if (ordered) {
+            pthread_mutex_lock(&b->lock);
+            json_batchDeliver(b, slot);
+            pthread_mutex_unlock(&b->lock);
+        }
+    }
 
-	char        schedCommArrayStr[HTTPF_MSG_BUFSIZE];
-    JsonToken   schedCommArrayTokens[MAX_JSON_TOKEN_SIZE];
-    JsonParser  schedCommArrayParser;
-    for (i=0; i < array_num; i++) {
-        if ((tokenPtr = json_object_array_get_idx_new(schedCommStr, schedCommTokens, i)) == NULL) {
-        	printf("[%s] can't get schedCommArray[%d] from (%s) ret(%d)\n", __func__, i, schedCommArrayStr, ret);
-        	return -1;
-		}
-		strncpy(schedCommArrayStr, &schedCommStr[tokenPtr->start], tokenPtr->end - tokenPtr->start);
-    	json_initJsonParser(&schedCommArrayParser);
-    	memset(&schedCommArrayTokens[0], 0, sizeof(JsonToken)*MAX_JSON_TOKEN_SIZE);
-    	if ((ret = json_parseJson(&schedCommArrayParser, (const char *)schedCommArrayStr, schedCommArrayTokens, MAX_JSON_TOKEN_SIZE)) < 0) {
-        	printf("[%s] can't parse schedCommArray(%s) ret(%d)\n", __func__, schedCommArrayStr, ret);
-        	return -1;
-    	}
+    pthread_mutex_lock(&b->lock);
+    b->docNum += docNum;
+    b->errorNum += errorNum;
+    pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->lock);
 
-#if 0
-		printf("\n\n\n###############################################\nschedCommArrayStr:[%s]\n", schedCommArrayStr);
+    free(own);
+    return NULL;
+}
 
-		for (j=0; j < MAX_JSON_TOKEN_SIZE; j++) {
-			if (schedCommArrayTokens[j].start == 0 && schedCommArrayTokens[j].end == 0) break;
-	
-			strncpy(bb, &schedCommArrayStr[schedCommArrayTokens[j].start], schedCommArrayTokens[j].end - schedCommArrayTokens[j].start);
-			bb[schedCommArrayTokens[j].end - schedCommArrayTokens[j].start] = 0;
-			printf("j=%d %d %d %d %d [%s]\n", 
-					j, schedCommArrayTokens[j].type, schedCommArrayTokens[j].start, schedCommArrayTokens[j].end, schedCommArrayTokens[j].size, bb);
+/* Pool threads release their arena, the caller keeps its own */
+static void *json_batchThread(void *arg)
+{
+    json_batchWorker(arg);
+    json_freeContext(json_getContext());
+    return NULL;
+}
 
-		}
-		printf("####################################################\n");
-#endif
+/**
+ * @fn long json_runBatch(JsonBatch *b, const char *buf, size_t len)
+ * @brief Parses every line of buf, the calling thread is one of the workers.
+ * @param b
+ * @param buf
+ * @param len
+ * @return documents seen ( b->errorNum did not parse ), -1 if out of memory or threads
+ */
+long json_runBatch(JsonBatch *b, const char *buf, size_t len)
+{
+    pthread_t tid[JSON_BATCH_MAX_THREAD];
+    int i, threadNum = b->threadNum, spawned = 0;
+
+    if (threadNum <= 0) threadNum = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threadNum <= 0) threadNum = 1;
+    if (threadNum > JSON_BATCH_MAX_THREAD) threadNum = JSON_BATCH_MAX_THREAD;
+
+    b->buf = buf;
+    b->len = len;
+    b->chunkNum = (len + JSON_BATCH_CHUNK - 1) / JSON_BATCH_CHUNK;
+    b->nextChunk = b->nextDeliver = 0;
+    b->delivering = 0;
+    b->docNum = b->errorNum = 0;
+    b->error = 0;
+    b->slot = NULL;
+    b->windowNum = 0;
+    if (threadNum > b->chunkNum) threadNum = (b->chunkNum > 0) ? (int)b->chunkNum : 1;
+
+    if (b->flag & JSON_BATCH_ORDERED) {
+        b->windowNum = threadNum * JSON_BATCH_WINDOW;
+        if ((b->slot = (JsonBatchSlot *)calloc(b->windowNum, sizeof(JsonBatchSlot))) == NULL) {
+            printf("[%s] can't alloc %d chunk slots\n", __func__, b->windowNum);
+            return -1;
+        }
+    }
 
-        sched_comm_ptr = &sched_comm[i];
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->cond, NULL);
 
-        // timeOfDayStart (Optional)
-        if (get_int_from_json_new(schedCommArrayStr, schedCommArrayTokens, "timeOfDayStart", &sched_comm_ptr->time_of_day_start) < 0) {
-            printf("[%s] can't get(%s) data from json\n", __func__, "timeOfDayStart");
-            sched_comm_ptr->time_of_day_start = -1;
-        } else {
-			printf("[DATA] timeOfDayStart[%d]=[%d]\n", i, sched_comm_ptr->time_of_day_start);
-		}
+    /* The scanner is picked lazily, do it before the workers race for it */
+    json_getScanner();
 
-        // timeOfDayEnd (Optional)
-        if (get_int_from_json_new(schedCommArrayStr, schedCommArrayTokens, "timeOfDayEnd", &sched_comm_ptr->time_of_day_end) < 0) {
-            printf("[%s] can't get(%s) data from json\n", __func__, "timeOfDayEnd");
-            sched_comm_ptr->time_of_day_end = -1;
-        } else {
-			printf("[DATA] timeOfDayEnd[%d]=[%d]\n", i, sched_comm_ptr->time_of_day_end);
+    for (i = 1; i < threadNum; i++) {
+        if (pthread_create(&tid[spawned], NULL, json_batchThread, b) != 0) {
+            printf("[%s] can't create worker %d, %d running\n", __func__, i, spawned + 1);
+            break;
         }
+        spawned++;
+    }
+    json_batchWorker(b);
+    for (i = 0; i < spawned; i++)
+        pthread_join(tid[i], NULL);
 
-        // dayOfWeekMask (Optional)
-        if (get_int_bit_mask_from_json_new(schedCommArrayStr, schedCommArrayTokens, "dayOfWeekMask", &sched_comm_ptr->day_of_week_mask) < 0) {
-            printf("[%s] can't get(%s) data from json\n", __func__, "dayOfWeekMask");
-        } else {
-			printf("[DATA] dayOfWeekMask[%d]=[%d]\n", i, sched_comm_ptr->day_of_week_mask);
-        }
+    pthread_cond_destroy(&b->cond);
+    pthread_mutex_destroy(&b->lock);
 
-        // timezoneFlag (Optional)
-        if (get_int_from_json_new(schedCommArrayStr, schedCommArrayTokens, "timezoneFlag", &sched_comm_ptr->timezone_flag) < 0) {
-            printf("[%s] can't get(%s) data from json\n", __func__, "timezoneFlag");
-        } else {
-			printf("[DATA] timezoneFlag[%d]=[%d]\n", i, sched_comm_ptr->timezone_flag);
-        }
+    for (i = 0; i < b->windowNum; i++) {
+        free(b->slot[i].doc);
+        free(b->slot[i].rc);
+        free(b->slot[i].result);
     }
+    free(b->slot);
+    b->slot = NULL;
 
-    return array_num;
+    return b->error ? -1 : b->docNum;
 }
 
-
-int get_monset_array_from_json_new(char *json_str, JsonToken *tokens, char *key, Scs_mon_set_t mon_set[MAX_SCS_MON_SET_NUM], int max_item)
+/**
+ * @fn long json_runBatchFile(JsonBatch *b, const char *path)
+ * @brief json_runBatch() over a mmap of the file, the lines are read in place.
+ * @param b
+ * @param path
+ */
+long json_runBatchFile(JsonBatch *b, const char *path)
 {
-    int     num, array_num, evt_array_num, ass_array_num, i, j, length, ret;
-    struct json_object  *aso, *rso;
-    Scs_mon_set_t       *mon_set_ptr;
-    Scs_validity_t      *validity_ptr;
-    Scs_rchble_mon_t    *rch_mon_ptr;
-    Scs_loc_mon_t       *loc_mon_ptr;
-    Scs_group_mon_t     *grp_mon_ptr;
-	char        monSetStr[HTTPF_MSG_BUFSIZE], bb[HTTPF_MSG_BUFSIZE], cc[HTTPF_MSG_BUFSIZE];
-    JsonToken   monSetTokens[MAX_JSON_TOKEN_SIZE], *tokenPtr;
-    JsonParser  monSetParser;
-
+    struct stat st;
+    char *addr;
+    long ret;
+    int fd;
 
-    if ((tokenPtr = json_object_object_get_new(json_str, tokens, key)) == NULL) {
-        printf("[%s] can't get %s\n", __func__, key);
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        printf("[%s] can't open %s\n", __func__, path);
         return -1;
     }
-	memset(monSetStr, 0x00, HTTPF_MSG_BUFSIZE);
-    strncpy(monSetStr, &json_str[tokenPtr->start], tokenPtr->end - tokenPtr->start);
-    json_initJsonParser(&monSetParser);
-    memset(&monSetTokens[0], 0, sizeof(JsonToken)*MAX_JSON_TOKEN_SIZE);
-    if ((ret = json_parseJson(&monSetParser, (const char *)monSetStr, monSetTokens, MAX_JSON_TOKEN_SIZE)) < 0) {
-        printf("[%s] can't parse monSet(%s) ret(%d)\n", __func__, monSetStr, ret);
+    if (fstat(fd, &st) < 0) {
+        close(fd);
         return -1;
     }
+    if (st.st_size == 0) {
+        close(fd);
+        return json_runBatch(b, "", 0);
+    }
 
-    array_num = tokenPtr->size;
-    if (array_num > max_item || array_num <= 0) {
-        printf("[%s] key(%s) array number(%d) is over %d\n", __func__, key, array_num, max_item);
+    addr = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        printf("[%s] can't mmap %s\n", __func__, path);
         return -1;
     }
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
 
-    char        monSetArrayStr[HTTPF_MSG_BUFSIZE];
-    JsonToken   monSetArrayTokens[MAX_JSON_TOKEN_SIZE];
-    JsonParser  monSetArrayParser;
+    ret = json_runBatch(b, addr, st.st_size);
 
-    for (i=0; i < array_num; i++) {
-        if ((tokenPtr = json_object_array_get_idx_new(monSetStr, monSetTokens, i)) == NULL) {
-            printf("[%s] can't get monSetArrayStr[%d] from (%s) ret(%d)\n", __func__, i, monSetStr, ret);
-            return -1;
-        }
-		memset(monSetArrayStr, 0x00, HTTPF_MSG_BUFSIZE);
-        strncpy(monSetArrayStr, &monSetStr[tokenPtr->start], tokenPtr->end - tokenPtr->start);
-        json_initJsonParser(&monSetArrayParser);
-        memset(&monSetArrayTokens[0], 0, sizeof(JsonToken)*MAX_JSON_TOKEN_SIZE);
-        if ((ret = json_parseJson(&monSetArrayParser, (const char *)monSetArrayStr, monSetArrayTokens, MAX_JSON_TOKEN_SIZE)) < 0) {
-            printf("[%s] can't parse monSetArray(%s) ret(%d)\n", __func__, monSetArrayStr, ret);
-            return -1;
-        }
+    munmap(addr, st.st_size);
+    return ret;
+}
 
-		printf("\n\n\n###############################################\nmonSetArrayStr:[%s]\n", monSetArrayStr);
 
-		for (j=0; j < MAX_JSON_TOKEN_SIZE; j++) {
-			if (monSetArrayTokens[j].start == 0 && monSetArrayTokens[j].end == 0) break;
-	
-			strncpy(bb, &monSetArrayStr[monSetArrayTokens[j].start], monSetArrayTokens[j].end - monSetArrayTokens[j].start);
-			bb[monSetArrayTokens[j].end - monSetArrayTokens[j].start] = 0;
-			printf("j=%d %d %d %d %d [%s]\n", 
-					j, monSetArrayTokens[j].type, monSetArrayTokens[j].start, monSetArrayTokens[j].end, monSetArrayTokens[j].size, bb);
+/**
+ * @fn static void json_initArray(JsonArrayIter *it)
+ * @brief Common part of the json_openArrayXxx().
+ * @param it
+ */
+static void json_initArray(JsonArrayIter *it)
+{
+    memset(it, 0, sizeof(JsonArrayIter));
+    json_initJsonParser(&it->ctx.parser);
+    it->fd = -1;
+    it->js = "";
+    it->index = -1;
+    it->state = JSON_ARRAY_START;
+
+    /* The elements are delimited by json_skipScan() before any parse */
+    json_getScanner();
+}
 
-		}
-		printf("####################################################\n");
+/**
+ * @fn void json_openArrayFd(JsonArrayIter *it, int fd)
+ * @brief Iterates the array read from fd, which is not closed by json_closeArray().
+ * @param it
+ * @param fd
+ */
+void json_openArrayFd(JsonArrayIter *it, int fd)
+{
+    json_initArray(it);
+    it->fd = fd;
+}
 
-        mon_set_ptr = &mon_set[i];
-        validity_ptr= &mon_set_ptr->validity;
-        rch_mon_ptr = &mon_set_ptr->rch_mon;
-        loc_mon_ptr = &mon_set_ptr->loc_mon;
-        grp_mon_ptr = &mon_set_ptr->grp_mon;
+/**
+ * @fn void json_openArrayBuffer(JsonArrayIter *it, const char *buf, size_t len)
+ * @brief Iterates the array in buf, read in place.
+ * @param it
+ * @param buf
+ * @param len
+ */
+void json_openArrayBuffer(JsonArrayIter *it, const char *buf, size_t len)
+{
+    json_initArray(it);
+    it->map = buf;
+    it->mapLen = len;
+    it->js = buf;
+    it->len = (len > JSON_ARRAY_MAX_WINDOW) ? JSON_ARRAY_MAX_WINDOW : len;
+}
 
-        // monitorType (Mandatory)
-        if (get_string_from_json_new(monSetArrayStr, monSetArrayTokens, "monitorType", mon_set_ptr->mon_type, MAX_SCS_MON_TYPE_LEN) < 0) {
-            printf("[%s] can't get(%dth in %d %s) data from json[%s] in [%s]\n", __func__, i, array_num, "monitorType", monSetArrayStr, monSetStr);
-            return -1;
-        } else {
-            printf("[DATA] %s[%d]: [%s]\n", "monitorType", i, mon_set_ptr->mon_type);
-		}
+/**
+ * @fn int json_openArrayFile(JsonArrayIter *it, const char *path)
+ * @brief Iterates the array of a file through a mmap, the pages read are given back as it goes.
+ * @param it
+ * @param path
+ * @return 1, -1 if the file can't be opened or mapped
+ */
+int json_openArrayFile(JsonArrayIter *it, const char *path)
+{
+    struct stat st;
+    char *addr;
+    int fd;
 
-        // validity (Mandatory)
-		if ( get_validity_from_json_new(monSetArrayStr, monSetArrayTokens, "validity", validity_ptr) < 0) {
-        	printf("can't get(%s) data from json\n", "validity");
-        	return;
-    	}
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        printf("[%s] can't open %s\n", __func__, path);
+        return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        json_openArrayBuffer(it, "", 0);
+        return 1;
+    }
 
-        // reportNumber (Mandatory)
-        if (get_int_from_json_new(monSetArrayStr, monSetArrayTokens, "reportNumber", &mon_set_ptr->report_num) < 0) {
-            printf("[%s] can't get(%s) data from json\n", __func__, "reportNumber");
-            return -1;
-        } else {
-            printf("[DATA] %s[%d]: [%d]\n", "reportNumber", i, mon_set_ptr->report_num);
-        }
+    addr = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        printf("[%s] can't mmap %s\n", __func__, path);
+        return -1;
+    }
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
 
-        // chargingNumber (Mandatory)
-        if (get_string_from_json_new(monSetArrayStr, monSetArrayTokens, "chargingNumber", mon_set_ptr->charging_num, MAX_SCS_CHARGE_NUM_LEN) < 0) {
-            printf("[%s] can't get(%s) data from json\n", __func__, "chargingNumber");
-            return -1;
-        } else {
-            printf("[DATA] %s[%d]: [%s]\n", "chargingNumber", i, mon_set_ptr->charging_num);
-        }
+    json_openArrayBuffer(it, addr, st.st_size);
+    it->mapOwned = 1;
+    return 1;
+}
 
-        // set of reachableMonitor (Optional)
-    	char        rechMonStr[HTTPF_MSG_BUFSIZE];
-    	JsonToken   rechMonTokens[MAX_JSON_TOKEN_SIZE];
-    	JsonParser  rechMonParser;
-
-    	if ((tokenPtr = json_object_object_get_new(monSetArrayStr, monSetArrayTokens, "reachableMonitor")) == NULL) {
-        	printf("can't parse reachableMonitor\n");
-        	return;
-    	}
-		memset(rechMonStr, 0x00, HTTPF_MSG_BUFSIZE);
-    	strncpy(rechMonStr, &monSetArrayStr[tokenPtr->start], tokenPtr->end - tokenPtr->start);
-    	json_initJsonParser(&rechMonParser);
-    	memset(&rechMonTokens[0], 0, sizeof(JsonToken)*MAX_JSON_TOKEN_SIZE);
-    	if ((ret = json_parseJson(&rechMonParser, (const char *)rechMonStr, rechMonTokens, MAX_JSON_TOKEN_SIZE)) < 0) {
-        	printf("[%s] can't parse reachableMonitor(%s) ret(%d)\n", __func__, rechMonStr, ret);
-        	return;
-		}
+/**
+ * @fn static int json_fillArray(JsonArrayIter *it)
+ * @brief Drops the bytes before pos from the window and brings in the next ones.
+ * @param it
+ * @return 1, 0 at the end of the input, -1 on a read error or an element longer than the window may be
+ */
+static int json_fillArray(JsonArrayIter *it)
+{
+    size_t last = it->offset + it->len;
+    unsigned int cap;
+    ssize_t n;
+    char *buf;
 
-        // eventType (Mandatory)
-        if ((evt_array_num = get_evttype_array_from_json_new(rechMonStr, rechMonTokens, "eventType", &rch_mon_ptr->event_type[0], MAX_SCS_EVT_TYPE_NUM, MAX_SCS_EVT_TYPE_LEN)) <= 0) {
-        	printf("[%s] can't get eventType from json ret=%d\n", __func__, evt_array_num);
-        	return;
-        }
-        printf("[DATA] eventType[%d]:[%s][%s]\n", i, rch_mon_ptr->event_type[0], rch_mon_ptr->event_type[1]);
-        rch_mon_ptr->event_number = evt_array_num;
+    it->offset += it->pos;
 
-        // maximumLatency (Mandatory)
-        if (get_int_from_json_new(rechMonStr, rechMonTokens, "maximumLatency", &rch_mon_ptr->max_latency) < 0) {
-            printf("[%s] can't get(%s) data from json\n", __func__, "maximumLatency");
-            return -1;
-		}
-        printf("[DATA] maximumLatency[%d]:[%d]\n", i, rch_mon_ptr->max_latency);
+    /* Nothing is copied : the window slides over the map */
+    if (it->fd < 0)
+    {
+        it->js += it->pos;
+        it->pos = 0;
+        it->len = (it->mapLen - it->offset > JSON_ARRAY_MAX_WINDOW) ? JSON_ARRAY_MAX_WINDOW : it->mapLen - it->offset;
+        if (it->offset + it->len > last) return 1;
+        if (it->offset + it->len == it->mapLen) return 0;
+        return json_setError(&it->ctx.parser, JSON_ERROR_NOMEM, JSON_ERRC_TOO_LONG, 0);
+    }
 
-        // maximumResponse (Mandatory)
-        if (get_int_from_json_new(rechMonStr, rechMonTokens, "maximumResponse", &rch_mon_ptr->max_resp) < 0) {
-            printf("[%s] can't get(%s) data from json\n", __func__, "maximumResponse");
-            return -1;
-        }
-        printf("[DATA] maximumResponse[%d]:[%d]\n", i, rch_mon_ptr->max_resp);
-        // end of reachableMonitor
+    if (it->eof)
+    {
+        memmove(it->buf, it->buf + it->pos, it->len - it->pos);
+        it->len -= it->pos;
+        it->pos = 0;
+        return 0;
+    }
 
-        // set of associationMonitor (Optional)
-        if ((ass_array_num = get_assomon_array_from_json_new(monSetArrayStr, monSetArrayTokens, "associationMonitor", mon_set_ptr->ass_mon, MAX_SCS_ASS_TYPE_NUM, MAX_SCS_ASSO_MON_LEN)) <= 0) {
-            printf("[%s] can't get associationMonitor from json ret=%d\n", __func__, ass_array_num);
-            return -1;
-        }
-		printf("[DATA] associationMonitor[%d]:[%s][%s]\n", i, mon_set_ptr->ass_mon[0], mon_set_ptr->ass_mon[1]);
+    /* What is left of the element goes to the front, the window doubles only if it is all element */
+    if (it->pos > 0) memmove(it->buf, it->buf + it->pos, it->len - it->pos);
+    it->len -= it->pos;
+    it->pos = 0;
+    if (it->len + 1 >= it->cap)
+    {
+        if (it->cap > JSON_ARRAY_MAX_WINDOW / 2)
+            return json_setError(&it->ctx.parser, JSON_ERROR_NOMEM, JSON_ERRC_TOO_LONG, 0);
+        cap = it->cap ? it->cap * 2 : JSON_ARRAY_MIN_BUF;
+        if ((buf = (char *)realloc(it->buf, cap)) == NULL)
+            return json_setError(&it->ctx.parser, JSON_ERROR_NOMEM, JSON_ERRC_NONE, it->len);
+        it->buf = buf;
+        it->cap = cap;
+    }
+    it->js = it->buf;
 
-        // set of locationMonitor (Optional)
-    	char        locMonStr[HTTPF_MSG_BUFSIZE];
-    	JsonToken   locMonTokens[MAX_JSON_TOKEN_SIZE];
-    	JsonParser  locMonParser;
+    /* Filled up, so the scan of a long element restarts less often */
+    cap = it->len;
+    while (it->len + 1 < it->cap)
+    {
+        n = read(it->fd, it->buf + it->len, it->cap - it->len - 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return json_setError(&it->ctx.parser, JSON_ERROR_INVAL, JSON_ERRC_READ, it->len);
+        if (n == 0)
+        {
+            it->eof = 1;
+            break;
+        }
+        it->len += n;
+    }
+    it->buf[it->len] = '\0';
+    return (it->len > cap) ? 1 : 0;
+}
 
-    	if ((tokenPtr = json_object_object_get_new(monSetArrayStr, monSetArrayTokens, "locationMonitor")) == NULL) {
-        	printf("can't parse locationMonitor\n");
-        	return -1;
-    	}
-		memset(locMonStr, 0x00, HTTPF_MSG_BUFSIZE);
-    	strncpy(locMonStr, &monSetArrayStr[tokenPtr->start], tokenPtr->end - tokenPtr->start);
-    	json_initJsonParser(&locMonParser);
-    	memset(&locMonTokens[0], 0, sizeof(JsonToken)*MAX_JSON_TOKEN_SIZE);
-    	if ((ret = json_parseJson(&locMonParser, (const char *)locMonStr, locMonTokens, MAX_JSON_TOKEN_SIZE)) < 0) {
-        	printf("[%s] can't parse locationMonitor(%s) ret(%d)\n", __func__, locMonStr, ret);
-        	return -1;
-    	}
+/**
+ * @fn static int json_arrayValueEnd(JsonArrayIter *it, unsigned int *end)
+ * @brief End of the value at pos in the window, the input is read as far as needed.
+ *        The value is delimited only, json_nextArray() tokenizes it.
+ * @param it
+ * @param end
+ * @return 1, -1 on an error or at the end of the input
+ */
+static int json_arrayValueEnd(JsonArrayIter *it, unsigned int *end)
+{
+    unsigned int p;
+    int r;
 
-        // locationType (Mandatory)
-        if (get_string_from_json_new(locMonStr, locMonTokens, "locationType", loc_mon_ptr->loc_type, MAX_SCS_LOC_TYPE_LEN) < 0) {
-            printf("[%s] can't get(%s) data from json\n", __func__, "locationType");
-            return -1;
+    for (;;)
+    {
+        switch (it->js[it->pos])
+        {
+            case '{':
+            case '[':
+                if (json_skipScan(it->js, it->len, it->pos + 1, 1, end) > 0) return 1;
+                break;
+            case '\"':
+                if (json_skipString(it->js, it->len, it->pos + 1, end) > 0) return 1;
+                break;
+            case '}':
+            case ']':
+            case ',':
+            case ':':
+                return json_setError(&it->ctx.parser, JSON_ERROR_INVAL, JSON_ERRC_UNEXPECTED_CHAR, it->pos);
+            default:
+                for (p = it->pos; p < it->len && !(json_charClass[(unsigned char)it->js[p]] & (JSON_CC_SEP | JSON_CC_OP | JSON_CC_QUOTE)); p++);
+                if (p < it->len)
+                {
+                    *end = p;
+                    return 1;
+                }
+                break;
         }
-		printf("[DATA] locationType[%d]:[%s]\n", i, loc_mon_ptr->loc_type);
 
-        // accuracy (Mandatory)
-        if (get_string_from_json_new(locMonStr, locMonTokens, "accuracy", loc_mon_ptr->accuracy, MAX_SCS_ACCURACY_LEN) < 0) {
-            printf("[%s] can't get(%s) data from json\n", __func__, "accuracy");
-            return -1;
+        /* Cut by the end of the window : scanned again once it holds more */
+        if ((r = json_fillArray(it)) < 0) return -1;
+        if (r == 0)
+        {
+            if (it->js[it->pos] == '{' || it->js[it->pos] == '[' || it->js[it->pos] == '\"')
+                return json_setError(&it->ctx.parser, JSON_ERROR_PART,
+                        it->js[it->pos] == '\"' ? JSON_ERRC_OPEN_STRING : JSON_ERRC_OPEN_CONTAINER, it->pos);
+            *end = it->len;
+            return 1;
         }
-		printf("[DATA] accuracy[%d]:[%s]\n", i, loc_mon_ptr->accuracy);
-        // end of locationMonitor
+    }
+}
+
+/**
+ * @fn static void json_releaseArray(JsonArrayIter *it)
+ * @brief Gives back the pages of the mmap before pos, they are not read again.
+ * @param it
+ */
+static void json_releaseArray(JsonArrayIter *it)
+{
+    size_t done = it->offset + it->pos, pageSize, from, to;
 
-        // set of groupMonitor (Optional)
-    	char        grpMonStr[HTTPF_MSG_BUFSIZE];
-    	JsonToken   grpMonTokens[MAX_JSON_TOKEN_SIZE];
-    	JsonParser  grpMonParser;
+    if (!it->mapOwned || done - it->released < JSON_ARRAY_MIN_BUF * 16) return;
 
-    	if ((tokenPtr = json_object_object_get_new(monSetArrayStr, monSetArrayTokens, "groupMonitor")) == NULL) {
-        	printf("can't parse groupMonitor\n");
-        	return -1;
-    	}
-		memset(grpMonStr, 0x00, HTTPF_MSG_BUFSIZE);
-    	strncpy(grpMonStr, &monSetArrayStr[tokenPtr->start], tokenPtr->end - tokenPtr->start);
-    	json_initJsonParser(&grpMonParser);
-    	memset(&grpMonTokens[0], 0, sizeof(JsonToken)*MAX_JSON_TOKEN_SIZE);
-    	if ((ret = json_parseJson(&grpMonParser, (const char *)grpMonStr, grpMonTokens, MAX_JSON_TOKEN_SIZE)) < 0) {
-        	printf("[%s] can't parse groupMonitor(%s) ret(%d)\n", __func__, grpMonStr, ret);
-        	return -1;
-    	}
+    pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    from = it->released & ~(pageSize - 1);
+    to = done & ~(pageSize - 1);
+    if (to > from) madvise((char *)it->map + from, to - from, MADV_DONTNEED);
+    it->released = to;
+}
 
-        // groupType
-        if (get_string_from_json_new(grpMonStr, grpMonTokens, "groupType", grp_mon_ptr->group_type, MAX_SCS_GRP_TYPE_LEN) < 0) {
-        	printf("[%s] can't get(%s) data from json\n", __func__, "groupType");
-        	return -1;
+/**
+ * @fn int json_nextArray(JsonArrayIter *it, JsonView *elem)
+ * @brief Next element of the array, tokenized into it->ctx ( key indexed, like json_parseContext() ).
+ * @param it
+ * @param elem      view of the element, valid until the next call
+ * @return 1, 0 past the last element, -1 on error ( it->ctx.parser.errcode,
+ *         at it->offset + it->ctx.parser.errpos in the document )
+ */
+int json_nextArray(JsonArrayIter *it, JsonView *elem)
+{
+    JsonContext *ctx = &it->ctx;
+    unsigned int end, p;
+    JsonError r;
+    char c;
+    int n;
+
+    for (;;)
+    {
+        p = json_skipBlank(it->js, it->len, it->pos);
+        if (p >= it->len)
+        {
+            it->pos = p;
+            if ((n = json_fillArray(it)) < 0) return -1;
+            if (n > 0) continue;
+            if (it->state == JSON_ARRAY_DONE) return 0;
+            return json_setError(&ctx->parser, JSON_ERROR_PART, JSON_ERRC_OPEN_CONTAINER, it->pos);
         }
-		printf("[DATA] groupType[%d]:[%s]\n", i, grp_mon_ptr->group_type);
+        it->pos = p;
+        c = it->js[p];
 
-        // groupValue
-        if (get_string_from_json_new(grpMonStr, grpMonTokens, "groupValue", grp_mon_ptr->group_value, MAX_SCS_GRP_VAL_LEN) < 0) {
-        	printf("[%s] can't get(%s) data from json\n", __func__, "groupValue");
-        	return -1;
+        switch (it->state)
+        {
+            case JSON_ARRAY_START:
+                if (c != '[') break;
+                it->pos++;
+                it->state = JSON_ARRAY_FIRST;
+                continue;
+            case JSON_ARRAY_FIRST:
+            case JSON_ARRAY_NEXT:
+                if (c == ']')
+                {
+                    it->pos++;
+                    it->state = JSON_ARRAY_DONE;
+                    continue;
+                }
+                if (it->state == JSON_ARRAY_FIRST) goto value;
+                if (c != ',') break;
+                it->pos++;
+                it->state = JSON_ARRAY_VALUE;
+                continue;
+            case JSON_ARRAY_VALUE:
+                goto value;
         }
-		printf("[DATA] groupValue[%d]:[%s]\n", i, grp_mon_ptr->group_value);
-        // end of groupMonitor
+        return json_setError(&ctx->parser, JSON_ERROR_INVAL, JSON_ERRC_UNEXPECTED_CHAR, p);
     }
 
-    return array_num;
+    value:
+    json_releaseArray(it);
+    if (json_arrayValueEnd(it, &end) < 0) return -1;
+
+    /* Offsets of the tokens are from the element */
+    r = json_parseContext(ctx, it->js + it->pos, end - it->pos);
+    if (r != JSON_SUCCESS)
+    {
+        ctx->parser.errpos += it->pos;
+        return -1;
+    }
+
+    *elem = json_viewOf(it->js + it->pos, ctx->tokens);
+    it->pos = end;
+    it->index++;
+    it->state = JSON_ARRAY_NEXT;
+    return 1;
 }
 
+/**
+ * @fn void json_closeArray(JsonArrayIter *it)
+ * @brief Releases the window, the mmap of json_openArrayFile() and the context of it.
+ * @param it
+ */
+void json_closeArray(JsonArrayIter *it)
+{
+    json_freeContext(&it->ctx);
+    free(it->buf);
+    if (it->mapOwned && it->mapLen > 0) munmap((void *)it->map, it->mapLen);
+    memset(it, 0, sizeof(JsonArrayIter));
+    it->fd = -1;
+}
+
+
 
 void main_cp_info()
 //void main()
 {
 	int ret, i, j, array_num, size;
-	char json_str[HTTPF_MSG_BUFSIZE], bb[HTTPF_MSG_BUFSIZE], cc[HTTPF_MSG_BUFSIZE];
-	JsonToken tokens[MAX_JSON_TOKEN_SIZE];
+	JsonContext *ctx = json_getContext();
+	char *json_str = json_contextScratch(ctx, HTTPF_MSG_BUFSIZE);
+	JsonToken *tokens;
+
+	if (json_str == NULL) return;
 
 
 	//sprintf(a, "{\"nidd:info\" : { \"scsRefereneId\": \"89ABCDEF\", \"scsId\":\"scs01\", \"address\": [\"tel:+821022223333\",\"tel:+821022224444\"], \"validity\": { \"startTime\": \"2016-06-23T09:00:00\", \"expiryTime\": \"2017-06-23T09:00:00\" }}}");
@@ -1083,162 +5976,69 @@ void main_cp_info()
 
 	printf("json_str=[%s]%d %d\n\n", json_str, JSON_STRING, JSON_OBJECT);
 
-	JsonParser parser;
-	json_initJsonParser(&parser);
-
-	memset(&tokens[0], 0, sizeof(JsonToken)*MAX_JSON_TOKEN_SIZE);
-	ret = json_parseJson(&parser, (const char *)json_str, tokens, MAX_JSON_TOKEN_SIZE);
-	printf("khlret=%d %d %d %d\n", ret, parser.pos, parser.toknext, parser.toksuper);
+	// Tokens land in the arena of this thread, already key indexed
+	ret = json_parseContext(ctx, json_str, strlen(json_str));
+	printf("khlret=%d %d %d %d\n", ret, ctx->parser.pos, ctx->tokenNum, ctx->parser.toksuper);
+	if (ret != JSON_SUCCESS) {
+		printf("parse error(%d) %s at offset %u\n", ret, json_strerror(ctx->parser.errcode), ctx->parser.errpos);
+		return;
+	}
+	tokens = ctx->tokens;
 
-	size = parser.toknext;
+	size = ctx->tokenNum;
 	// Resource Name
 	i = 1;
-	strncpy(bb, &json_str[tokens[i].start], tokens[i].end - tokens[i].start);
-	bb[tokens[i].end - tokens[i].start] = 0;
-	printf("resource name [%s]\n", bb);
+	printf("resource name [%.*s]\n", tokens[i].end - tokens[i].start, &json_str[tokens[i].start]);
 
-	// scsRefereneId (Mandatory)
- 	if ( get_string_from_json_new(json_str, tokens, "scsRefereneId", cc, 32) < 0) {
-		printf("can't get(%s) data from json\n", "scsRefereneId");
+	// Every field of the resource in one walk, see SCS_CP_INFO_FIELDS
+	Scs_cp_info_t	cp_info;
+	Scs_param_set_t	*param_set = &cp_info.param_set;
+	if (json_decodeResource(json_str, tokens, ctx->tokenNum, "cp:info", &json_bindCpInfo, &cp_info) < 0) {
+		printf("[%s] can't decode cp:info from json\n", __func__);
 		return;
-	} else {
-		printf("[DATA] %s:[%s]\n", "scsRefereneId", cc);
-	}
-
-	// address (Mandatory)
-	char	address[10][33];
-	if ((array_num = get_address_array_from_json_new(json_str, tokens, "address", &address[0], 10, 32)) <= 0) {
-        printf("[%s] can't get address from json ret=%d\n", __func__, array_num);
-        return;
-	} else {
-		for (i=0; i<array_num; i++) printf("[DATA] %s[%d]:[%s]\n", "address", i, address[i]);
-    }
-
-	// validity (Optional)
-	Scs_validity_t	validity;
-	if ( get_validity_from_json_new(json_str, tokens, "validity", &validity) < 0) {
-        printf("can't get(%s) data from json\n", "scsRefereneId");
-        return;
-    } else {
-        printf("[DATA] %s:[%s]\n", "scsRefereneId", cc);
-    }
-
-	/* set of parameterSet (Mandatory)
-     */
-	char	paraSetStr[2048];
-	JsonToken   paraSetTokens[MAX_JSON_TOKEN_SIZE], *tokenPtr;
-	JsonParser paraSetParser;
-
-    if ((tokenPtr = json_object_object_get_new(json_str, tokens, "parameterSet")) == NULL) {
-        printf("can't parse parameterSet\n");
-    }
-	strncpy(paraSetStr, &json_str[tokenPtr->start], tokenPtr->end - tokenPtr->start);
-
-	json_initJsonParser(&paraSetParser);
-	memset(&paraSetTokens[0], 0, sizeof(JsonToken)*MAX_JSON_TOKEN_SIZE);
-	ret = json_parseJson(&paraSetParser, (const char *)paraSetStr, paraSetTokens, MAX_JSON_TOKEN_SIZE);
-    int paraSetTokenSize = paraSetParser.toknext;
-	printf("[%s] paraSetTokenSize = %d\n", paraSetStr, paraSetTokenSize);
-
-#if 0
-	printf("\n\n\nparaSetTokens:\n");
-
-	for (i=0; i < paraSetTokenSize; i++) {
-		if (paraSetTokens[i].start == 0 && paraSetTokens[i].end == 0)
-			break;
-	
-		strncpy(bb, &paraSetStr[paraSetTokens[i].start], paraSetTokens[i].end - paraSetTokens[i].start);
-		bb[paraSetTokens[i].end - paraSetTokens[i].start] = 0;
-		printf("i=%d %d %d %d %d [%s]\n", 
-				i, paraSetTokens[i].type, paraSetTokens[i].start, paraSetTokens[i].end, paraSetTokens[i].size, bb);
-
 	}
-#endif
-
-	// set of periodicCommunication (Mandatory)
-	char		periodCommStr[2048];
-	JsonToken   periodCommTokens[MAX_JSON_TOKEN_SIZE];
-	JsonParser  periodCommParser;
-
-    if ((tokenPtr = json_object_object_get_new(paraSetStr, paraSetTokens, "periodicCommunication")) == NULL) {
-        printf("can't parse periodicCommunication\n");
-    }
-	strncpy(periodCommStr, &paraSetStr[tokenPtr->start], tokenPtr->end - tokenPtr->start);
-	json_initJsonParser(&periodCommParser);
-	memset(&periodCommTokens[0], 0, sizeof(JsonToken)*MAX_JSON_TOKEN_SIZE);
-	ret = json_parseJson(&periodCommParser, (const char *)periodCommStr, periodCommTokens, MAX_JSON_TOKEN_SIZE);
-    int periodCommTokenSize = periodCommTokens->size;
 
-	printf("[%s] periodCommTokenSize = %d\n", periodCommStr, periodCommTokenSize);
+	printf("[DATA] %s:[%s]\n", "scsRefereneId", cp_info.scs_ref_id);
+	for (i=0; i<cp_info.address_number; i++) printf("[DATA] %s[%d]:[%s]\n", "address", i, cp_info.address[i]);
+	printf("[DATA] %s:[%s] (%ld)\n", "startTime", cp_info.validity.start_time, (long)cp_info.validity.start_epoch);
+	printf("[DATA] %s:[%s] (%ld)\n", "expiryTime", cp_info.validity.expiry_time, (long)cp_info.validity.expiry_epoch);
 
-#if 0
-	printf("\n\n\nperiodCommStr:\n");
-
-	for (i=0; i < MAX_JSON_TOKEN_SIZE; i++) {
-		if (periodCommTokens[i].start == 0 && periodCommTokens[i].end == 0)
-			break;
-	
-		strncpy(bb, &periodCommStr[periodCommTokens[i].start], periodCommTokens[i].end - periodCommTokens[i].start);
-		bb[periodCommTokens[i].end - periodCommTokens[i].start] = 0;
-		printf("i=%d %d %d %d %d [%s]\n", 
-				i, periodCommTokens[i].type, periodCommTokens[i].start, periodCommTokens[i].end, periodCommTokens[i].size, bb);
+	printf("[DATA] %s=[%s]\n", "commIndicator", json_enumName(&json_enumCommInd, param_set->period_comm.comm_indicator));
+	printf("[DATA] %s=[%d]\n", "duration", param_set->period_comm.duration);
+	printf("[DATA] %s=[%d]\n", "interval", param_set->period_comm.interval);
 
+	for (i=0; i<param_set->sched_comm_number; i++) {
+		printf("[DATA] timeOfDayStart[%d]=[%d]\n", i, param_set->sched_comm[i].time_of_day_start);
+		printf("[DATA] timeOfDayEnd[%d]=[%d]\n", i, param_set->sched_comm[i].time_of_day_end);
+		printf("[DATA] dayOfWeekMask[%d]=[%d]\n", i, param_set->sched_comm[i].day_of_week_mask);
+		printf("[DATA] timezoneFlag[%d]=[%d]\n", i, param_set->sched_comm[i].timezone_flag);
 	}
-#endif
-
-	// commIndicator (Mandatory)
-	char	comm_indicator[1024];
-   	if (get_string_from_json_new(periodCommStr, periodCommTokens, "commIndicator", comm_indicator, MAX_SCS_COMM_IND_LEN) < 0) {
-        printf("[%s] can't get(%s) data from json\n", __func__, "commIndicator");
-    } else {
-        printf("[DATA] %s=[%s]\n", "commIndicator", comm_indicator);
+	printf("[%s] num of scheduledCommunication from json ret=%d\n", __func__, param_set->sched_comm_number);
+
+	printf("[DATA] %s=[%s]\n", "stationary", json_enumName(&json_enumStationary, param_set->stationary));
+
+	// Scattered fields by JSON Pointer, compiled once and read in one walk
+	static JsonPathSet	path_set;
+	static int			path_id[3] = { -1, -1, -1 };
+	JsonView			path_val[JSON_PATHSET_MAX_PATH];
+	if (path_id[0] < 0) {
+		json_initPathSet(&path_set);
+		path_id[0] = json_addPath(&path_set, "/cp:info/parameterSet/periodicCommunication/interval");
+		path_id[1] = json_addPath(&path_set, "/cp:info/parameterSet/scheduledCommunication/1/dayOfWeekMask");
+		path_id[2] = json_addPath(&path_set, "/cp:info/validity/startTime");
 	}
- 
-	// duration (Mandatory)
-	int	duration;
-	if (get_int_from_json_new(periodCommStr, periodCommTokens, "duration", &duration) < 0) {
-        printf("[%s] can't get(%s) data from json\n", __func__, "duration");
-    } else {
-        printf("[DATA] %s=[%d]\n", "duration", duration);
-    }
-
-	// interval (Mandatory)
-	int	interval;
-	if (get_int_from_json_new(periodCommStr, periodCommTokens, "interval", &interval) < 0) {
-        printf("[%s] can't get(%s) data from json\n", __func__, "interval");
-    } else {
-        printf("[DATA] %s=[%d]\n", "interval", interval);
-    }
-	// end of periodicCommunication
-
-	// set of scheduledCommunication (Mandatory)
-	Scs_schedule_comm_t sched_comm_ptr[MAX_SCS_SCHEDULE_COMM_NUM];
-	if ((array_num = get_sched_comm_array_from_json_new(paraSetStr, paraSetTokens, "scheduledCommunication", sched_comm_ptr, MAX_SCS_SCHEDULE_COMM_NUM)) <= 0) {
-        printf("[%s] can't get scheduledCommunication from paraSet ret=%d\n", __func__, array_num);
-        return;
-    } else {
-        printf("[%s] num of scheduledCommunication from json ret=%d\n", __func__, array_num);
+	json_viewPathSet(json_viewOf(json_str, tokens), &path_set, path_val);
+	for (i=0; i<3; i++) {
+		if (path_val[path_id[i]].tok == NULL) continue;
+		printf("[PATH] %d=[%.*s]\n", i, path_val[path_id[i]].tok->end - path_val[path_id[i]].tok->start,
+				&json_str[path_val[path_id[i]].tok->start]);
 	}
-    int sched_comm_number = array_num;
-
-
-	// stationary (Mandatory)
-	char	stationary[1024];
-    if (get_string_from_json_new(paraSetStr, paraSetTokens, "stationary", &stationary[0], MAX_SCS_STATIONARY_LEN) < 0) {
-        printf("[%s] can't get(%s) data from json\n", __func__, "stationary");
-    } else {
-        printf("[DATA] %s=[%s]\n", "stationary", stationary);
-    }
 
 	printf("\n\n");
-	for (i=0; i < parser.toknext; i++) {
-		if (tokens[i].start == 0 && tokens[i].end == 0)
-			break;
-	
-		strncpy(bb, &json_str[tokens[i].start], tokens[i].end - tokens[i].start);
-		bb[tokens[i].end - tokens[i].start] = 0;
-		printf("i=%d %d %d %d %d [%s]\n", 
-				i, tokens[i].type, tokens[i].start, tokens[i].end, tokens[i].size, bb);
+	for (i=0; i < ctx->tokenNum; i++) {
+		printf("i=%d %d %d %d %d [%.*s]\n", 
+				i, tokens[i].type, tokens[i].start, tokens[i].end, tokens[i].size,
+				tokens[i].end - tokens[i].start, &json_str[tokens[i].start]);
 
 #if 0
 		if (!strcmp(bb, "scsRefereneId")) {
@@ -1284,8 +6084,11 @@ void main_cp_info()
 void main_evt_info()
 {	
 	int ret, i, j, array_num, size;
-	char json_str[HTTPF_MSG_BUFSIZE], bb[HTTPF_MSG_BUFSIZE], cc[HTTPF_MSG_BUFSIZE];
-	JsonToken tokens[MAX_JSON_TOKEN_SIZE];
+	JsonContext *ctx = json_getContext();
+	char *json_str = json_contextScratch(ctx, HTTPF_MSG_BUFSIZE);
+	JsonToken *tokens;
+
+	if (json_str == NULL) return;
 
 
 	sprintf(json_str, "{ \"event:info\" : { \"scsRefereneId\": \"23456789\", \"scsId\":\"scs01\", \"address\": [ \"tel:+821023456789\" ], \"monitorSet\" : [{ \"monitorType\" : \"lossofConnectivity\", \"validity\": { \"startTime\": \"2016-06-23 09:00:00\", \"expiryTime\": \"2017-06-23 09:00:00\" }, \"reportNumber\": 10, \"chargingNumber\": \"821023456789\", \"reachableMonitor\": { \"eventType\": [ \"SMS\", \"DATA\" ], \"maximumLatency\" : 1000, \"maximumResponse\" : 2000 }, \"associationMonitor\": [ \"IMSI\", \"IMEISV\" ], \"locationMonitor\": { \"locationType\": \"current\", \"accuracy\": \"ecgi\" }, \"groupMonitor\": { \"groupType\": \"ecgi\", \"groupValue\": \"2cab\" } }, { \"monitorType\" : \"ueReachable\", \"validity\": { \"startTime\": \"2017-01-01 00:00:00\", \"expiryTime\": \"2017-12-31 24:00:00\" }, \"reportNumber\": 11, \"chargingNumber\": \"821023456789\", \"reachableMonitor\": { \"eventType\": [ \"SMS\" ], \"maximumLatency\" : 1001, \"maximumResponse\" : 2001 }, \"associationMonitor\": [ \"IMSI\" ], \"locationMonitor\": { \"locationType\": \"last\", \"accuracy\": \"enb\" }, \"groupMonitor\": { \"groupType\": \"enbId\", \"groupValue\": \"enb01\" } }], \"destinationAddress\": \"192.100.101.101:9002\" } }");
@@ -1293,57 +6096,56 @@ void main_evt_info()
 
 	printf("json_str=[%s]%d %d\n\n", json_str, JSON_STRING, JSON_OBJECT);
 
-	JsonParser parser;
-	json_initJsonParser(&parser);
-
-	memset(&tokens[0], 0, sizeof(JsonToken)*MAX_JSON_TOKEN_SIZE);
-	ret = json_parseJson(&parser, (const char *)json_str, tokens, MAX_JSON_TOKEN_SIZE);
-	printf("khlret=%d %d %d %d\n", ret, parser.pos, parser.toknext, parser.toksuper);
+	// Tokens land in the arena of this thread, already key indexed
+	ret = json_parseContext(ctx, json_str, strlen(json_str));
+	printf("khlret=%d %d %d %d\n", ret, ctx->parser.pos, ctx->tokenNum, ctx->parser.toksuper);
+	if (ret != JSON_SUCCESS) {
+		printf("parse error(%d) %s at offset %u\n", ret, json_strerror(ctx->parser.errcode), ctx->parser.errpos);
+		return;
+	}
+	tokens = ctx->tokens;
 
-	size = parser.toknext;
+	size = ctx->tokenNum;
 	// Resource Name
 	i = 1;
-	strncpy(bb, &json_str[tokens[i].start], tokens[i].end - tokens[i].start);
-	bb[tokens[i].end - tokens[i].start] = 0;
-	printf("resource name [%s]\n", bb);
+	printf("resource name [%.*s]\n", tokens[i].end - tokens[i].start, &json_str[tokens[i].start]);
 
-	// scsRefereneId (Mandatory)
- 	if ( get_string_from_json_new(json_str, tokens, "scsRefereneId", cc, 32) < 0) {
-		printf("can't get(%s) data from json\n", "scsRefereneId");
+	// Every field of the resource in one walk, see SCS_EVT_INFO_FIELDS
+	Scs_evt_info_t	evt_info;
+	Scs_mon_set_t	*mon_set;
+	if (json_decodeResource(json_str, tokens, ctx->tokenNum, "event:info", &json_bindEvtInfo, &evt_info) < 0) {
+		printf("[%s] can't decode event:info from json\n", __func__);
 		return;
-	} else {
-		printf("[DATA] %s:[%s]\n", "scsRefereneId", cc);
 	}
 
-	// address (Mandatory)
-	char	address[10][33];
-	if ((array_num = get_address_array_from_json_new(json_str, tokens, "address", &address[0], 10, 32)) <= 0) {
-        printf("[%s] can't get address from json ret=%d\n", __func__, array_num);
-        return;
-	} else {
-		for (i=0; i<array_num; i++) printf("[DATA] %s[%d]:[%s]\n", "address", i, address[i]);
-    }
-
-	/* set of monitorSet (Mandatory)
-	 */
-	Scs_mon_set_t       mon_set_ptr[MAX_SCS_MON_SET_NUM];
-	if ((array_num = get_monset_array_from_json_new(json_str, tokens, "monitorSet", mon_set_ptr, MAX_SCS_MON_SET_NUM)) <= 0) {
-		printf("[%s] can't get monitor set from json ret=%d\n", __func__, array_num);
-		return;
-	} else {
-		printf("[%s] get monitor set from json ret=%d\n", __func__, array_num);
+	printf("[DATA] %s:[%s]\n", "scsRefereneId", evt_info.scs_ref_id);
+	for (i=0; i<evt_info.address_number; i++) printf("[DATA] %s[%d]:[%s]\n", "address", i, evt_info.address[i]);
+
+	for (i=0; i<evt_info.monset_number; i++) {
+		mon_set = &evt_info.mon_set[i];
+		printf("[DATA] %s[%d]: [%s]\n", "monitorType", i, json_enumName(&json_enumMonType, mon_set->mon_type));
+		printf("[DATA] %s:[%s] (%ld)\n", "startTime", mon_set->validity.start_time, (long)mon_set->validity.start_epoch);
+		printf("[DATA] %s:[%s] (%ld)\n", "expiryTime", mon_set->validity.expiry_time, (long)mon_set->validity.expiry_epoch);
+		printf("[DATA] %s[%d]: [%d]\n", "reportNumber", i, mon_set->report_num);
+		printf("[DATA] %s[%d]: [%s]\n", "chargingNumber", i, mon_set->charging_num);
+		printf("[DATA] eventType[%d]:[%s][%s]\n", i, json_enumName(&json_enumEvtType, mon_set->rch_mon.event_type[0]),
+				mon_set->rch_mon.event_number > 1 ? json_enumName(&json_enumEvtType, mon_set->rch_mon.event_type[1]) : "");
+		printf("[DATA] maximumLatency[%d]:[%d]\n", i, mon_set->rch_mon.max_latency);
+		printf("[DATA] maximumResponse[%d]:[%d]\n", i, mon_set->rch_mon.max_resp);
+		printf("[DATA] associationMonitor[%d]:[%s][%s]\n", i, json_enumName(&json_enumAssoMon, mon_set->ass_mon[0]),
+				mon_set->ass_number > 1 ? json_enumName(&json_enumAssoMon, mon_set->ass_mon[1]) : "");
+		printf("[DATA] locationType[%d]:[%s]\n", i, json_enumName(&json_enumLocType, mon_set->loc_mon.loc_type));
+		printf("[DATA] accuracy[%d]:[%s]\n", i, json_enumName(&json_enumAccuracy, mon_set->loc_mon.accuracy));
+		printf("[DATA] groupType[%d]:[%s]\n", i, json_enumName(&json_enumGrpType, mon_set->grp_mon.group_type));
+		printf("[DATA] groupValue[%d]:[%s]\n", i, mon_set->grp_mon.group_value);
 	}
-	//evt_info->monset_number = array_num;
+	printf("[%s] get monitor set from json ret=%d\n", __func__, evt_info.monset_number);
 
 	printf("\n\n");
-	for (i=0; i < parser.toknext; i++) {
-		if (tokens[i].start == 0 && tokens[i].end == 0)
-			break;
-	
-		strncpy(bb, &json_str[tokens[i].start], tokens[i].end - tokens[i].start);
-		bb[tokens[i].end - tokens[i].start] = 0;
-		printf("i=%d %d %d %d %d [%s]\n", 
-				i, tokens[i].type, tokens[i].start, tokens[i].end, tokens[i].size, bb);
+	for (i=0; i < ctx->tokenNum; i++) {
+		printf("i=%d %d %d %d %d [%.*s]\n", 
+				i, tokens[i].type, tokens[i].start, tokens[i].end, tokens[i].size,
+				tokens[i].end - tokens[i].start, &json_str[tokens[i].start]);
 	}
 }
 
@@ -1352,73 +6154,51 @@ void main_nidd_info(int print_flag)
 //void main()
 {
 	int ret, i, j, array_num, size;
-	char json_str[HTTPF_MSG_BUFSIZE], bb[HTTPF_MSG_BUFSIZE], cc[HTTPF_MSG_BUFSIZE];
-	JsonToken tokens[MAX_JSON_TOKEN_SIZE];
+	JsonContext *ctx = json_getContext();
+	char *json_str = json_contextScratch(ctx, HTTPF_MSG_BUFSIZE);
+	JsonToken *tokens;
+
+	if (json_str == NULL) return;
 
 	sprintf(json_str, "{\"nidd:info\" : { \"scsRefereneId\": \"89ABCDEF\", \"scsId\":\"scs01\", \"address\": [\"tel:+821022223333\",\"tel:+821022224444\"], \"validity\": { \"startTime\": \"2016-06-23T09:00:00\", \"expiryTime\": \"2017-06-23T09:00:00\" }}}");
 
 	if (print_flag) printf("json_str=[%s]%d %d\n\n", json_str, JSON_STRING, JSON_OBJECT);
 
-	JsonParser parser;
-	json_initJsonParser(&parser);
-
-	memset(&tokens[0], 0, sizeof(JsonToken)*MAX_JSON_TOKEN_SIZE);
-
-    // parser, json_str ---> tokens 추출 
-	ret = json_parseJson(&parser, (const char *)json_str, tokens, MAX_JSON_TOKEN_SIZE);
-	if (print_flag) printf("khlret=%d %d %d %d\n", ret, parser.pos, parser.toknext, parser.toksuper);
+	// Tokens land in the arena of this thread, already key indexed
+	ret = json_parseContext(ctx, json_str, strlen(json_str));
+	if (print_flag) printf("khlret=%d %d %d %d\n", ret, ctx->parser.pos, ctx->tokenNum, ctx->parser.toksuper);
+	if (ret != JSON_SUCCESS) {
+		printf("parse error(%d) %s at offset %u\n", ret, json_strerror(ctx->parser.errcode), ctx->parser.errpos);
+		return;
+	}
+	tokens = ctx->tokens;
 
-	size = parser.toknext;
+	size = ctx->tokenNum;
 	// Resource Name
 	i = 1;
-	strncpy(bb, &json_str[tokens[i].start], tokens[i].end - tokens[i].start);
-	bb[tokens[i].end - tokens[i].start] = 0;
-	if (print_flag) printf("resource name [%s]\n", bb);
+	if (print_flag) printf("resource name [%.*s]\n", tokens[i].end - tokens[i].start, &json_str[tokens[i].start]);
 
-	// scsId (Mandatory)
- 	if ( get_string_from_json_new(json_str, tokens, "scsId", cc, MAX_SCS_ID_LEN) < 0) {
-		printf("can't get(%s) data from json\n", "scsId");
+	// Every field of the resource in one walk, see SCS_NIDD_INFO_FIELDS
+	Scs_nidd_info_t	nidd_info;
+	if (json_decodeResource(json_str, tokens, ctx->tokenNum, "nidd:info", &json_bindNiddInfo, &nidd_info) < 0) {
+		printf("[%s] can't decode nidd:info from json\n", __func__);
 		return;
-	} else {
-		if (print_flag) printf("[DATA] %s:[%s]\n", "scsId", cc);
 	}
 
-	// scsRefereneId (Mandatory)
- 	if ( get_string_from_json_new(json_str, tokens, "scsRefereneId", cc, MAX_SCS_REF_ID_LEN) < 0) {
-		printf("can't get(%s) data from json\n", "scsRefereneId");
-		return;
-	} else {
-		if (print_flag) printf("[DATA] %s:[%s]\n", "scsRefereneId", cc);
+	if (print_flag) {
+		printf("[DATA] %s:[%s]\n", "scsId", nidd_info.scs_id);
+		printf("[DATA] %s:[%s]\n", "scsRefereneId", nidd_info.scs_ref_id);
+		for (i=0; i<nidd_info.address_number; i++) printf("[DATA] %s[%d]:[%s]\n", "address", i, nidd_info.address[i]);
+		printf("[DATA] %s:[%s] (%ld)\n", "startTime", nidd_info.validity.start_time, (long)nidd_info.validity.start_epoch);
+		printf("[DATA] %s:[%s] (%ld)\n", "expiryTime", nidd_info.validity.expiry_time, (long)nidd_info.validity.expiry_epoch);
 	}
 
-	// address (Mandatory)
-	char	address[10][33];
-	if ((array_num = get_address_array_from_json_new(json_str, tokens, "address", &address[0], 10, 32)) <= 0) {
-        printf("[%s] can't get address from json ret=%d\n", __func__, array_num);
-        return;
-	} else {
-		if (print_flag) for (i=0; i<array_num; i++) printf("[DATA] %s[%d]:[%s]\n", "address", i, address[i]);
-    }
-
-	// validity (Optional)
-	Scs_validity_t	validity;
-	if ( get_validity_from_json_new(json_str, tokens, "validity", &validity) < 0) {
-        printf("can't get(%s) data from json\n", "scsRefereneId");
-        return;
-    } else {
-        if (print_flag) printf("[DATA] %s:[%s]\n", "scsRefereneId", cc);
-    }
-
 #if 0
 	printf("\n\n");
-	for (i=0; i < parser.toknext; i++) {
-		if (tokens[i].start == 0 && tokens[i].end == 0)
-			break;
-	
-		strncpy(bb, &json_str[tokens[i].start], tokens[i].end - tokens[i].start);
-		bb[tokens[i].end - tokens[i].start] = 0;
-		printf("i=%d %d %d %d %d [%s]\n", 
-				i, tokens[i].type, tokens[i].start, tokens[i].end, tokens[i].size, bb);
+	for (i=0; i < ctx->tokenNum; i++) {
+		printf("i=%d %d %d %d %d [%.*s]\n", 
+				i, tokens[i].type, tokens[i].start, tokens[i].end, tokens[i].size,
+				tokens[i].end - tokens[i].start, &json_str[tokens[i].start]);
 
 #if 0
 		if (!strcmp(bb, "scsRefereneId")) {
@@ -1461,25 +6241,200 @@ void main_nidd_info(int print_flag)
 #endif
 }
 
-char commlib_microTimeStamp[32];
-char *commlib_printMicrosec (void)
+void main_mo_indication(int print_flag)
+{
+	char	head[512], tail[64];
+	char	nidd_data[] = "010101010101010101010101010101";
+	Scs_mo_indication_t	mo;
+	JsonWriter	writer;
+	struct iovec	*iov;
+	int		iovcnt, i;
+	size_t	total;
+
+	strcpy(mo.scs_id, "scs05");
+	strcpy(mo.scs_ref_id, "821020044686");
+	mo.mo_data_number = 1;
+	strcpy(mo.mo_data[0].address, "tel:+821020044686");
+	mo.mo_data[0].nidd_data = nidd_data;
+	mo.mo_data[0].nidd_len = strlen(nidd_data);
+
+	// Two chained buffers, the niddData value is referenced in place
+	json_initWriter(&writer, head, sizeof(head));
+	json_addWriterBuffer(&writer, tail, sizeof(tail));
+	if (json_writeMoIndication(&writer, &mo) < 0 || (iov = json_finishWriter(&writer, &iovcnt, &total)) == NULL) {
+		printf("[%s] can't write nidd:moIndication\n", __func__);
+		return;
+	}
+
+	if (print_flag) {
+		printf("[%s] %d iovec %zu bytes\n", __func__, iovcnt, total);
+		fflush(stdout);
+		writev(1, iov, iovcnt);
+		printf("\n");
+	}
+}
+
+/* Batch replay of moIndication records, one result per line */
+typedef struct {
+	char	scs_id[MAX_SCS_ID_LEN+1];
+	char	scs_ref_id[MAX_SCS_REF_ID_LEN+1];
+	int		mo_data_number;
+} Mo_replay_t;
+
+static int mo_replay_decode(void *arg, const JsonBatchDoc *doc, void *result)
+{
+	Mo_replay_t	*mo = (Mo_replay_t *)result;
+	JsonView	res;
+
+	if (doc->r != JSON_SUCCESS) return -1;
+
+	res = json_viewMember(json_viewOf(doc->js, doc->tokens), "nidd:moIndication");
+	if (json_viewString(json_viewMember(res, "scsId"), mo->scs_id, MAX_SCS_ID_LEN) < 0) return -1;
+	if (json_viewString(json_viewMember(res, "scsReferenceId"), mo->scs_ref_id, MAX_SCS_REF_ID_LEN) < 0) return -1;
+	mo->mo_data_number = json_viewCount(json_viewMember(res, "moData"));
+	return 1;
+}
+
+static void mo_replay_deliver(void *arg, const JsonBatchDoc *doc, void *result, int rc)
+{
+	Mo_replay_t	*mo = (Mo_replay_t *)result;
+
+	if (arg == NULL) return;
+	if (rc < 0)
+		printf("[%zu] can't decode [%.*s]\n", doc->offset, (int)doc->lineLen, doc->line);
+	else
+		printf("[%zu] scsId:[%s] scsReferenceId:[%s] moData:%d\n", doc->offset, mo->scs_id, mo->scs_ref_id, mo->mo_data_number);
+}
+
+void main_evt_forward(int print_flag)
+{
+	char	frag[128];
+	JsonContext	*ctx = json_getContext();
+	char	*json_str = json_contextScratch(ctx, HTTPF_MSG_BUFSIZE);
+	JsonView	res;
+	JsonPatch	patch;
+	struct iovec	*iov;
+	int		ret, iovcnt;
+	size_t	total;
+
+	if (json_str == NULL) return;
+
+	sprintf(json_str, "{ \"event:info\" : { \"scsRefereneId\": \"23456789\", \"scsId\":\"scs01\", \"address\": [ \"tel:+821023456789\" ], \"monitorSet\" : [{ \"monitorType\" : \"ueReachable\", \"reportNumber\": 11 }], \"destinationAddress\": \"192.100.101.101:9002\" } }");
+
+	ret = json_parseContext(ctx, json_str, strlen(json_str));
+	if (ret != JSON_SUCCESS) {
+		printf("parse error(%d) %s at offset %u\n", ret, json_strerror(ctx->parser.errcode), ctx->parser.errpos);
+		return;
+	}
+	res = json_viewMember(json_viewOf(json_str, ctx->tokens), "event:info");
+
+	// Only the rewritten values are copied, the rest of the body is sent from json_str
+	json_initPatch(&patch, json_str, strlen(json_str), frag, sizeof(frag));
+	json_patchReplaceString(&patch, json_viewMember(res, "scsId"), "scs07", 5);
+	json_patchReplaceString(&patch, json_viewMember(res, "destinationAddress"), "10.10.1.7:9002", 14);
+	json_patchDelete(&patch, res, json_viewMember(res, "scsRefereneId"));
+	if ((iov = json_finishPatch(&patch, &iovcnt, &total)) == NULL) {
+		printf("[%s] can't patch event:info\n", __func__);
+		return;
+	}
+
+	if (print_flag) {
+		printf("[%s] %d iovec %zu bytes\n", __func__, iovcnt, total);
+		fflush(stdout);
+		writev(1, iov, iovcnt);
+		printf("\n");
+	}
+}
+
+void main_batch(const char *path, int thread_num, int print_flag)
+{
+	JsonBatch	batch;
+	long		num;
+
+	json_initBatch(&batch, mo_replay_decode, mo_replay_deliver, sizeof(Mo_replay_t), print_flag ? &batch : NULL);
+	batch.threadNum = thread_num;
+	batch.flag = JSON_BATCH_ORDERED;
+
+	if ((num = json_runBatchFile(&batch, path)) < 0) {
+		printf("[%s] can't replay %s\n", __func__, path);
+		return;
+	}
+	printf("[%s] %s : %ld documents, %ld not parsed\n", __func__, path, num, batch.errorNum);
+}
+
+void main_bulk_export(const char *path, int print_flag)
+{
+	JsonArrayIter	iter;
+	JsonView	elem;
+	Scs_evt_info_t	evt_info;
+	long		num = 0;
+	int		ret;
+
+	// One subscription tokenized at a time, whatever the size of the export
+	if (json_openArrayFile(&iter, path) < 0) return;
+
+	while ((ret = json_nextArray(&iter, &elem)) > 0) {
+		if (json_decodeResource(elem.js, elem.tok, iter.ctx.tokenNum, "event:info", &json_bindEvtInfo, &evt_info) < 0) {
+			printf("[%s] can't decode element %ld\n", __func__, iter.index);
+			continue;
+		}
+		if (print_flag)
+			printf("[%ld] scsId:[%s] scsReferenceId:[%s] monitorSet:%d\n", iter.index, evt_info.scs_id, evt_info.scs_ref_id, evt_info.monset_number);
+		num++;
+	}
+	if (ret < 0)
+		printf("[%s] %s : %s at offset %zu\n", __func__, path, json_strerror(iter.ctx.parser.errcode), iter.offset + iter.ctx.parser.errpos);
+
+	printf("[%s] %s : %ld subscriptions\n", __func__, path, num);
+	json_closeArray(&iter);
+}
+
+/* Second last formatted by the thread, localtime_r() runs once a second */
+static __thread time_t commlib_cachedSec = -1;
+static __thread char commlib_cachedTime[9];
+static __thread char commlib_microTimeStamp[32];
+
+/**
+ * @fn int commlib_formatMicrosec(char *out, size_t size)
+ * @brief "HH:MM:SS.uuuuuu" of the local time into out, reentrant.
+ * @param out
+ * @param size      16 bytes at least
+ * @return length, -1 if out is too small or the time can't be converted
+ */
+int commlib_formatMicrosec(char *out, size_t size)
 {
     struct timeval  now;
-    struct tm       *pLocalTime;
-    char            tmp[32];
+    struct tm       local;
+    int             i, usec;
 
-    gettimeofday (&now, NULL);
-    if ((pLocalTime = localtime(&now.tv_sec)) == NULL) {
-        strcpy(commlib_microTimeStamp,"");
-    } else {
-        strftime(tmp, 32, "%T", pLocalTime);
-        sprintf (commlib_microTimeStamp, "%s.%06d", tmp, (int)(now.tv_usec));
+    if (size < 16) return -1;
+
+    gettimeofday(&now, NULL);
+    if (now.tv_sec != commlib_cachedSec)
+    {
+        if (localtime_r(&now.tv_sec, &local) == NULL) return -1;
+        strftime(commlib_cachedTime, sizeof(commlib_cachedTime), "%T", &local);
+        commlib_cachedSec = now.tv_sec;
     }
 
+    memcpy(out, commlib_cachedTime, 8);
+    out[8] = '.';
+    for (i = 14, usec = (int)now.tv_usec; i > 8; i--, usec /= 10) out[i] = '0' + usec % 10;
+    out[15] = 0;
+    return 15;
+}
+
+/* Same as commlib_formatMicrosec(), into a buffer of the calling thread */
+char *commlib_printMicrosec (void)
+{
+    if (commlib_formatMicrosec(commlib_microTimeStamp, sizeof(commlib_microTimeStamp)) < 0)
+        commlib_microTimeStamp[0] = 0;
+
     return commlib_microTimeStamp;
 
 } //----- End of commlib_printMicrosec -----//
 
+#ifndef JSON_NO_TEST_MAIN
 void main()
 {
 	int i;
@@ -1490,5 +6445,6 @@ void main()
 
 	printf("END:%s\n", commlib_printMicrosec());
 }
+#endif
 
 
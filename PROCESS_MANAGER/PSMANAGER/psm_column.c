@@ -0,0 +1,494 @@
+#include "psmanager.h"
+
+// ===================================================================
+// Writer
+//
+//  Rows are buffered column by column until COL_MAX_BLOCK_ROW rows (or a
+//  full dictionary) and then written as one block.
+
+typedef struct colwriter{
+
+    int             fd;
+    char            dirName[128];
+    volatile time_t segStart;           // start time of the open segment ( 0 : none )
+
+    unsigned int    rowNum;
+    long long       rcvTime[COL_MAX_BLOCK_ROW];
+    int             pid[COL_MAX_BLOCK_ROW];
+    int             ppid[COL_MAX_BLOCK_ROW];
+    int             cpuTime[COL_MAX_BLOCK_ROW];
+    long long       snapSeq[COL_MAX_BLOCK_ROW];
+    long long       nextSnapSeq;
+    unsigned int    dictId[COL_MAX][COL_MAX_BLOCK_ROW];
+
+    // Block dictionary ( open addressing, COL_MAX_DICT*2 slots )
+    unsigned int    dictNum;
+    unsigned int    dictPoolLen;
+    unsigned int    dictOff[COL_MAX_DICT];
+    int             dictSlot[COL_MAX_DICT * 2];
+    char            dictPool[COL_DICT_POOL_SIZE];
+
+    unsigned char   blockBuff[COL_DICT_POOL_SIZE + COL_MAX_DICT * 4 +
+                              COL_MAX * COL_MAX_BLOCK_ROW * 10 + sizeof(PSM_COL_HEADER) + 8];
+}PSM_COL_WRITER;
+
+static PSM_COL_WRITER   colWriter = { .fd = -1 };
+
+static void resetDictionary(){
+
+    colWriter.dictNum     = 0;
+    colWriter.dictPoolLen = 0;
+    memset(colWriter.dictSlot, 0xff, sizeof(colWriter.dictSlot));
+}
+
+// Return dictionary id, or -1 if the block dictionary is full
+static int getDictId(char *str){
+
+    unsigned int mask = COL_MAX_DICT * 2 - 1;
+    unsigned int slot = hashString(str) & mask;
+    int          id, len;
+
+    while ((id = colWriter.dictSlot[slot]) >= 0){
+        if (strcmp(colWriter.dictPool + colWriter.dictOff[id], str) == 0)
+            return id;
+        slot = (slot + 1) & mask;
+    }
+
+    len = strlen(str) + 1;
+    if (colWriter.dictNum >= COL_MAX_DICT || colWriter.dictPoolLen + len > COL_DICT_POOL_SIZE)
+        return -1;
+
+    id = colWriter.dictNum++;
+    colWriter.dictOff[id] = colWriter.dictPoolLen;
+    memcpy(colWriter.dictPool + colWriter.dictPoolLen, str, len);
+    colWriter.dictPoolLen += len;
+    colWriter.dictSlot[slot] = id;
+
+    return id;
+}
+
+static unsigned char *putVarint(unsigned char *ptr, unsigned long long value){
+
+    while (value >= 0x80){
+        *ptr++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *ptr++ = (unsigned char)value;
+
+    return ptr;
+}
+
+static unsigned char *getVarint(unsigned char *ptr, unsigned char *end, unsigned long long *value){
+
+    unsigned long long  result = 0;
+    int                 shift  = 0;
+
+    while (ptr < end && shift < 64){
+        result |= (unsigned long long)(*ptr & 0x7f) << shift;
+        if ((*ptr++ & 0x80) == 0){
+            *value = result;
+            return ptr;
+        }
+        shift += 7;
+    }
+
+    return NULL;
+}
+
+#define ZIGZAG(v)       (((unsigned long long)(v) << 1) ^ (unsigned long long)((v) >> 63))
+#define UNZIGZAG(v)     ((long long)((v) >> 1) ^ -(long long)((v) & 1))
+
+// History is split into segments of psmConf.segmentSec : <dir>/seg_<start>.col
+int initColumnStore(char *dirName){
+
+    struct timeval  now;
+
+    if (mkdir(dirName, 0755) < 0 && errno != EEXIST){
+        fprintf(stderr, "mkdir [%s] is failed, errno[%d]\n", dirName, errno);
+        return -1;
+    }
+
+    snprintf(colWriter.dirName, sizeof(colWriter.dirName), "%s", dirName);
+    colWriter.fd       = -1;
+    colWriter.segStart = 0;
+    colWriter.rowNum   = 0;
+    resetDictionary();
+
+    // Seeded from the clock, so a restart never reuses a sequence number of the open segment
+    gettimeofday(&now, NULL);
+    colWriter.nextSnapSeq = (long long)now.tv_sec * 1000000 + now.tv_usec;
+
+    return 1;
+}
+
+time_t getColumnSegment(){
+
+    return colWriter.segStart;
+}
+
+static int openSegment(time_t rcvTime){
+
+    char    fName[256];
+    int     segmentSec = psmConf.segmentSec > 0 ? psmConf.segmentSec : 600;
+
+    if (colWriter.fd >= 0){
+        if (rcvTime < colWriter.segStart + segmentSec)
+            return 1;
+
+        if (flushColumnStore() < 0)
+            return -1;
+        close(colWriter.fd);
+        colWriter.fd = -1;
+    }
+
+    colWriter.segStart = rcvTime - rcvTime % segmentSec;
+    snprintf(fName, sizeof(fName), "%s/seg_%010ld.col", colWriter.dirName, (long)colWriter.segStart);
+
+    colWriter.fd = open(fName, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (colWriter.fd < 0){
+        fprintf(stderr, "open [%s] is failed, errno[%d]\n", fName, errno);
+        return -1;
+    }
+
+    return 1;
+}
+
+int flushColumnStore(){
+
+    PSM_COL_HEADER  *hdr;
+    unsigned char   *ptr;
+    unsigned int    i, col, blockLen, off;
+    long long       prev;
+    ssize_t         ret;
+    off_t           start;
+
+    if (colWriter.fd < 0 || colWriter.rowNum == 0)
+        return 1;
+
+    hdr = (PSM_COL_HEADER *)colWriter.blockBuff;
+    memset(hdr, 0x00, sizeof(PSM_COL_HEADER));
+
+    hdr->magic   = COL_BLOCK_MAGIC;
+    hdr->version = COL_BLOCK_VERSION;
+    hdr->rowNum  = colWriter.rowNum;
+    hdr->dictNum = colWriter.dictNum;
+    hdr->minTime = hdr->maxTime = colWriter.rcvTime[0];
+    hdr->minPid  = hdr->maxPid  = colWriter.pid[0];
+
+    for (i = 1 ; i < colWriter.rowNum ; i++){
+        if (colWriter.rcvTime[i] < hdr->minTime) hdr->minTime = colWriter.rcvTime[i];
+        if (colWriter.rcvTime[i] > hdr->maxTime) hdr->maxTime = colWriter.rcvTime[i];
+        if (colWriter.pid[i] < hdr->minPid)      hdr->minPid  = colWriter.pid[i];
+        if (colWriter.pid[i] > hdr->maxPid)      hdr->maxPid  = colWriter.pid[i];
+    }
+
+    // 01. Dictionary ( offset table + NUL terminated strings )
+    ptr = colWriter.blockBuff + sizeof(PSM_COL_HEADER);
+    hdr->dictOff = ptr - colWriter.blockBuff;
+    for (i = 0 ; i < colWriter.dictNum ; i++)
+        ((unsigned int *)ptr)[i] = (colWriter.dictNum + 1) * 4 + colWriter.dictOff[i];
+    ((unsigned int *)ptr)[colWriter.dictNum] = (colWriter.dictNum + 1) * 4 + colWriter.dictPoolLen;
+    ptr += (colWriter.dictNum + 1) * 4;
+    memcpy(ptr, colWriter.dictPool, colWriter.dictPoolLen);
+    ptr += colWriter.dictPoolLen;
+
+    // 02. Columns
+    for (col = 0 ; col < COL_MAX ; col++){
+
+        hdr->colOff[col] = ptr - colWriter.blockBuff;
+        prev = 0;
+
+        for (i = 0 ; i < colWriter.rowNum ; i++){
+            switch (col){
+                case COL_TIME:
+                    ptr  = putVarint(ptr, ZIGZAG(colWriter.rcvTime[i] - prev));
+                    prev = colWriter.rcvTime[i];
+                    break;
+                case COL_PID:
+                    ptr  = putVarint(ptr, ZIGZAG((long long)colWriter.pid[i] - prev));
+                    prev = colWriter.pid[i];
+                    break;
+                case COL_PPID:
+                    ptr  = putVarint(ptr, ZIGZAG((long long)colWriter.ppid[i] - prev));
+                    prev = colWriter.ppid[i];
+                    break;
+                case COL_CPUTIME:
+                    ptr  = putVarint(ptr, (unsigned int)colWriter.cpuTime[i]);
+                    break;
+                case COL_SNAP:
+                    ptr  = putVarint(ptr, ZIGZAG(colWriter.snapSeq[i] - prev));
+                    prev = colWriter.snapSeq[i];
+                    break;
+                default:
+                    ptr  = putVarint(ptr, colWriter.dictId[col][i]);
+                    break;
+            }
+        }
+
+        hdr->colLen[col] = (ptr - colWriter.blockBuff) - hdr->colOff[col];
+    }
+
+    // 03. Keep the next header 8-byte aligned for mmap() readers
+    while ((ptr - colWriter.blockBuff) % 8 != 0)
+        *ptr++ = 0;
+
+    blockLen = ptr - colWriter.blockBuff;
+    hdr->blockLen = blockLen;
+
+    // A torn block would hide every block after it : cut it off on failure,
+    // rows and dictionary are kept for the next flush
+    if ((start = lseek(colWriter.fd, 0, SEEK_END)) < 0){
+        fprintf(stderr, "lseek() column segment is failed, errno[%d]\n", errno);
+        return -1;
+    }
+
+    for (off = 0 ; off < blockLen ; off += ret){
+        ret = write(colWriter.fd, colWriter.blockBuff + off, blockLen - off);
+        if (ret < 0 && errno == EINTR){
+            ret = 0;
+            continue;
+        }
+        if (ret <= 0){
+            fprintf(stderr, "write() column block is failed, errno[%d]\n", errno);
+            if (ftruncate(colWriter.fd, start) < 0)
+                fprintf(stderr, "ftruncate() column segment is failed, errno[%d]\n", errno);
+            return -1;
+        }
+    }
+
+    colWriter.rowNum = 0;
+    resetDictionary();
+
+    return 1;
+}
+
+static int addColumnRow(char *host, PS_SNAPSHOT *snap, long long snapSeq, PS_ENTRY *ent){
+
+    unsigned int    row = colWriter.rowNum;
+    int             id[COL_MAX];
+
+    if ((id[COL_HOST]    = getDictId(host))          < 0 ||
+        (id[COL_USER]    = getDictId(ent->userName)) < 0 ||
+        (id[COL_TTY]     = getDictId(ent->tty))      < 0 ||
+        (id[COL_STIME]   = getDictId(ent->sTime))    < 0 ||
+        (id[COL_COMMAND] = getDictId(ent->command))  < 0)
+        return -1;
+
+    colWriter.rcvTime[row] = snap->rcvTime;
+    colWriter.pid[row]     = ent->pid;
+    colWriter.ppid[row]    = ent->ppid;
+    colWriter.cpuTime[row] = ent->cpuTime;
+    colWriter.snapSeq[row] = snapSeq;
+    colWriter.dictId[COL_HOST][row]    = id[COL_HOST];
+    colWriter.dictId[COL_USER][row]    = id[COL_USER];
+    colWriter.dictId[COL_TTY][row]     = id[COL_TTY];
+    colWriter.dictId[COL_STIME][row]   = id[COL_STIME];
+    colWriter.dictId[COL_COMMAND][row] = id[COL_COMMAND];
+
+    colWriter.rowNum++;
+
+    return 1;
+}
+
+int appendColumnStore(PS_SNAPSHOT *snap){
+
+    char        host[128];
+    long long   snapSeq;
+    int         i;
+
+    if (colWriter.dirName[0] == '\0' || openSegment(snap->rcvTime) < 0)
+        return -1;
+
+    snapSeq = colWriter.nextSnapSeq++;
+
+    snprintf(host, sizeof(host), "%s/%s", snap->ipAddress, snap->userName);
+
+    for (i = 0 ; i < snap->entryNum ; i++){
+
+        if (colWriter.rowNum >= COL_MAX_BLOCK_ROW && flushColumnStore() < 0)
+            return -1;
+
+        if (addColumnRow(host, snap, snapSeq, &snap->entry[i]) > 0)
+            continue;
+
+        // Dictionary is full : close the block and retry on an empty one
+        if (flushColumnStore() < 0 || addColumnRow(host, snap, snapSeq, &snap->entry[i]) < 0){
+            fprintf(stderr, "appendColumnStore() row is too big, pid[%d]\n", snap->entry[i].pid);
+            return -1;
+        }
+    }
+
+    return 1;
+}
+
+void closeColumnStore(){
+
+    if (colWriter.fd < 0)
+        return ;
+
+    flushColumnStore();
+    close(colWriter.fd);
+    colWriter.fd = -1;
+    colWriter.segStart = 0;
+}
+
+// ===================================================================
+// Reader
+//
+//  The file is mapped read-only. Dictionary strings are returned as
+//  pointers into the mapping, and a column is decoded only when asked.
+
+int openColumnFile(char *fName, PSM_COL_FILE *colFile){
+
+    struct stat     st;
+
+    colFile->addr = NULL;
+    colFile->size = 0;
+
+    colFile->fd = open(fName, O_RDONLY);
+    if (colFile->fd < 0){
+        fprintf(stderr, "open [%s] is failed, errno[%d]\n", fName, errno);
+        return -1;
+    }
+
+    if (fstat(colFile->fd, &st) < 0){
+        close(colFile->fd);
+        return -1;
+    }
+
+    if (st.st_size == 0)
+        return 1;
+
+    colFile->addr = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, colFile->fd, 0);
+    if (colFile->addr == MAP_FAILED){
+        fprintf(stderr, "mmap [%s] is failed, errno[%d]\n", fName, errno);
+        close(colFile->fd);
+        return -1;
+    }
+    colFile->size = st.st_size;
+
+    return 1;
+}
+
+void closeColumnFile(PSM_COL_FILE *colFile){
+
+    if (colFile->addr != NULL)
+        munmap(colFile->addr, colFile->size);
+    if (colFile->fd >= 0)
+        close(colFile->fd);
+
+    colFile->addr = NULL;
+    colFile->fd   = -1;
+}
+
+// Everything a reader indexes must stay inside the block : rows fit the
+// decode buffers, columns and dictionary strings end before blockLen
+static int checkColumnBlock(PSM_COL_HEADER *hdr){
+
+    unsigned int    *table, tableLen, poolEnd, i;
+    int             col;
+
+    if (hdr->rowNum > COL_MAX_BLOCK_ROW || hdr->dictNum > COL_MAX_DICT)
+        return -1;
+
+    for (col = 0 ; col < COL_MAX ; col++){
+        if (hdr->colOff[col] < sizeof(PSM_COL_HEADER) || hdr->colOff[col] > hdr->blockLen ||
+            hdr->colLen[col] > hdr->blockLen - hdr->colOff[col])
+            return -1;
+    }
+
+    // 01. Offset table[dictNum+1] ( 4-byte aligned ), the last entry is the end of the strings
+    tableLen = (hdr->dictNum + 1) * 4;
+    if (hdr->dictOff < sizeof(PSM_COL_HEADER) || hdr->dictOff % 4 != 0 ||
+        hdr->dictOff > hdr->blockLen || tableLen > hdr->blockLen - hdr->dictOff)
+        return -1;
+
+    table   = (unsigned int *)((char *)hdr + hdr->dictOff);
+    poolEnd = table[hdr->dictNum];
+    if (poolEnd < tableLen || poolEnd > hdr->blockLen - hdr->dictOff)
+        return -1;
+
+    // 02. Every string starts in the pool, and the pool ends with a NUL
+    for (i = 0 ; i < hdr->dictNum ; i++){
+        if (table[i] < tableLen || table[i] >= poolEnd)
+            return -1;
+    }
+    if (hdr->dictNum > 0 && ((char *)table)[poolEnd - 1] != '\0')
+        return -1;
+
+    return 1;
+}
+
+PSM_COL_HEADER *nextColumnBlock(PSM_COL_FILE *colFile, size_t *offset){
+
+    PSM_COL_HEADER  *hdr;
+
+    if (*offset + sizeof(PSM_COL_HEADER) > colFile->size)
+        return NULL;
+
+    hdr = (PSM_COL_HEADER *)(colFile->addr + *offset);
+    if (hdr->magic == COL_BLOCK_MAGIC && hdr->version != COL_BLOCK_VERSION){
+        fprintf(stderr, "Unsupported column block version[%u], offset[%zu]\n", hdr->version, *offset);
+        return NULL;
+    }
+    if (hdr->magic != COL_BLOCK_MAGIC ||
+        hdr->blockLen < sizeof(PSM_COL_HEADER) || hdr->blockLen % 8 != 0 ||
+        *offset + hdr->blockLen > colFile->size || checkColumnBlock(hdr) < 0){
+        fprintf(stderr, "Broken column block, offset[%zu]\n", *offset);
+        return NULL;
+    }
+
+    *offset += hdr->blockLen;
+
+    return hdr;
+}
+
+char *getColumnDict(PSM_COL_HEADER *blk, unsigned int id){
+
+    unsigned int *table;
+
+    if (id >= blk->dictNum)
+        return "";
+
+    table = (unsigned int *)((char *)blk + blk->dictOff);
+
+    return (char *)table + table[id];
+}
+
+// Decode one column of a block into value[rowNum]
+int decodeColumn(PSM_COL_HEADER *blk, int colId, long long *value){
+
+    unsigned char       *ptr, *end;
+    unsigned long long  raw;
+    long long           prev = 0;
+    unsigned int        i;
+
+    if (colId < 0 || colId >= COL_MAX)
+        return -1;
+
+    ptr = (unsigned char *)blk + blk->colOff[colId];
+    end = ptr + blk->colLen[colId];
+
+    for (i = 0 ; i < blk->rowNum ; i++){
+
+        if ((ptr = getVarint(ptr, end, &raw)) == NULL){
+            fprintf(stderr, "decodeColumn() column[%d] is broken\n", colId);
+            return -1;
+        }
+
+        switch (colId){
+            case COL_TIME:
+            case COL_PID:
+            case COL_PPID:
+            case COL_SNAP:
+                prev    += UNZIGZAG(raw);
+                value[i] = prev;
+                break;
+            default:
+                value[i] = (long long)raw;
+                break;
+        }
+    }
+
+    return blk->rowNum;
+}
@@ -0,0 +1,434 @@
+#include "psmanager.h"
+
+/*
+ * History Compaction ( runs on its own thread )
+ *
+ *   seg_<start>.col   : full resolution, kept for RECENT_WINDOW
+ *   min_<start>.roll  : per-minute rollup of one segment, kept for MINUTE_WINDOW
+ *   hour_<start>.roll : per-hour rollup
+ *
+ * Rollup line : "<bucket> <host> <snapshots> <rows> <maxCount> <command>"
+ *   snapshots : number of snapshots of the bucket the command was seen in
+ *   rows      : number of processes summed over those snapshots
+ *   maxCount  : largest number of instances in a single snapshot
+ * The command "*" counts all processes of the host.
+ *
+ * The oldest files are removed while HISTORY_DIR is over DISK_BUDGET_MB.
+ * Reads and writes are throttled to IO_LIMIT_KB per second so the
+ * ingestion loop never competes with a burst of compaction I/O.
+ */
+
+enum {
+    HIST_SEGMENT = 1,
+    HIST_MINUTE,
+    HIST_HOUR
+};
+
+typedef struct histfile{
+    int         type;
+    time_t      start;
+    long long   size;
+    char        fName[320];
+}HIST_FILE;
+
+typedef struct aggentry{
+    long long       bucket;
+    char            *host;
+    char            *command;
+    unsigned int    hash;
+    int             next;
+    int             snapNum;
+    int             rowNum;
+    int             maxCount;
+    int             curCount;
+    long long       lastSeq;
+}AGG_ENTRY;
+
+typedef struct aggtable{
+    int         entryNum;
+    int         entryMax;
+    AGG_ENTRY   *entry;
+#define AGG_BUCKET  (1 << 16)
+    int         bucket[AGG_BUCKET];
+}AGG_TABLE;
+
+static AGG_TABLE        aggTbl;
+static struct timeval   ioStart;
+static long long        ioBytes;
+
+int initCompaction(){
+
+    pthread_attr_t  thrAttr;
+    int             ret;
+
+    pthread_attr_init(&thrAttr);
+    pthread_attr_setdetachstate(&thrAttr, PTHREAD_CREATE_DETACHED);
+
+    ret = pthread_create(&psmConf.compactThrd, &thrAttr, compact_main, NULL);
+    if (ret != 0){
+        fprintf(stderr, "pthread_create() is Failed\n");
+        return -1;
+    }
+
+    return 1;
+}
+
+// Sleep until ioBytes fits in the budget of psmConf.ioLimit bytes/sec
+static void throttleIo(long long bytes){
+
+    struct timeval  now;
+    long long       elapsed, expected;
+
+    ioBytes += bytes;
+    if (psmConf.ioLimit <= 0)
+        return ;
+
+    gettimeofday(&now, NULL);
+    elapsed  = (now.tv_sec - ioStart.tv_sec) * 1000000LL + (now.tv_usec - ioStart.tv_usec);
+    expected = ioBytes * 1000000LL / psmConf.ioLimit;
+
+    if (expected > elapsed)
+        usleep(expected - elapsed);
+}
+
+static void clearAggTable(){
+
+    int     i;
+
+    for (i = 0 ; i < aggTbl.entryNum ; i++){
+        free(aggTbl.entry[i].host);
+        free(aggTbl.entry[i].command);
+    }
+
+    aggTbl.entryNum = 0;
+    memset(aggTbl.bucket, 0xff, sizeof(aggTbl.bucket));
+}
+
+static AGG_ENTRY *getAggEntry(long long bucket, char *host, char *command){
+
+    unsigned int    hash;
+    int             idx;
+    AGG_ENTRY       *ent;
+
+    hash = hashString(host) * 31 + hashString(command) + (unsigned int)bucket * 2654435761u;
+
+    for (idx = aggTbl.bucket[hash & (AGG_BUCKET - 1)] ; idx >= 0 ; idx = aggTbl.entry[idx].next){
+        ent = &aggTbl.entry[idx];
+        if (ent->hash == hash && ent->bucket == bucket &&
+            strcmp(ent->host, host) == 0 && strcmp(ent->command, command) == 0)
+            return ent;
+    }
+
+    if (aggTbl.entryNum == aggTbl.entryMax){
+        aggTbl.entryMax = aggTbl.entryMax ? aggTbl.entryMax * 2 : 4096;
+        aggTbl.entry = (AGG_ENTRY *)realloc(aggTbl.entry, sizeof(AGG_ENTRY) * aggTbl.entryMax);
+        if (aggTbl.entry == NULL){
+            fprintf(stderr, "getAggEntry() realloc is failed\n");
+            exit(1);
+        }
+    }
+
+    idx = aggTbl.entryNum++;
+    ent = &aggTbl.entry[idx];
+    memset(ent, 0x00, sizeof(AGG_ENTRY));
+    ent->bucket   = bucket;
+    ent->host     = strdup(host);
+    ent->command  = strdup(command);
+    ent->hash     = hash;
+    ent->lastSeq  = -1;
+    ent->next     = aggTbl.bucket[hash & (AGG_BUCKET - 1)];
+    aggTbl.bucket[hash & (AGG_BUCKET - 1)] = idx;
+
+    return ent;
+}
+
+// Rows of one snapshot are contiguous, so a new snapSeq starts a new snapshot
+static void addAggRow(long long bucket, char *host, char *command, long long snapSeq){
+
+    AGG_ENTRY   *ent = getAggEntry(bucket, host, command);
+
+    if (ent->lastSeq != snapSeq){
+        ent->snapNum++;
+        ent->curCount = 0;
+        ent->lastSeq  = snapSeq;
+    }
+
+    ent->rowNum++;
+    if (++ent->curCount > ent->maxCount)
+        ent->maxCount = ent->curCount;
+}
+
+static int writeAggTable(char *fName){
+
+    char        tmpName[300];
+    FILE        *fp;
+    AGG_ENTRY   *ent;
+    int         i, len;
+
+    snprintf(tmpName, sizeof(tmpName), "%s.tmp", fName);
+
+    fp = fopen(tmpName, "w");
+    if (fp == NULL){
+        fprintf(stderr, "fopen [%s] is failed \n", tmpName);
+        return -1;
+    }
+
+    for (i = 0 ; i < aggTbl.entryNum ; i++){
+        ent = &aggTbl.entry[i];
+        len = fprintf(fp, "%lld %s %d %d %d %s\n", ent->bucket, ent->host,
+                      ent->snapNum, ent->rowNum, ent->maxCount, ent->command);
+        throttleIo(len);
+    }
+
+    if (fclose(fp) != 0 || rename(tmpName, fName) < 0){
+        fprintf(stderr, "write [%s] is failed, errno[%d]\n", fName, errno);
+        unlink(tmpName);
+        return -1;
+    }
+
+    return 1;
+}
+
+static long long    rollTime[COL_MAX_BLOCK_ROW];
+static long long    rollHost[COL_MAX_BLOCK_ROW];
+static long long    rollCommand[COL_MAX_BLOCK_ROW];
+static long long    rollSeq[COL_MAX_BLOCK_ROW];
+
+// seg_<start>.col -> min_<start>.roll
+static int rollupSegment(HIST_FILE *seg){
+
+    PSM_COL_FILE    colFile;
+    PSM_COL_HEADER  *blk;
+    size_t          offset = 0;
+    unsigned int    i;
+    long long       bucket;
+    char            *host, fName[256];
+    int             ret;
+
+    if (openColumnFile(seg->fName, &colFile) < 0)
+        return -1;
+
+    clearAggTable();
+
+    while ((blk = nextColumnBlock(&colFile, &offset)) != NULL){
+
+        throttleIo(blk->blockLen);
+
+        if (decodeColumn(blk, COL_TIME, rollTime) < 0 ||
+            decodeColumn(blk, COL_HOST, rollHost) < 0 ||
+            decodeColumn(blk, COL_COMMAND, rollCommand) < 0 ||
+            decodeColumn(blk, COL_SNAP, rollSeq) < 0){
+            closeColumnFile(&colFile);
+            return -1;
+        }
+
+        for (i = 0 ; i < blk->rowNum ; i++){
+            bucket = rollTime[i] - rollTime[i] % 60;
+            host   = getColumnDict(blk, rollHost[i]);
+            addAggRow(bucket, host, getColumnDict(blk, rollCommand[i]), rollSeq[i]);
+            addAggRow(bucket, host, "*", rollSeq[i]);
+        }
+    }
+
+    closeColumnFile(&colFile);
+
+    snprintf(fName, sizeof(fName), "%s/min_%010ld.roll", HISTORY_DIR, (long)seg->start);
+    ret = writeAggTable(fName);
+    if (ret > 0)
+        unlink(seg->fName);
+
+    return ret;
+}
+
+// Add a rollup file into aggTbl with its bucket rounded down to bucketSec
+static int mergeRollup(char *fName, int bucketSec){
+
+    FILE        *fp;
+    char        readBuff[1024], host[128], *command;
+    long long   bucket;
+    int         snapNum, rowNum, maxCount, len, pos;
+    AGG_ENTRY   *ent;
+
+    fp = fopen(fName, "r");
+    if (fp == NULL)
+        return -1;
+
+    while (fgets(readBuff, sizeof(readBuff), fp) != NULL){
+
+        throttleIo(strlen(readBuff));
+
+        if (sscanf(readBuff, "%lld %127s %d %d %d %n", &bucket, host, &snapNum, &rowNum, &maxCount, &pos) != 5)
+            continue;
+
+        command = readBuff + pos;
+        len = strlen(command);
+        if (len > 0 && command[len-1] == '\n')
+            command[len-1] = '\0';
+
+        ent = getAggEntry(bucket - bucket % bucketSec, host, command);
+        ent->snapNum += snapNum;
+        ent->rowNum  += rowNum;
+        if (maxCount > ent->maxCount)
+            ent->maxCount = maxCount;
+    }
+
+    fclose(fp);
+
+    return 1;
+}
+
+static int compareHistFile(const void *a, const void *b){
+
+    const HIST_FILE *fa = (const HIST_FILE *)a;
+    const HIST_FILE *fb = (const HIST_FILE *)b;
+
+    if (fa->start != fb->start)
+        return fa->start < fb->start ? -1 : 1;
+
+    return fa->type - fb->type;
+}
+
+// List HISTORY_DIR sorted by start time. Return the number of files
+static int listHistory(HIST_FILE **list){
+
+    DIR             *dir;
+    struct dirent   *ent;
+    struct stat     st;
+    HIST_FILE       *hist = NULL;
+    int             histNum = 0, histMax = 0, type;
+    long            start;
+
+    dir = opendir(HISTORY_DIR);
+    if (dir == NULL){
+        fprintf(stderr, "opendir [%s] is failed\n", HISTORY_DIR);
+        return -1;
+    }
+
+    while ((ent = readdir(dir)) != NULL){
+
+        if (sscanf(ent->d_name, "seg_%ld.col", &start) == 1 && strstr(ent->d_name, ".tmp") == NULL)
+            type = HIST_SEGMENT;
+        else if (sscanf(ent->d_name, "min_%ld.roll", &start) == 1 && strstr(ent->d_name, ".tmp") == NULL)
+            type = HIST_MINUTE;
+        else if (sscanf(ent->d_name, "hour_%ld.roll", &start) == 1 && strstr(ent->d_name, ".tmp") == NULL)
+            type = HIST_HOUR;
+        else
+            continue;
+
+        if (histNum == histMax){
+            histMax = histMax ? histMax * 2 : 256;
+            hist = (HIST_FILE *)realloc(hist, sizeof(HIST_FILE) * histMax);
+            if (hist == NULL){
+                closedir(dir);
+                return -1;
+            }
+        }
+
+        snprintf(hist[histNum].fName, sizeof(hist[histNum].fName), "%s/%s", HISTORY_DIR, ent->d_name);
+        if (stat(hist[histNum].fName, &st) < 0)
+            continue;
+
+        hist[histNum].type  = type;
+        hist[histNum].start = start;
+        hist[histNum].size  = st.st_size;
+        histNum++;
+    }
+
+    closedir(dir);
+
+    qsort(hist, histNum, sizeof(HIST_FILE), compareHistFile);
+    *list = hist;
+
+    return histNum;
+}
+
+static void runCompaction(time_t now){
+
+    HIST_FILE   *hist = NULL;
+    int         histNum, i, j;
+    time_t      curSegment, hour;
+    long long   total;
+    char        fName[256];
+
+    gettimeofday(&ioStart, NULL);
+    ioBytes    = 0;
+    curSegment = getColumnSegment();
+
+    // 01. Segments out of the recent window -> per-minute rollups
+    if ((histNum = listHistory(&hist)) < 0)
+        return ;
+
+    for (i = 0 ; i < histNum ; i++){
+        if (hist[i].type != HIST_SEGMENT || hist[i].start == curSegment ||
+            hist[i].start + psmConf.segmentSec > now - psmConf.recentWindow)
+            continue;
+
+        if (rollupSegment(&hist[i]) < 0)
+            fprintf(stderr, "rollupSegment [%s] is failed\n", hist[i].fName);
+    }
+    free(hist);
+
+    // 02. Per-minute rollups out of the minute window -> per-hour rollups
+    if ((histNum = listHistory(&hist)) < 0)
+        return ;
+
+    for (i = 0 ; i < histNum ; i++){
+
+        if (hist[i].type != HIST_MINUTE)
+            continue;
+
+        hour = hist[i].start - hist[i].start % 3600;
+        if (hour + 3600 > now - psmConf.minuteWindow)
+            continue;
+
+        clearAggTable();
+        snprintf(fName, sizeof(fName), "%s/hour_%010ld.roll", HISTORY_DIR, (long)hour);
+        mergeRollup(fName, 3600);
+
+        for (j = i ; j < histNum ; j++){
+            if (hist[j].type == HIST_MINUTE && hist[j].start - hist[j].start % 3600 == hour)
+                mergeRollup(hist[j].fName, 3600);
+        }
+
+        if (writeAggTable(fName) < 0)
+            continue;
+
+        for (j = i ; j < histNum ; j++){
+            if (hist[j].type == HIST_MINUTE && hist[j].start - hist[j].start % 3600 == hour){
+                unlink(hist[j].fName);
+                hist[j].type = 0;
+            }
+        }
+    }
+    free(hist);
+    clearAggTable();
+
+    // 03. Disk budget : drop the oldest files first
+    if ((histNum = listHistory(&hist)) < 0)
+        return ;
+
+    for (total = 0, i = 0 ; i < histNum ; i++)
+        total += hist[i].size;
+
+    for (i = 0 ; i < histNum && total > psmConf.diskBudget ; i++){
+        if (hist[i].type == HIST_SEGMENT && hist[i].start == curSegment)
+            continue;
+
+        fprintf(stderr, "Disk budget exceeded, remove [%s]\n", hist[i].fName);
+        unlink(hist[i].fName);
+        total -= hist[i].size;
+    }
+    free(hist);
+}
+
+void *compact_main(void *arg){
+
+    memset(aggTbl.bucket, 0xff, sizeof(aggTbl.bucket));
+
+    while(1){
+        sleep(psmConf.compactInterval);
+        runCompaction(time(0));
+    }
+
+    return NULL;
+}
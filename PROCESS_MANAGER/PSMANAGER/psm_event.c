@@ -0,0 +1,281 @@
+#include "psmanager.h"
+
+static FILE     *evt_fp;
+
+static char *evtName[] = { "", "START", "EXIT", "RESTART" };
+
+char *getEventName(int evtType){
+
+    if (evtType < PSM_EVT_START || evtType > PSM_EVT_RESTART)
+        return "UNKNOWN";
+
+    return evtName[evtType];
+}
+
+int initEventStream(char *fName){
+
+    evt_fp = fopen(fName, "a+");
+    if (evt_fp == NULL){
+        fprintf(stderr, "fopen [%s] is failed \n", fName);
+        return -1;
+    }
+
+    return 1;
+}
+
+void closeEventStream(){
+
+    if (evt_fp != NULL){
+        fflush(evt_fp);
+        fclose(evt_fp);
+        evt_fp = NULL;
+    }
+}
+
+// One line per event : "time type host pid prevPid command"
+static void emitEvent(PSM_EVENT *evt){
+
+    PSM_HOST    *host;
+
+    if (evt_fp == NULL)
+        return ;
+
+    host = getHostByIdx(evt->hostIdx);
+    fprintf(evt_fp, "%ld %s %s %d %d %s\n", (long)evt->evtTime, getEventName(evt->evtType),
+            host != NULL ? host->hostName : "-", evt->pid, evt->prevPid, evt->command);
+}
+
+// Make sure tbl can hold entryNum processes with a load factor <= 0.5
+static int resizeProcTable(PSM_PROC_TBL *tbl, int entryNum){
+
+    int     capacity = 64;
+
+    while (capacity < entryNum * 2)
+        capacity <<= 1;
+
+    if (capacity <= tbl->capacity)
+        return 1;
+
+    free(tbl->slot);
+    free(tbl->used);
+
+    tbl->slot = (PSM_PROC_SLOT *)calloc(capacity, sizeof(PSM_PROC_SLOT));
+    tbl->used = (int *)malloc(sizeof(int) * capacity);
+    if (tbl->slot == NULL || tbl->used == NULL){
+        fprintf(stderr, "resizeProcTable() malloc is failed\n");
+        tbl->capacity = 0;
+        return -1;
+    }
+
+    tbl->capacity = capacity;
+    tbl->usedNum  = 0;
+
+    return 1;
+}
+
+// Return the slot of (pid, sTimeHash). *found is set when the slot is occupied
+static PSM_PROC_SLOT *findProcSlot(PSM_PROC_TBL *tbl, int pid, unsigned int sTimeHash, int *found){
+
+    unsigned int    mask, idx;
+    PSM_PROC_SLOT   *slot;
+
+    *found = 0;
+    if (tbl->capacity == 0)
+        return NULL;
+
+    mask = tbl->capacity - 1;
+    idx  = ((unsigned int)pid * 2654435761u ^ sTimeHash) & mask;
+
+    for (;; idx = (idx + 1) & mask){
+        slot = &tbl->slot[idx];
+        if (slot->pid == 0)
+            return slot;
+        if (slot->pid == pid && slot->sTimeHash == sTimeHash){
+            *found = 1;
+            return slot;
+        }
+    }
+}
+
+static void clearProcTable(PSM_PROC_TBL *tbl){
+
+    int     i;
+
+    for (i = 0 ; i < tbl->usedNum ; i++)
+        tbl->slot[tbl->used[i]].pid = 0;
+
+    tbl->usedNum = 0;
+}
+
+/*
+ * Diff a snapshot against the last one of the same host and emit
+ *   START   : (pid, stime) was not in the last snapshot
+ *   EXIT    : (pid, stime) is no longer reported
+ *   RESTART : an EXIT and a START of the same command in one snapshot
+ * ps prints STIME as "HH:MM", then "MmmDD" after midnight, then "YYYY" :
+ * an EXIT and a START of the same pid and command is that change, the
+ * process is carried over under its new key and nothing is emitted.
+ * The first snapshot of a host only builds the table.
+ * Called from several pipeline workers at once, but a host is always
+ * diffed by the same worker, so only the scratch lists are per call.
+ */
+int diffSnapshot(PS_SNAPSHOT *snap){
+
+#define RESTART_TBL_SIZE    (MAX_PS_ENTRY * 2)
+    PSM_PROC_SLOT           *startList[MAX_PS_ENTRY];
+    PS_ENTRY                *startEnt[MAX_PS_ENTRY];
+    int                     exitSlot[RESTART_TBL_SIZE];
+    unsigned int            prevSTimeHash = 0;
+    PSM_HOST                *host;
+    PSM_PROC_TBL            *oldTbl, *newTbl;
+    PSM_PROC_SLOT           *slot, *oldSlot;
+    PS_ENTRY                *ent;
+    PSM_EVENT               evt;
+    unsigned int            sTimeHash, cmdHash, idx;
+    int                     i, found, startNum = 0, evtNum = 0;
+
+    host = getHost(snap->ipAddress, snap->userName);
+    if (host == NULL)
+        return -1;
+
+    oldTbl = &host->procTbl[host->cur];
+    newTbl = &host->procTbl[host->cur ^ 1];
+
+    if (resizeProcTable(newTbl, snap->entryNum) < 0)
+        return -1;
+
+    // 01. Insert into the spare table, look up the current one
+    for (i = 0 ; i < snap->entryNum ; i++){
+
+        ent       = &snap->entry[i];
+        sTimeHash = hashString(ent->sTime);
+
+        slot = findProcSlot(newTbl, ent->pid, sTimeHash, &found);
+        if (found)
+            continue;
+
+        cmdHash = hashString(ent->command);
+
+        slot->pid       = ent->pid;
+        slot->ppid      = ent->ppid;
+        slot->sTimeHash = sTimeHash;
+        slot->cmdHash   = cmdHash;
+        slot->seen      = 0;
+        strncpy(slot->command, ent->command, sizeof(slot->command) - 1);
+        slot->command[sizeof(slot->command) - 1] = '\0';
+        newTbl->used[newTbl->usedNum++] = slot - newTbl->slot;
+
+        oldSlot = findProcSlot(oldTbl, ent->pid, sTimeHash, &found);
+        if (found)
+            oldSlot->seen = 1;
+        else {
+            startEnt[startNum]    = ent;
+            startList[startNum++] = slot;
+        }
+    }
+
+    // The first snapshot of a host only feeds the command index
+    if (host->snapNum++ == 0){
+        for (i = 0 ; i < startNum ; i++)
+            addIndexProcess(host->hostIdx, startEnt[i]->pid, startList[i]->sTimeHash, startEnt[i]->command);
+        goto swap;
+    }
+
+    evt.hostIdx = host->hostIdx;
+    evt.evtTime = snap->rcvTime;
+
+    // 02. Exited processes, indexed by command for RESTART matching
+    memset(exitSlot, 0xff, sizeof(exitSlot));
+    for (i = 0 ; i < oldTbl->usedNum ; i++){
+
+        oldSlot = &oldTbl->slot[oldTbl->used[i]];
+        if (oldSlot->seen)
+            continue;
+
+        idx = oldSlot->cmdHash & (RESTART_TBL_SIZE - 1);
+        while (exitSlot[idx] >= 0)
+            idx = (idx + 1) & (RESTART_TBL_SIZE - 1);
+        exitSlot[idx] = oldTbl->used[i];
+    }
+
+    // 03. START / RESTART
+    for (i = 0 ; i < startNum ; i++){
+
+        slot = startList[i];
+
+        // Same pid and command under a new STIME text : not an event
+        idx = slot->cmdHash & (RESTART_TBL_SIZE - 1);
+        for (; exitSlot[idx] != -1 ; idx = (idx + 1) & (RESTART_TBL_SIZE - 1)){
+
+            if (exitSlot[idx] < 0)
+                continue;
+
+            oldSlot = &oldTbl->slot[exitSlot[idx]];
+            if (oldSlot->pid == slot->pid && oldSlot->cmdHash == slot->cmdHash &&
+                strcmp(oldSlot->command, slot->command) == 0)
+                break;
+        }
+        if (exitSlot[idx] >= 0){
+            rekeyIndexProcess(host->hostIdx, slot->pid, oldSlot->sTimeHash, slot->sTimeHash);
+            oldSlot->seen = 1;
+            exitSlot[idx] = -2;
+            continue;
+        }
+
+        evt.evtType = PSM_EVT_START;
+        evt.pid     = slot->pid;
+        evt.prevPid = 0;
+        evt.command = slot->command;
+
+        idx = slot->cmdHash & (RESTART_TBL_SIZE - 1);
+        for (; exitSlot[idx] != -1 ; idx = (idx + 1) & (RESTART_TBL_SIZE - 1)){
+
+            if (exitSlot[idx] < 0)
+                continue;       // already matched
+
+            oldSlot = &oldTbl->slot[exitSlot[idx]];
+            if (oldSlot->cmdHash == slot->cmdHash && strcmp(oldSlot->command, slot->command) == 0){
+                evt.evtType = PSM_EVT_RESTART;
+                evt.prevPid = oldSlot->pid;
+                prevSTimeHash = oldSlot->sTimeHash;
+                oldSlot->seen = 1;
+                exitSlot[idx] = -2;
+                break;
+            }
+        }
+
+        if (evt.evtType == PSM_EVT_RESTART)
+            removeIndexProcess(host->hostIdx, evt.prevPid, prevSTimeHash);
+        addIndexProcess(host->hostIdx, evt.pid, slot->sTimeHash, startEnt[i]->command);
+
+        emitEvent(&evt);
+        evtNum++;
+    }
+
+    // 04. EXIT
+    for (i = 0 ; i < oldTbl->usedNum ; i++){
+
+        oldSlot = &oldTbl->slot[oldTbl->used[i]];
+        if (oldSlot->seen)
+            continue;
+
+        evt.evtType = PSM_EVT_EXIT;
+        evt.pid     = oldSlot->pid;
+        evt.prevPid = 0;
+        evt.command = oldSlot->command;
+
+        // By (pid, stime) : a START of this pid above may have indexed a new process
+        removeIndexProcess(host->hostIdx, evt.pid, oldSlot->sTimeHash);
+        emitEvent(&evt);
+        evtNum++;
+    }
+
+    if (evt_fp != NULL && evtNum > 0)
+        fflush(evt_fp);
+
+swap:
+    clearProcTable(oldTbl);
+    host->cur ^= 1;
+
+    return evtNum;
+}
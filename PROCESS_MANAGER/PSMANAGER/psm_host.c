@@ -0,0 +1,81 @@
+#include "psmanager.h"
+
+// Host registry : "ip/user" -> PSM_HOST ( open addressing, MAX_PSM_HOST*2 slots )
+
+static PSM_HOST     hostList[MAX_PSM_HOST];
+static int          hostNum;
+static int          hostSlot[MAX_PSM_HOST * 2];
+static int          hostSlotInit;
+static pthread_mutex_t  hostLock = PTHREAD_MUTEX_INITIALIZER;
+
+unsigned int hashString(char *str){
+
+    unsigned int hash = 2166136261u;
+
+    while (*str != '\0'){
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+PSM_HOST *getHost(char *ipAddress, char *userName){
+
+    char            hostName[128];
+    unsigned int    mask = MAX_PSM_HOST * 2 - 1;
+    unsigned int    slot;
+    int             idx;
+    PSM_HOST        *host;
+
+    snprintf(hostName, sizeof(hostName), "%s/%s", ipAddress, userName);
+
+    pthread_mutex_lock(&hostLock);
+
+    if (!hostSlotInit){
+        memset(hostSlot, 0xff, sizeof(hostSlot));
+        hostSlotInit = 1;
+    }
+
+    slot = hashString(hostName) & mask;
+    while ((idx = hostSlot[slot]) >= 0){
+        if (strcmp(hostList[idx].hostName, hostName) == 0){
+            pthread_mutex_unlock(&hostLock);
+            return &hostList[idx];
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (hostNum >= MAX_PSM_HOST){
+        pthread_mutex_unlock(&hostLock);
+        fprintf(stderr, "Host Table is full, host[%s]\n", hostName);
+        return NULL;
+    }
+
+    // Fill the entry before hostNum publishes it to getHostByIdx()
+    idx  = hostNum;
+    host = &hostList[idx];
+    memset(host, 0x00, sizeof(PSM_HOST));
+    snprintf(host->hostName, sizeof(host->hostName), "%s", hostName);
+    host->hostIdx = idx;
+
+    hostSlot[slot] = idx;
+    __atomic_store_n(&hostNum, idx + 1, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&hostLock);
+
+    return host;
+}
+
+PSM_HOST *getHostByIdx(int hostIdx){
+
+    if (hostIdx < 0 || hostIdx >= __atomic_load_n(&hostNum, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    return &hostList[hostIdx];
+}
+
+int getHostNum(){
+
+    return __atomic_load_n(&hostNum, __ATOMIC_ACQUIRE);
+}
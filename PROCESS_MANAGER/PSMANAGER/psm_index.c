@@ -0,0 +1,605 @@
+#include "psmanager.h"
+
+// ===================================================================
+// Index
+
+typedef struct cmdindex{
+
+    // Interned tokens
+    int             tokenNum;           // ids in use or freed
+    int             tokenMax;
+    int             liveNum;
+    PSM_IDX_TOKEN   *token;
+#define IDX_TOKEN_BUCKET    (1 << 14)
+    int             tokenBucket[IDX_TOKEN_BUCKET];
+
+    // Prefix search : sortedNum ids in strcmp() order, then pendNum new ones.
+    // A token losing its last posting is retired : out of the hash, still
+    // listed with its name until the next merge drops it, and only then
+    // reused, so the sorted part stays in order.
+    int             *sortedToken;
+    int             sortedNum;
+    int             pendNum;
+    int             retiredToken;       // freed, still listed
+    int             freeToken;          // reusable ids
+
+    // Process records, chained by (hostIdx, pid)
+    int             procNum;
+    int             procMax;
+    int             procFree;
+    PSM_IDX_PROC    *proc;
+    int             procBucket[IDX_PROC_BUCKET];
+
+    unsigned int    queryStamp;
+}PSM_CMD_INDEX;
+
+static PSM_CMD_INDEX    cmdIndex;
+static int              cmdIndexInit;
+
+// Pipeline workers update the index while the main thread answers queries
+static pthread_mutex_t  cmdIndexLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void initCmdIndex(){
+
+    memset(&cmdIndex, 0x00, sizeof(cmdIndex));
+    memset(cmdIndex.tokenBucket, 0xff, sizeof(cmdIndex.tokenBucket));
+    memset(cmdIndex.procBucket, 0xff, sizeof(cmdIndex.procBucket));
+    cmdIndex.procFree     = -1;
+    cmdIndex.retiredToken = -1;
+    cmdIndex.freeToken    = -1;
+    cmdIndexInit = 1;
+}
+
+static unsigned int getProcBucket(int hostIdx, int pid){
+
+    return ((unsigned int)hostIdx * 2654435761u ^ (unsigned int)pid * 40503u) & (IDX_PROC_BUCKET - 1);
+}
+
+static int compareTokenName(const void *a, const void *b){
+
+    return strcmp(cmdIndex.token[*(int *)a].name, cmdIndex.token[*(int *)b].name);
+}
+
+// Sort the pending tokens into sortedToken and drop the retired ones, O(tokenNum)
+static void mergeSortedToken(){
+
+    int     *sorted = cmdIndex.sortedToken, pend[IDX_MAX_PEND], i, j, n = 0, pendNum = 0, id;
+
+    for (i = 0 ; i < cmdIndex.pendNum ; i++){
+        id = sorted[cmdIndex.sortedNum + i];
+        if (cmdIndex.token[id].postNum > 0)
+            pend[pendNum++] = id;
+    }
+    qsort(pend, pendNum, sizeof(int), compareTokenName);
+
+    for (i = 0 ; i < cmdIndex.sortedNum ; i++){
+        if (cmdIndex.token[sorted[i]].postNum > 0)
+            sorted[n++] = sorted[i];
+    }
+
+    // Backward merge, the free room after sorted[n - 1] holds the result
+    i = n - 1;
+    j = pendNum - 1;
+    for (id = n + pendNum - 1 ; j >= 0 ; id--){
+        if (i >= 0 && compareTokenName(&sorted[i], &pend[j]) > 0)
+            sorted[id] = sorted[i--];
+        else
+            sorted[id] = pend[j--];
+    }
+
+    cmdIndex.sortedNum = n + pendNum;
+    cmdIndex.pendNum   = 0;
+
+    // Nothing lists the retired ids any more
+    while ((id = cmdIndex.retiredToken) >= 0){
+        cmdIndex.retiredToken = cmdIndex.token[id].next;
+        free(cmdIndex.token[id].name);
+        cmdIndex.token[id].name = NULL;
+        cmdIndex.token[id].next = cmdIndex.freeToken;
+        cmdIndex.freeToken = id;
+    }
+}
+
+// Return the interned id of name, adding it if needed. -1 past IDX_MAX_TOKEN_NUM
+static int internToken(char *name){
+
+    unsigned int    hash = hashString(name);
+    unsigned int    bucket = hash & (IDX_TOKEN_BUCKET - 1);
+    int             id;
+    PSM_IDX_TOKEN   *tok;
+
+    for (id = cmdIndex.tokenBucket[bucket] ; id >= 0 ; id = cmdIndex.token[id].next){
+        if (cmdIndex.token[id].hash == hash && strcmp(cmdIndex.token[id].name, name) == 0)
+            return id;
+    }
+
+    if (cmdIndex.pendNum >= IDX_MAX_PEND || (cmdIndex.freeToken < 0 && cmdIndex.retiredToken >= 0 &&
+                                             cmdIndex.tokenNum == IDX_MAX_TOKEN_NUM))
+        mergeSortedToken();
+
+    if (cmdIndex.freeToken >= 0){
+        id = cmdIndex.freeToken;
+        cmdIndex.freeToken = cmdIndex.token[id].next;
+    }
+    else {
+        if (cmdIndex.tokenNum == IDX_MAX_TOKEN_NUM)
+            return -1;
+
+        if (cmdIndex.tokenNum == cmdIndex.tokenMax){
+            cmdIndex.tokenMax = cmdIndex.tokenMax ? cmdIndex.tokenMax * 2 : 1024;
+            cmdIndex.token = (PSM_IDX_TOKEN *)realloc(cmdIndex.token, sizeof(PSM_IDX_TOKEN) * cmdIndex.tokenMax);
+            cmdIndex.sortedToken = (int *)realloc(cmdIndex.sortedToken, sizeof(int) * cmdIndex.tokenMax);
+            if (cmdIndex.token == NULL || cmdIndex.sortedToken == NULL){
+                fprintf(stderr, "internToken() realloc is failed\n");
+                exit(1);
+            }
+        }
+        id = cmdIndex.tokenNum++;
+    }
+
+    tok = &cmdIndex.token[id];
+    memset(tok, 0x00, sizeof(PSM_IDX_TOKEN));
+    tok->name = strdup(name);
+    tok->hash = hash;
+    tok->next = cmdIndex.tokenBucket[bucket];
+    cmdIndex.tokenBucket[bucket] = id;
+    cmdIndex.liveNum++;
+
+    // Appended unsorted, merged every IDX_MAX_PEND new tokens
+    cmdIndex.sortedToken[cmdIndex.sortedNum + cmdIndex.pendNum++] = id;
+
+    return id;
+}
+
+// Retire a token without postings, mergeSortedToken() frees it
+static void releaseToken(int tokenId){
+
+    PSM_IDX_TOKEN   *tok = &cmdIndex.token[tokenId];
+    int             *link;
+
+    for (link = &cmdIndex.tokenBucket[tok->hash & (IDX_TOKEN_BUCKET - 1)] ; *link != tokenId ;
+         link = &cmdIndex.token[*link].next);
+    *link = tok->next;
+
+    free(tok->post);
+    tok->post    = NULL;
+    tok->postMax = 0;
+    tok->next    = cmdIndex.retiredToken;
+    cmdIndex.retiredToken = tokenId;
+    cmdIndex.liveNum--;
+}
+
+static int addPosting(int tokenId, int procId){
+
+    PSM_IDX_TOKEN   *tok = &cmdIndex.token[tokenId];
+
+    if (tok->postNum == tok->postMax){
+        tok->postMax = tok->postMax ? tok->postMax * 2 : 4;
+        tok->post = (int *)realloc(tok->post, sizeof(int) * tok->postMax);
+        if (tok->post == NULL){
+            fprintf(stderr, "addPosting() realloc is failed\n");
+            exit(1);
+        }
+    }
+
+    tok->post[tok->postNum] = procId;
+
+    return tok->postNum++;
+}
+
+// Swap-remove, then fix the back pointer of the moved process
+static void removePosting(int tokenId, int pos){
+
+    PSM_IDX_TOKEN   *tok = &cmdIndex.token[tokenId];
+    PSM_IDX_PROC    *moved;
+    int             i;
+
+    tok->postNum--;
+    if (tok->postNum == 0){
+        releaseToken(tokenId);
+        return ;
+    }
+    if (pos == tok->postNum)
+        return ;
+
+    tok->post[pos] = tok->post[tok->postNum];
+
+    moved = &cmdIndex.proc[tok->post[pos]];
+    for (i = 0 ; i < moved->tokenNum ; i++){
+        if (moved->tokenId[i] == tokenId && moved->postPos[i] == tok->postNum){
+            moved->postPos[i] = pos;
+            break;
+        }
+    }
+}
+
+static int allocProc(){
+
+    int     id;
+
+    if (cmdIndex.procFree >= 0){
+        id = cmdIndex.procFree;
+        cmdIndex.procFree = cmdIndex.proc[id].next;
+        return id;
+    }
+
+    if (cmdIndex.procNum == cmdIndex.procMax){
+        cmdIndex.procMax = cmdIndex.procMax ? cmdIndex.procMax * 2 : 4096;
+        cmdIndex.proc = (PSM_IDX_PROC *)realloc(cmdIndex.proc, sizeof(PSM_IDX_PROC) * cmdIndex.procMax);
+        if (cmdIndex.proc == NULL){
+            fprintf(stderr, "allocProc() realloc is failed\n");
+            exit(1);
+        }
+    }
+
+    return cmdIndex.procNum++;
+}
+
+static int removeProcess(int hostIdx, int pid, unsigned int sTimeHash, int anyStime);
+
+static int addProcess(int hostIdx, int pid, unsigned int sTimeHash, char *command){
+
+    PSM_IDX_PROC    *proc;
+    char            word[IDX_MAX_TOKEN_LEN], *ptr, *base;
+    int             id, len, i, tokenId;
+    unsigned int    bucket;
+
+    if (!cmdIndexInit)
+        initCmdIndex();
+
+    // A pid reused without an EXIT in between replaces the old record
+    removeProcess(hostIdx, pid, 0, 1);
+
+    id   = allocProc();
+    proc = &cmdIndex.proc[id];
+    memset(proc, 0x00, sizeof(PSM_IDX_PROC));
+    proc->hostIdx   = hostIdx;
+    proc->pid       = pid;
+    proc->sTimeHash = sTimeHash;
+    strncpy(proc->command, command, sizeof(proc->command) - 1);
+
+    bucket = getProcBucket(hostIdx, pid);
+    proc->next = cmdIndex.procBucket[bucket];
+    cmdIndex.procBucket[bucket] = id;
+
+    // Split into argv words ( plus basename of argv[0] )
+    for (ptr = command ; *ptr != '\0' && proc->tokenNum < IDX_MAX_TOKEN ; ){
+
+        while (*ptr == ' ' || *ptr == '\t') ptr++;
+        for (len = 0 ; ptr[len] != '\0' && ptr[len] != ' ' && ptr[len] != '\t' ; len++);
+        if (len == 0)
+            break;
+
+        snprintf(word, sizeof(word), "%.*s", len, ptr);
+        ptr += len;
+
+        for (i = 0 ; i < 2 && proc->tokenNum < IDX_MAX_TOKEN ; i++){
+
+            if (i == 1){
+                if (proc->tokenNum != 1 || (base = strrchr(word, '/')) == NULL || base[1] == '\0')
+                    break;
+                memmove(word, base + 1, strlen(base + 1) + 1);
+            }
+
+            if ((tokenId = internToken(word)) < 0)
+                continue;
+            proc->tokenId[proc->tokenNum] = tokenId;
+            proc->postPos[proc->tokenNum] = addPosting(tokenId, id);
+            proc->tokenNum++;
+        }
+    }
+
+    return 1;
+}
+
+// Remove the record of (hostIdx, pid, sTimeHash), of (hostIdx, pid) with anyStime
+static int removeProcess(int hostIdx, int pid, unsigned int sTimeHash, int anyStime){
+
+    PSM_IDX_PROC    *proc;
+    unsigned int    bucket;
+    int             id, *link, i;
+
+    if (!cmdIndexInit)
+        return -1;
+
+    bucket = getProcBucket(hostIdx, pid);
+
+    for (link = &cmdIndex.procBucket[bucket] ; (id = *link) >= 0 ; link = &cmdIndex.proc[id].next){
+
+        proc = &cmdIndex.proc[id];
+        if (proc->hostIdx != hostIdx || proc->pid != pid || (!anyStime && proc->sTimeHash != sTimeHash))
+            continue;
+
+        *link = proc->next;
+
+        // Reverse order keeps postPos of duplicated tokens valid
+        for (i = proc->tokenNum - 1 ; i >= 0 ; i--)
+            removePosting(proc->tokenId[i], proc->postPos[i]);
+
+        proc->pid  = 0;
+        proc->next = cmdIndex.procFree;
+        cmdIndex.procFree = id;
+        return 1;
+    }
+
+    return -1;
+}
+
+int addIndexProcess(int hostIdx, int pid, unsigned int sTimeHash, char *command){
+
+    int     ret;
+
+    pthread_mutex_lock(&cmdIndexLock);
+    ret = addProcess(hostIdx, pid, sTimeHash, command);
+    pthread_mutex_unlock(&cmdIndexLock);
+
+    return ret;
+}
+
+// The exit of an old (pid, stime) leaves a newer process of the same pid alone
+int removeIndexProcess(int hostIdx, int pid, unsigned int sTimeHash){
+
+    int     ret;
+
+    pthread_mutex_lock(&cmdIndexLock);
+    ret = removeProcess(hostIdx, pid, sTimeHash, 0);
+    pthread_mutex_unlock(&cmdIndexLock);
+
+    return ret;
+}
+
+// Same process, new STIME text ( "HH:MM" -> "MmmDD" -> "YYYY" ) : only the key changes
+int rekeyIndexProcess(int hostIdx, int pid, unsigned int oldSTimeHash, unsigned int sTimeHash){
+
+    PSM_IDX_PROC    *proc;
+    int             id, ret = -1;
+
+    pthread_mutex_lock(&cmdIndexLock);
+    if (cmdIndexInit){
+        for (id = cmdIndex.procBucket[getProcBucket(hostIdx, pid)] ; id >= 0 ; id = proc->next){
+            proc = &cmdIndex.proc[id];
+            if (proc->hostIdx == hostIdx && proc->pid == pid && proc->sTimeHash == oldSTimeHash){
+                proc->sTimeHash = sTimeHash;
+                ret = 1;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&cmdIndexLock);
+
+    return ret;
+}
+
+// ===================================================================
+// Query Socket
+
+enum {
+    QUERY_TOKEN = 1,
+    QUERY_PREFIX,
+    QUERY_SUBSTR
+};
+
+// Built under cmdIndexLock, written after it is released
+typedef struct queryreply{
+    int     fd;
+    int     len;
+    int     max;
+    int     count;
+    char    *buff;
+}QUERY_REPLY;
+
+static int          querySockFd = -1;
+static QUERY_REPLY  queryReply;
+
+int initQuerySocket(char *sockPath){
+
+    struct sockaddr_un  addr;
+
+    querySockFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (querySockFd < 0){
+        fprintf(stderr, "socket() is failed\n");
+        return -1;
+    }
+
+    memset(&addr, 0x00, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sockPath);
+    unlink(sockPath);
+
+    if (bind(querySockFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(querySockFd, 16) < 0){
+        fprintf(stderr, "bind() [%s] is failed, errno[%d]\n", sockPath, errno);
+        close(querySockFd);
+        querySockFd = -1;
+        return -1;
+    }
+
+    // Polled from the main loop
+    fcntl(querySockFd, F_SETFL, fcntl(querySockFd, F_GETFL) | O_NONBLOCK);
+
+    return 1;
+}
+
+void closeQuerySocket(){
+
+    if (querySockFd >= 0){
+        close(querySockFd);
+        querySockFd = -1;
+    }
+}
+
+// Make room for need more bytes
+static void growReply(int need){
+
+    if (queryReply.len + need <= queryReply.max)
+        return ;
+
+    while (queryReply.len + need > queryReply.max)
+        queryReply.max = queryReply.max ? queryReply.max * 2 : 65536;
+
+    queryReply.buff = (char *)realloc(queryReply.buff, queryReply.max);
+    if (queryReply.buff == NULL){
+        fprintf(stderr, "growReply() realloc is failed\n");
+        exit(1);
+    }
+}
+
+// The client gets SO_SNDTIMEO to drain the reply, then it is dropped
+static int flushReply(){
+
+    int     ret, off = 0;
+
+    while (off < queryReply.len){
+        ret = write(queryReply.fd, queryReply.buff + off, queryReply.len - off);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0){
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                fprintf(stderr, "Query client is too slow, dropped\n");
+            queryReply.len = 0;
+            return -1;
+        }
+        off += ret;
+    }
+
+    queryReply.len = 0;
+
+    return 1;
+}
+
+static void replyToken(int tokenId){
+
+    PSM_IDX_TOKEN   *tok = &cmdIndex.token[tokenId];
+    PSM_IDX_PROC    *proc;
+    PSM_HOST        *host;
+    int             i;
+
+    for (i = 0 ; i < tok->postNum ; i++){
+
+        proc = &cmdIndex.proc[tok->post[i]];
+        if (proc->queryStamp == cmdIndex.queryStamp)
+            continue;
+        proc->queryStamp = cmdIndex.queryStamp;
+
+        growReply(IDX_CMD_LEN + 256);
+
+        host = getHostByIdx(proc->hostIdx);
+        queryReply.len += sprintf(queryReply.buff + queryReply.len, "%s %d %s\n",
+                                  host != NULL ? host->hostName : "-", proc->pid, proc->command);
+        queryReply.count++;
+    }
+}
+
+static void runQuery(int queryType, char *word){
+
+    unsigned int    hash;
+    int             lo, hi, mid, len, i, id;
+
+    if (!cmdIndexInit)
+        initCmdIndex();
+
+    cmdIndex.queryStamp++;
+    len = strlen(word);
+
+    switch (queryType){
+
+        case QUERY_TOKEN:
+            hash = hashString(word);
+            for (id = cmdIndex.tokenBucket[hash & (IDX_TOKEN_BUCKET - 1)] ; id >= 0 ; id = cmdIndex.token[id].next){
+                if (cmdIndex.token[id].hash == hash && strcmp(cmdIndex.token[id].name, word) == 0){
+                    replyToken(id);
+                    break;
+                }
+            }
+            break;
+
+        case QUERY_PREFIX:
+            // lower bound of word in the sorted part, then the pending tokens
+            lo = 0;
+            hi = cmdIndex.sortedNum;
+            while (lo < hi){
+                mid = (lo + hi) / 2;
+                if (strcmp(cmdIndex.token[cmdIndex.sortedToken[mid]].name, word) < 0)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+
+            for (i = lo ; i < cmdIndex.sortedNum ; i++){
+                id = cmdIndex.sortedToken[i];
+                if (strncmp(cmdIndex.token[id].name, word, len) != 0)
+                    break;
+                if (cmdIndex.token[id].postNum > 0)
+                    replyToken(id);
+            }
+            for (i = cmdIndex.sortedNum ; i < cmdIndex.sortedNum + cmdIndex.pendNum ; i++){
+                id = cmdIndex.sortedToken[i];
+                if (cmdIndex.token[id].postNum > 0 && strncmp(cmdIndex.token[id].name, word, len) == 0)
+                    replyToken(id);
+            }
+            break;
+
+        case QUERY_SUBSTR:
+            // Linear over the token table : O(tokens of running processes * IDX_MAX_TOKEN_LEN)
+            for (id = 0 ; id < cmdIndex.tokenNum ; id++){
+                if (cmdIndex.token[id].postNum > 0 && strstr(cmdIndex.token[id].name, word) != NULL)
+                    replyToken(id);
+            }
+            break;
+    }
+}
+
+void pollQuerySocket(){
+
+    struct timeval  tv, start, end;
+    char            readBuff[256], cmd[16], word[IDX_MAX_TOKEN_LEN];
+    int             fd, ret, queryType;
+
+    if (querySockFd < 0)
+        return ;
+
+    while ((fd = accept(querySockFd, NULL, NULL)) >= 0){
+
+        tv.tv_sec  = 0;
+        tv.tv_usec = 100000;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        memset(readBuff, 0x00, sizeof(readBuff));
+        ret = read(fd, readBuff, sizeof(readBuff) - 1);
+
+        queryReply.fd    = fd;
+        queryReply.len   = 0;
+        queryReply.count = 0;
+        growReply(256);
+
+        word[0] = '\0';
+        if (ret <= 0 || sscanf(readBuff, "%15s %63s", cmd, word) != 2){
+            queryReply.len = sprintf(queryReply.buff, "ERROR usage: TOKEN|PREFIX|SUBSTR <word>\n");
+            flushReply();
+            close(fd);
+            continue;
+        }
+
+        if (strcmp(cmd, "TOKEN") == 0)          queryType = QUERY_TOKEN;
+        else if (strcmp(cmd, "PREFIX") == 0)    queryType = QUERY_PREFIX;
+        else if (strcmp(cmd, "SUBSTR") == 0)    queryType = QUERY_SUBSTR;
+        else {
+            queryReply.len = sprintf(queryReply.buff, "ERROR unknown query [%s]\n", cmd);
+            flushReply();
+            close(fd);
+            continue;
+        }
+
+        gettimeofday(&start, NULL);
+        pthread_mutex_lock(&cmdIndexLock);
+        runQuery(queryType, word);
+        pthread_mutex_unlock(&cmdIndexLock);
+        gettimeofday(&end, NULL);
+
+        growReply(64);
+        queryReply.len += sprintf(queryReply.buff + queryReply.len, "END %d %ld\n", queryReply.count,
+                                  (long)((end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec)));
+        flushReply();
+        close(fd);
+    }
+}
@@ -11,38 +11,163 @@ int initPsm(){
 	signal (SIGINT, (void *)sig_interrupt_alarm);
 	signal (SIGTSTP, (void *)sig_stop_alarm);
 
-    // 02. Init Message Queue
+    // 02. Read PSMANAGER CONFIG DATA ( psmanager.dat )
+    sprintf(myAppName, "%s", "psmanager");
+
+    ret = readConfigData();
+    if (ret < 0){
+        fprintf( stderr, "readConfigData() is failed \n");
+        return -1;
+    }
+
+    // 03. Init Message Queue
     ret = initMsgQueue();
     if (ret < 0){
         fprintf( stderr, "initMsgQueue() is failed \n");
         return -1;
     }
 
-    // 03. Init Shared Memory
+    // 04. Init Shared Memory
     ret = initSharedMemory();
     if (ret < 0){
         fprintf( stderr, "initMsgQueue() is failed \n");
         return -1;
     }
 
+    // 05. Open Column Store
+    ret = initColumnStore(HISTORY_DIR);
+    if (ret < 0){
+        fprintf( stderr, "initColumnStore() is failed \n");
+        return -1;
+    }
+
+    // 06. Open Event Stream
+    ret = initEventStream(EVT_FILE_NAME);
+    if (ret < 0){
+        fprintf( stderr, "initEventStream() is failed \n");
+        return -1;
+    }
+
+    // 07. Open Command Index Query Socket
+    ret = initQuerySocket(QUERY_SOCK_PATH);
+    if (ret < 0){
+        fprintf( stderr, "initQuerySocket() is failed \n");
+        return -1;
+    }
+
+    // 08. Start History Compaction Thread
+    ret = initCompaction();
+    if (ret < 0){
+        fprintf( stderr, "initCompaction() is failed \n");
+        return -1;
+    }
+
+    // 09. Start Receive / Worker / Shm / Disk Stages
+    ret = initPipeline();
+    if (ret < 0){
+        fprintf( stderr, "initPipeline() is failed \n");
+        return -1;
+    }
+
     return 1;
 }
 
-void sig_interrupt_alarm(){
+int readConfigData(){
+
+    FILE        *fp;
+    char        fName[64];
+    char        readBuff[128], key[64];
+    long long   value;
+    int         section = 0;        // 1 : [COMPACTION], 2 : [PIPELINE]
+
+    // Defaults
+    psmConf.segmentSec      = 600;
+    psmConf.recentWindow    = 3600;
+    psmConf.minuteWindow    = 86400;
+    psmConf.compactInterval = 60;
+    psmConf.diskBudget      = 512LL * 1024 * 1024;
+    psmConf.ioLimit         = 4096LL * 1024;
+    psmConf.workerNum       = 4;
+    psmConf.jobPoolSize     = 64;
+    psmConf.statInterval    = 60;
+
+    sprintf(fName, "%s.dat", myAppName);
+
+    fp = fopen(fName, "r");
+    if (fp == NULL){
+        fprintf(stderr, "File Open Failed[%s], use default config\n", fName);
+        return 1;
+    }
 
-	fprintf( stderr, "SIGINT[%d] is occured\n", SIGINT);
+    while (fgets(readBuff, sizeof(readBuff), fp) != NULL){
+
+        if (readBuff[0] == '#' || readBuff[0] == '\n')
+            continue;
+
+        if (readBuff[0] == '['){
+            if (strcmp(readBuff, "[COMPACTION]\n") == 0)     section = 1;
+            else if (strcmp(readBuff, "[PIPELINE]\n") == 0)  section = 2;
+            else                                            section = 0;
+            continue;
+        }
+
+        if (section == 0 || sscanf(readBuff, "%63s = %lld", key, &value) != 2)
+            continue;
+
+        if (section == 2){
+            if (strcmp(key, "WORKER_NUM") == 0)             psmConf.workerNum       = value;
+            else if (strcmp(key, "JOB_POOL") == 0)          psmConf.jobPoolSize     = value;
+            else if (strcmp(key, "STAT_INTERVAL") == 0)     psmConf.statInterval    = value;
+            else
+                fprintf(stderr, "Unknown Config [%s]\n", key);
+            continue;
+        }
+
+        if (strcmp(key, "SEGMENT_SEC") == 0)            psmConf.segmentSec      = value;
+        else if (strcmp(key, "RECENT_WINDOW") == 0)     psmConf.recentWindow    = value;
+        else if (strcmp(key, "MINUTE_WINDOW") == 0)     psmConf.minuteWindow    = value;
+        else if (strcmp(key, "COMPACT_INTERVAL") == 0)  psmConf.compactInterval = value;
+        else if (strcmp(key, "DISK_BUDGET_MB") == 0)    psmConf.diskBudget      = value * 1024 * 1024;
+        else if (strcmp(key, "IO_LIMIT_KB") == 0)       psmConf.ioLimit         = value * 1024;
+        else
+            fprintf(stderr, "Unknown Config [%s]\n", key);
+    }
+
+    fclose(fp);
+
+    if (psmConf.segmentSec <= 0 || psmConf.compactInterval <= 0){
+        fprintf(stderr, "Invalid SEGMENT_SEC[%d] or COMPACT_INTERVAL[%d]\n",
+                psmConf.segmentSec, psmConf.compactInterval);
+        return -1;
+    }
 
-    if (result_fp != NULL) {
-        fflush(result_fp);
-        fclose(result_fp);
+    // Segments are rolled up into hours, so one must never straddle an hour
+    if (3600 % psmConf.segmentSec != 0){
+        fprintf(stderr, "Invalid SEGMENT_SEC[%d], must divide 3600\n", psmConf.segmentSec);
+        return -1;
+    }
+
+    if (psmConf.workerNum <= 0 || psmConf.jobPoolSize < psmConf.workerNum){
+        fprintf(stderr, "Invalid WORKER_NUM[%d] or JOB_POOL[%d]\n",
+                psmConf.workerNum, psmConf.jobPoolSize);
+        return -1;
     }
 
-	exit(1);
+    return 1;
+}
+
+void sig_interrupt_alarm(){
+
+	fprintf( stderr, "SIGINT[%d] is occured\n", SIGINT);
+
+    // main() drains the pipeline and closes the stores
+    psmConf.stopFlag = 1;
 }
 
 void sig_stop_alarm(){
 
-    fprintf(stderr, "%s\n", psmConf.shm_addr);
+    // Not async-signal-safe to print here, main() does it
+    psmConf.statFlag = 1;
 }
 
 int initMsgQueue(){
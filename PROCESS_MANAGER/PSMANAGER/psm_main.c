@@ -1,17 +1,13 @@
 #include "psmanager.h"
 
 PSMANAGER_CONF psmConf = {};
-FILE           *result_fp;
 
 int main(){
 
     int     ret = 0;
     time_t	now, old;
-    char    readBuff[10240];
 
-    result_fp = fopen("result.dat", "a+");
-
-    // 01. INIT & LOAD CONFIG
+    // 01. INIT & LOAD CONFIG ( starts the pipeline threads )
     ret = initPsm();
     if (ret < 0){
         fprintf(stderr, " initPsm() is failed\n");
@@ -21,31 +17,33 @@ int main(){
     now = time(0);
     old = now;
 
-    while(1){
+    // Snapshots are received, diffed and stored by the pipeline ( psm_pipeline.c )
+    while(!psmConf.stopFlag){
 
-        now = time(0);
-        if ( now == old )
-            continue;
+        // Command index queries are served between snapshots
+        pollQuerySocket();
 
-        memset(readBuff, 0x00, sizeof(readBuff));
-        ret = rcvQueueMsg(readBuff);
-        if (ret < 0){
-            usleep(1000);
-            old = now;
-            continue;
+        if (psmConf.statFlag){
+            psmConf.statFlag = 0;
+            fprintf(stderr, "%s\n", psmConf.shm_addr);
+            dumpPipelineStat();
         }
 
-        sprintf( psmConf.shm_addr, "%s", readBuff);
-
-        if( result_fp != NULL) 
-            fprintf( result_fp, "%s\n\n", readBuff);
+        now = time(0);
+        if (psmConf.statInterval > 0 && now - old >= psmConf.statInterval){
+            dumpPipelineStat();
+            old = now;
+        }
 
-        //writeShmMemory(readBuff);
-                
-        old = now;
+        usleep(10000);
     }
 
-    fclose(result_fp);
+    stopPipeline();
+
+    closeColumnStore();
+    closeEventStream();
+    closeQuerySocket();
+    unlink(QUERY_SOCK_PATH);
 
     return 1;
 }
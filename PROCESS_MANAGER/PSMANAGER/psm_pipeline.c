@@ -0,0 +1,378 @@
+#include "psmanager.h"
+
+/*
+ * Ingestion Pipeline
+ *
+ *   recv    : blocking msgrcv() into a pooled job, partitioned by host
+ *   worker  : parseSnapshot() + diffSnapshot() ( events, command index )
+ *   shm     : latest raw snapshot to the shared memory
+ *   disk    : appendColumnStore()
+ *
+ * Stage metrics ( every STAT_INTERVAL and on SIGTSTP ) :
+ *   depth / maxDepth of the input ring ( recv : msg queue backlog ),
+ *   jobs, jobs per second, average wait in the ring, average and max
+ *   service time.
+ */
+
+static PSM_JOB      *jobPool;
+static PSM_RING     poolRing;           // MPSC : shm, disk -> recv
+static PSM_RING     *workerRing;        // SPSC : recv -> worker[i]
+static PSM_RING     shmRing;            // MPSC : workers -> shm
+static PSM_RING     diskRing;           // MPSC : workers -> disk
+
+static PSM_STAGE    recvStage;
+static PSM_STAGE    *workerStage;
+static PSM_STAGE    shmStage;
+static PSM_STAGE    diskStage;
+
+static atomic_int   recvDone;
+static atomic_int   workerLive;
+static int          pipelineInit;
+static long long    lastStatNs;
+
+static long long nowNs(){
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Spin briefly, then sleep so an idle stage does not burn a core
+static void waitBackoff(int *spin){
+
+    if (++(*spin) < 64)
+        sched_yield();
+    else
+        usleep(200);
+}
+
+static void pushWait(PSM_RING *ring, void *data, int multiProducer){
+
+    int     spin = 0;
+
+    while ((multiProducer ? pushRingMP(ring, data) : pushRing(ring, data)) < 0)
+        waitBackoff(&spin);
+}
+
+static void updateDepth(PSM_STAGE *stage, unsigned int depth){
+
+    if (depth > atomic_load_explicit(&stage->maxDepth, memory_order_relaxed))
+        atomic_store_explicit(&stage->maxDepth, depth, memory_order_relaxed);
+}
+
+static void updateStat(PSM_STAGE *stage, long long start, long long end, long long enqTime){
+
+    unsigned long long  svc = end - start;
+
+    atomic_fetch_add_explicit(&stage->jobNum, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stage->busyNs, svc, memory_order_relaxed);
+    if (enqTime > 0)
+        atomic_fetch_add_explicit(&stage->waitNs, start - enqTime, memory_order_relaxed);
+    if (svc > atomic_load_explicit(&stage->maxNs, memory_order_relaxed))
+        atomic_store_explicit(&stage->maxNs, svc, memory_order_relaxed);
+}
+
+// Both tail stages are done with the job -> back to the pool
+static void releaseJob(PSM_JOB *job){
+
+    if (atomic_fetch_sub(&job->refCnt, 1) == 1)
+        pushWait(&poolRing, job, 1);
+}
+
+// Worker of a snapshot : FNV-1a of the " IP[..] User[..]" header line
+static int getPartition(char *msgBuff){
+
+    unsigned int    hash = 2166136261u;
+
+    for (; *msgBuff != '\0' && *msgBuff != '\n' ; msgBuff++){
+        hash ^= (unsigned char)*msgBuff;
+        hash *= 16777619u;
+    }
+
+    return hash % psmConf.workerNum;
+}
+
+static void sig_wakeup(){
+
+    // Only interrupts the blocking msgrcv() of the receive stage
+}
+
+static void *recv_main(void *arg){
+
+    PSM_JOB     *job = NULL;
+    long long   start;
+    int         spin, idx;
+
+    while (!psmConf.stopFlag){
+
+        // 01. A free job ( waits here when every job is in flight )
+        for (spin = 0 ; job == NULL && !psmConf.stopFlag ; ){
+            job = (PSM_JOB *)popRing(&poolRing);
+            if (job == NULL)
+                waitBackoff(&spin);
+        }
+        if (job == NULL)
+            break;
+
+        // 02. Blocking receive, EINTR when stopPipeline() wakes us up
+        if (rcvQueueMsg(job->msgBuff, 0) < 0)
+            continue;
+
+        start = nowNs();
+        job->rcvTime = time(0);
+
+        // 03. Same host -> same worker
+        idx = getPartition(job->msgBuff);
+        job->enqTime = nowNs();
+        pushWait(&workerRing[idx], job, 0);
+        updateDepth(&workerStage[idx], getRingDepth(&workerRing[idx]));
+
+        updateStat(&recvStage, start, nowNs(), 0);
+        job = NULL;
+    }
+
+    atomic_store(&recvDone, 1);
+
+    return NULL;
+}
+
+static void *worker_main(void *arg){
+
+    PSM_STAGE   *stage = (PSM_STAGE *)arg;
+    PSM_JOB     *job;
+    char        parseBuff[MAX_BUFF_SIZE];
+    long long   start, enqTime;
+    int         spin = 0, done;
+
+    for (;;){
+
+        // Checked before the pop : an empty ring after recvDone is really drained
+        done = atomic_load(&recvDone);
+
+        job = (PSM_JOB *)popRing(stage->inRing);
+        if (job == NULL){
+            if (done)
+                break;
+            waitBackoff(&spin);
+            continue;
+        }
+        spin = 0;
+
+        start   = nowNs();
+        enqTime = job->enqTime;
+
+        // parseSnapshot() cuts its buffer, the shm stage needs the raw text
+        memcpy(parseBuff, job->msgBuff, sizeof(parseBuff));
+        job->parsed = (parseSnapshot(parseBuff, job->rcvTime, &job->snap) > 0);
+
+        // START / EXIT / RESTART events to event.dat
+        if (job->parsed)
+            diffSnapshot(&job->snap);
+
+        atomic_store(&job->refCnt, 2);
+        job->enqTime = nowNs();
+
+        pushWait(&shmRing, job, 1);
+        updateDepth(&shmStage, getRingDepth(&shmRing));
+        pushWait(&diskRing, job, 1);
+        updateDepth(&diskStage, getRingDepth(&diskRing));
+
+        updateStat(stage, start, nowNs(), enqTime);
+    }
+
+    atomic_fetch_sub(&workerLive, 1);
+
+    return NULL;
+}
+
+static void *tail_main(void *arg){
+
+    PSM_STAGE   *stage = (PSM_STAGE *)arg;
+    PSM_JOB     *job;
+    long long   start, enqTime;
+    int         spin = 0, done;
+
+    for (;;){
+
+        done = (atomic_load(&workerLive) == 0);
+
+        job = (PSM_JOB *)popRing(stage->inRing);
+        if (job == NULL){
+            if (done)
+                break;
+            waitBackoff(&spin);
+            continue;
+        }
+        spin = 0;
+
+        start   = nowNs();
+        enqTime = job->enqTime;
+
+        if (stage == &shmStage)
+            sprintf( psmConf.shm_addr, "%s", job->msgBuff);
+
+        // History is stored as column blocks instead of plain text ( result.dat )
+        else if (job->parsed)
+            appendColumnStore(&job->snap);
+
+        updateStat(stage, start, nowNs(), enqTime);
+        releaseJob(job);
+    }
+
+    return NULL;
+}
+
+static int startStage(PSM_STAGE *stage, char *name, PSM_RING *inRing, void *(*func)(void *)){
+
+    snprintf(stage->name, sizeof(stage->name), "%s", name);
+    stage->inRing = inRing;
+
+    if (pthread_create(&stage->thrd, NULL, func, stage) != 0){
+        fprintf(stderr, "pthread_create() is Failed, stage[%s]\n", name);
+        return -1;
+    }
+
+    return 1;
+}
+
+int initPipeline(){
+
+    sigset_t    sigSet, oldSet;
+    char        name[32];
+    int         i, ret = 1;
+
+    // 01. Job Pool
+    jobPool = (PSM_JOB *)calloc(psmConf.jobPoolSize, sizeof(PSM_JOB));
+    if (jobPool == NULL){
+        fprintf(stderr, "initPipeline() malloc is failed, JOB_POOL[%d]\n", psmConf.jobPoolSize);
+        return -1;
+    }
+
+    // 02. Rings ( each one can hold the whole pool, so a push only waits on a slow consumer )
+    workerRing  = (PSM_RING *)calloc(psmConf.workerNum, sizeof(PSM_RING));
+    workerStage = (PSM_STAGE *)calloc(psmConf.workerNum, sizeof(PSM_STAGE));
+    if (workerRing == NULL || workerStage == NULL){
+        fprintf(stderr, "initPipeline() malloc is failed, WORKER_NUM[%d]\n", psmConf.workerNum);
+        return -1;
+    }
+
+    if (initRing(&poolRing, psmConf.jobPoolSize) < 0 ||
+        initRing(&shmRing, psmConf.jobPoolSize) < 0 ||
+        initRing(&diskRing, psmConf.jobPoolSize) < 0)
+        return -1;
+
+    for (i = 0 ; i < psmConf.workerNum ; i++){
+        if (initRing(&workerRing[i], psmConf.jobPoolSize) < 0)
+            return -1;
+    }
+
+    for (i = 0 ; i < psmConf.jobPoolSize ; i++)
+        pushRing(&poolRing, &jobPool[i]);
+
+    atomic_store(&recvDone, 0);
+    atomic_store(&workerLive, psmConf.workerNum);
+
+    signal(SIGUSR1, (void *)sig_wakeup);
+
+    // 03. Threads, SIGINT / SIGTSTP stay with the main thread
+    sigemptyset(&sigSet);
+    sigaddset(&sigSet, SIGINT);
+    sigaddset(&sigSet, SIGTSTP);
+    pthread_sigmask(SIG_BLOCK, &sigSet, &oldSet);
+
+    if (startStage(&shmStage, "shm", &shmRing, tail_main) < 0 ||
+        startStage(&diskStage, "disk", &diskRing, tail_main) < 0)
+        ret = -1;
+
+    for (i = 0 ; ret > 0 && i < psmConf.workerNum ; i++){
+        snprintf(name, sizeof(name), "worker%d", i);
+        if (startStage(&workerStage[i], name, &workerRing[i], worker_main) < 0)
+            ret = -1;
+    }
+
+    if (ret > 0 && startStage(&recvStage, "recv", NULL, recv_main) < 0)
+        ret = -1;
+
+    pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+
+    if (ret < 0)
+        return -1;
+
+    lastStatNs   = nowNs();
+    pipelineInit = 1;
+
+    return 1;
+}
+
+// Drain every ring in stage order; psmConf.stopFlag must be set
+void stopPipeline(){
+
+    int     i;
+
+    if (!pipelineInit)
+        return ;
+
+    // A signal sent just before msgrcv() would be lost, so repeat it
+    while (!atomic_load(&recvDone)){
+        pthread_kill(recvStage.thrd, SIGUSR1);
+        usleep(10000);
+    }
+    pthread_join(recvStage.thrd, NULL);
+
+    for (i = 0 ; i < psmConf.workerNum ; i++)
+        pthread_join(workerStage[i].thrd, NULL);
+
+    pthread_join(shmStage.thrd, NULL);
+    pthread_join(diskStage.thrd, NULL);
+
+    dumpPipelineStat();
+    pipelineInit = 0;
+}
+
+static void printStage(PSM_STAGE *stage, unsigned int depth, double elapsed){
+
+    unsigned long long  jobNum, lastNum;
+
+    jobNum  = atomic_load_explicit(&stage->jobNum, memory_order_relaxed);
+    lastNum = stage->lastJobNum;
+    stage->lastJobNum = jobNum;
+
+    fprintf(stderr, " %-10s %6u %8u %10llu %8.1f %10.1f %10.1f %10.1f\n",
+            stage->name, depth, atomic_load_explicit(&stage->maxDepth, memory_order_relaxed), jobNum,
+            elapsed > 0 ? (jobNum - lastNum) / elapsed : 0.0,
+            jobNum > 0 ? atomic_load_explicit(&stage->waitNs, memory_order_relaxed) / 1000.0 / jobNum : 0.0,
+            jobNum > 0 ? atomic_load_explicit(&stage->busyNs, memory_order_relaxed) / 1000.0 / jobNum : 0.0,
+            atomic_load_explicit(&stage->maxNs, memory_order_relaxed) / 1000.0);
+}
+
+void dumpPipelineStat(){
+
+    struct msqid_ds qInfo;
+    unsigned int    qDepth = 0;
+    long long       now;
+    double          elapsed;
+    int             i;
+
+    if (!pipelineInit)
+        return ;
+
+    now        = nowNs();
+    elapsed    = (now - lastStatNs) / 1e9;
+    lastStatNs = now;
+
+    if (msgctl(myQid, IPC_STAT, &qInfo) == 0)
+        qDepth = qInfo.msg_qnum;
+    updateDepth(&recvStage, qDepth);
+
+    fprintf(stderr, "[PIPELINE] free job[%u/%d]\n", getRingDepth(&poolRing), psmConf.jobPoolSize);
+    fprintf(stderr, " %-10s %6s %8s %10s %8s %10s %10s %10s\n",
+            "stage", "depth", "maxDepth", "jobs", "jobs/s", "wait(us)", "svc(us)", "maxSvc(us)");
+
+    printStage(&recvStage, qDepth, elapsed);
+    for (i = 0 ; i < psmConf.workerNum ; i++)
+        printStage(&workerStage[i], getRingDepth(&workerRing[i]), elapsed);
+    printStage(&shmStage, getRingDepth(&shmRing), elapsed);
+    printStage(&diskStage, getRingDepth(&diskRing), elapsed);
+}
@@ -1,6 +1,7 @@
 #include "psmanager.h"
 
-int rcvQueueMsg(char *readBuff){
+// msgFlag : IPC_NOWAIT or 0 ( block until a message arrives )
+int rcvQueueMsg(char *readBuff, int msgFlag){
 
 	MsgType  rcvMsg;
 	ssize_t  readBytes = 0;
@@ -8,14 +9,14 @@ int rcvQueueMsg(char *readBuff){
     int      ret;
 
 	msgSize   = sizeof(MsgType) - sizeof(rcvMsg.mtype);
-	readBytes = msgrcv( (key_t)myQid , &rcvMsg, msgSize, 1, IPC_NOWAIT);
+	readBytes = msgrcv( (key_t)myQid , &rcvMsg, msgSize, 1, msgFlag);
 
 	if (readBytes > 0){
 		sprintf(readBuff, "%s", rcvMsg.msgBuff);
 		return 1;
 	}
 
-	if (errno != ENOMSG){
+	if (errno != ENOMSG && errno != EINTR){
 		fprintf(stderr, "MsgRcv() Error\n");
 		return -1;
 	}
@@ -0,0 +1,120 @@
+#include "psmanager.h"
+
+/*
+ * Bounded lock-free ring ( Vyukov )
+ *
+ *  Every cell carries a sequence number :
+ *      seq == pos          free, a producer may fill it
+ *      seq == pos + 1      filled, the consumer may take it
+ *  pushRing() is for a single producer, pushRingMP() claims the tail
+ *  with a CAS so any number of threads may push. There is always one
+ *  consumer, so popRing() never needs a CAS.
+ */
+
+int initRing(PSM_RING *ring, unsigned int size){
+
+    unsigned int    i, capacity = 2;
+
+    while (capacity < size)
+        capacity <<= 1;
+
+    ring->cell = (PSM_RING_CELL *)calloc(capacity, sizeof(PSM_RING_CELL));
+    if (ring->cell == NULL){
+        fprintf(stderr, "initRing() malloc is failed\n");
+        return -1;
+    }
+
+    for (i = 0 ; i < capacity ; i++)
+        atomic_store_explicit(&ring->cell[i].seq, i, memory_order_relaxed);
+
+    ring->size = capacity;
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+
+    return 1;
+}
+
+void freeRing(PSM_RING *ring){
+
+    free(ring->cell);
+    ring->cell = NULL;
+    ring->size = 0;
+}
+
+int pushRing(PSM_RING *ring, void *data){
+
+    unsigned long   pos;
+    PSM_RING_CELL   *cell;
+
+    pos  = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    cell = &ring->cell[pos & (ring->size - 1)];
+
+    if (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos)
+        return -1;      // full
+
+    cell->data = data;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    atomic_store_explicit(&ring->tail, pos + 1, memory_order_relaxed);
+
+    return 1;
+}
+
+int pushRingMP(PSM_RING *ring, void *data){
+
+    unsigned long   pos, seq;
+    long            dif;
+    PSM_RING_CELL   *cell;
+
+    pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    for (;;){
+        cell = &ring->cell[pos & (ring->size - 1)];
+        seq  = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        dif  = (long)seq - (long)pos;
+
+        if (dif == 0){
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+            return -1;  // full
+        else
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    }
+
+    cell->data = data;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+
+    return 1;
+}
+
+void *popRing(PSM_RING *ring){
+
+    unsigned long   pos;
+    PSM_RING_CELL   *cell;
+    void            *data;
+
+    pos  = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    cell = &ring->cell[pos & (ring->size - 1)];
+
+    if (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos + 1)
+        return NULL;    // empty
+
+    data = cell->data;
+    atomic_store_explicit(&cell->seq, pos + ring->size, memory_order_release);
+    atomic_store_explicit(&ring->head, pos + 1, memory_order_relaxed);
+
+    return data;
+}
+
+// Approximate, for metrics only
+unsigned int getRingDepth(PSM_RING *ring){
+
+    unsigned long   head, tail;
+
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    return tail > head ? (unsigned int)(tail - head) : 0;
+}
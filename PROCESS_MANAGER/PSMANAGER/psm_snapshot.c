@@ -0,0 +1,150 @@
+#include "psmanager.h"
+
+// Column names of "ps -ef" ( Linux : UID PID PPID C STIME TTY TIME CMD,
+//                            Cygwin: UID PID PPID TTY STIME COMMAND )
+enum {
+    PS_COL_UID = 0,
+    PS_COL_PID,
+    PS_COL_PPID,
+    PS_COL_TTY,
+    PS_COL_STIME,
+    PS_COL_TIME,
+    PS_COL_CMD,
+    PS_COL_SKIP
+};
+
+#define MAX_PS_COLUMN   16
+
+static int getColumnType(char *name){
+
+    if (strcmp(name, "UID") == 0)       return PS_COL_UID;
+    if (strcmp(name, "PID") == 0)       return PS_COL_PID;
+    if (strcmp(name, "PPID") == 0)      return PS_COL_PPID;
+    if (strcmp(name, "TTY") == 0)       return PS_COL_TTY;
+    if (strcmp(name, "STIME") == 0)     return PS_COL_STIME;
+    if (strcmp(name, "TIME") == 0)      return PS_COL_TIME;
+    if (strcmp(name, "CMD") == 0 || strcmp(name, "COMMAND") == 0)
+        return PS_COL_CMD;
+
+    return PS_COL_SKIP;
+}
+
+// "[dd-]hh:mm:ss" -> seconds
+static int getCpuTime(char *str){
+
+    int     day = 0, hour = 0, min = 0, sec = 0;
+
+    if (sscanf(str, "%d-%d:%d:%d", &day, &hour, &min, &sec) == 4)
+        return ((day * 24 + hour) * 60 + min) * 60 + sec;
+
+    if (sscanf(str, "%d:%d:%d", &hour, &min, &sec) == 3)
+        return (hour * 60 + min) * 60 + sec;
+
+    return 0;
+}
+
+static void setColumnValue(PS_ENTRY *ent, int colType, char *str){
+
+    switch (colType){
+        case PS_COL_UID:
+            snprintf(ent->userName, sizeof(ent->userName), "%s", str);
+            break;
+        case PS_COL_PID:
+            ent->pid = atoi(str);
+            break;
+        case PS_COL_PPID:
+            ent->ppid = atoi(str);
+            break;
+        case PS_COL_TTY:
+            snprintf(ent->tty, sizeof(ent->tty), "%s", str);
+            break;
+        case PS_COL_STIME:
+            snprintf(ent->sTime, sizeof(ent->sTime), "%s", str);
+            break;
+        case PS_COL_TIME:
+            ent->cpuTime = getCpuTime(str);
+            break;
+    }
+}
+
+/*
+ * Parse the message built by getpsd
+ *
+ *   " IP[x.x.x.x] User[name] \n"
+ *   "=====...\n"
+ *   "<ps -ef header>\n"
+ *   "<ps -ef rows>\n"
+ *   "=====...\n"
+ */
+int parseSnapshot(char *readBuff, time_t rcvTime, PS_SNAPSHOT *snap){
+
+    char    *line, *next, *ptr, *field, *save;
+    int     colType[MAX_PS_COLUMN];
+    int     colNum = 0, i, len;
+    PS_ENTRY *ent;
+
+    snap->entryNum = 0;
+    snap->rcvTime  = rcvTime;
+    snap->ipAddress[0] = '\0';
+    snap->userName[0]  = '\0';
+
+    if (sscanf(readBuff, " IP[%63[^]]] User[%31[^]]]", snap->ipAddress, snap->userName) != 2){
+        fprintf(stderr, "parseSnapshot() Unknown Header\n");
+        return -1;
+    }
+
+    for (line = readBuff; line != NULL && *line != '\0'; line = next){
+
+        next = strchr(line, '\n');
+        if (next != NULL)
+            *next++ = '\0';
+
+        for (ptr = line; *ptr == ' ' || *ptr == '\t'; ptr++);
+
+        if (*ptr == '\0' || *ptr == '=' || strncmp(ptr, "IP[", 3) == 0)
+            continue;
+
+        // 01. Header Line
+        if (strncmp(ptr, "UID", 3) == 0 && (ptr[3] == ' ' || ptr[3] == '\t')){
+            colNum = 0;
+            for (field = strtok_r(ptr, " \t", &save); field != NULL && colNum < MAX_PS_COLUMN;
+                 field = strtok_r(NULL, " \t", &save))
+                colType[colNum++] = getColumnType(field);
+            continue;
+        }
+
+        if (colNum == 0 || snap->entryNum >= MAX_PS_ENTRY)
+            continue;
+
+        // 02. Process Line ( the last column keeps its spaces )
+        ent = &snap->entry[snap->entryNum];
+        memset(ent, 0x00, sizeof(PS_ENTRY));
+
+        for (i = 0 ; i < colNum && *ptr != '\0' ; i++){
+
+            if (colType[i] == PS_COL_CMD || i == colNum - 1){
+                len = strlen(ptr);
+                while (len > 0 && (ptr[len-1] == '\r' || ptr[len-1] == ' '))
+                    ptr[--len] = '\0';
+                if (colType[i] == PS_COL_CMD)
+                    snprintf(ent->command, sizeof(ent->command), "%s", ptr);
+                else
+                    setColumnValue(ent, colType[i], ptr);
+                break;
+            }
+
+            field = ptr;
+            while (*ptr != '\0' && *ptr != ' ' && *ptr != '\t') ptr++;
+            if (*ptr != '\0')
+                *ptr++ = '\0';
+            while (*ptr == ' ' || *ptr == '\t') ptr++;
+
+            setColumnValue(ent, colType[i], field);
+        }
+
+        if (ent->pid > 0)
+            snap->entryNum++;
+    }
+
+    return snap->entryNum;
+}
@@ -10,6 +10,11 @@
 // Signal
 #include <signal.h>
 
+// Thread
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
 // IPC
 #include <sys/ipc.h>
 #include <sys/msg.h>
@@ -21,6 +26,17 @@
 #include <errno.h>
 #include <sys/shm.h>
 
+// Query Socket
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+
+// Column Store
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
 #define MY_QKEY    	9999 
 #define	SHM_KEY		5678
 #define MEM_SIZE	50000
@@ -28,6 +44,10 @@
 #define SHM_EXIST	1
 #define SHM_CREATE	2
 
+#define HISTORY_DIR         "history"
+#define EVT_FILE_NAME       "event.dat"
+#define QUERY_SOCK_PATH     "/tmp/psmanager.sock"
+
 
 // ===================================================================
 // Structure
@@ -36,6 +56,24 @@ typedef struct {
 
     char *shm_addr;
 
+    // [COMPACTION] of psmanager.dat
+    int         segmentSec;         // length of one history segment
+    int         recentWindow;       // keep full resolution for this long
+    int         minuteWindow;       // keep per-minute rollups for this long
+    int         compactInterval;    // seconds between compaction runs
+    long long   diskBudget;         // bytes of HISTORY_DIR
+    long long   ioLimit;            // bytes per second of the compaction job
+
+    pthread_t   compactThrd;
+
+    // [PIPELINE] of psmanager.dat
+    int         workerNum;          // decode / diff workers
+    int         jobPoolSize;        // snapshots in flight
+    int         statInterval;       // seconds between stage metrics ( 0 : SIGTSTP only )
+
+    volatile sig_atomic_t   stopFlag;
+    volatile sig_atomic_t   statFlag;   // SIGTSTP, main() dumps the stats
+
 }PSMANAGER_CONF;
 
 typedef struct msgq{
@@ -44,22 +82,292 @@ typedef struct msgq{
     char msgBuff[MAX_BUFF_SIZE];
 }MsgType;
 
+// One line of "ps -ef" sent by getpsd
+typedef struct psent{
+    char    userName[32];
+    int     pid;
+    int     ppid;
+    int     cpuTime;        // TIME column in seconds (0 if not reported)
+    char    tty[16];
+    char    sTime[16];
+    char    command[256];
+}PS_ENTRY;
+
+typedef struct snapshot{
+    char        ipAddress[64];
+    char        userName[32];
+    time_t      rcvTime;
+    int         entryNum;
+#define MAX_PS_ENTRY    512
+    PS_ENTRY    entry[MAX_PS_ENTRY];
+}PS_SNAPSHOT;
+
+// ===================================================================
+// Column Store ( psm_column.c )
+//
+//  A history segment ( HISTORY_DIR/seg_<start>.col ) is a sequence of
+//  self-describing blocks. Every block keeps one column per PS_ENTRY
+//  field plus the snapshot sequence number; string columns (host, user,
+//  tty, stime, command) are stored as varint ids into a per-block dictionary, and
+//  integer columns are zigzag/varint deltas against the previous row.
+//  The header is fixed-size and 8-byte aligned so a reader can mmap()
+//  the file, skip blocks by min/max stats and decode only the columns
+//  it needs.
+
+#define COL_BLOCK_MAGIC     0x42435350      // "PSCB"
+#define COL_BLOCK_VERSION   2
+#define COL_MAX_BLOCK_ROW   4096
+#define COL_MAX_DICT        4096
+#define COL_DICT_POOL_SIZE  (256 * 1024)
+
+enum {
+    COL_HOST = 0,       // dictionary id of "ip/user"
+    COL_TIME,           // delta of receive time
+    COL_PID,            // delta of pid
+    COL_PPID,           // delta of ppid
+    COL_CPUTIME,        // varint
+    COL_USER,           // dictionary id
+    COL_TTY,            // dictionary id
+    COL_STIME,          // dictionary id
+    COL_COMMAND,        // dictionary id
+    COL_SNAP,           // delta of snapshot sequence number
+    COL_MAX
+};
+
+typedef struct colhdr{
+    unsigned int    magic;
+    unsigned int    version;
+    unsigned int    blockLen;           // header + dictionary + columns
+    unsigned int    rowNum;
+    unsigned int    dictNum;
+    unsigned int    dictOff;            // uint32 offset table[dictNum+1] + strings
+    long long       minTime;
+    long long       maxTime;
+    int             minPid;
+    int             maxPid;
+    unsigned int    colOff[COL_MAX];    // from the start of the block
+    unsigned int    colLen[COL_MAX];
+}PSM_COL_HEADER;
+
+typedef struct colfile{
+    int     fd;
+    char    *addr;
+    size_t  size;
+}PSM_COL_FILE;
+
+// ===================================================================
+// Process Lifecycle ( psm_host.c, psm_event.c )
+//
+//  Every host keeps two process tables keyed by (pid, start time). A new
+//  snapshot is inserted into the spare table while it is looked up in the
+//  current one, so the diff only touches slots of the two snapshots.
+
+enum {
+    PSM_EVT_START = 1,
+    PSM_EVT_EXIT,
+    PSM_EVT_RESTART
+};
+
+#define PSM_EVT_CMD_LEN     64
+
+typedef struct procslot{
+    int             pid;                // 0 : empty slot
+    int             ppid;
+    unsigned int    sTimeHash;
+    unsigned int    cmdHash;
+    int             seen;               // matched by the snapshot being diffed
+    char            command[PSM_EVT_CMD_LEN];
+}PSM_PROC_SLOT;
+
+typedef struct proctbl{
+    int             capacity;           // power of 2, >= entryNum * 2
+    int             usedNum;
+    int             *used;              // occupied slot list
+    PSM_PROC_SLOT   *slot;
+}PSM_PROC_TBL;
+
+typedef struct host{
+    char            hostName[128];      // "ip/user"
+    int             hostIdx;
+    int             snapNum;
+    int             cur;                // current table ( 0 or 1 )
+    PSM_PROC_TBL    procTbl[2];
+}PSM_HOST;
+
+#define MAX_PSM_HOST        4096
+
+typedef struct event{
+    int             evtType;
+    int             hostIdx;
+    int             pid;
+    int             prevPid;            // RESTART : pid of the exited process
+    time_t          evtTime;
+    char            *command;
+}PSM_EVENT;
+
+// ===================================================================
+// Command Index ( psm_index.c )
+//
+//  Command lines are split into tokens ( every argv word and the basename
+//  of argv[0] ). Tokens are interned once and keep a posting list of the
+//  processes running them; START/EXIT events update the postings, so the
+//  index always reflects the latest snapshot of every host.
+//  A token is freed with its last posting, so the table holds the words of
+//  running processes only, and never more than IDX_MAX_TOKEN_NUM of them :
+//  past the cap new words are not indexed. Bound : IDX_MAX_TOKEN_NUM *
+//  ( sizeof(PSM_IDX_TOKEN) + IDX_MAX_TOKEN_LEN + 4 ) for the tokens, about
+//  26 MB, plus one posting per indexed word of a running process.
+//
+//  Query ( AF_UNIX stream, one request per connection ):
+//      "TOKEN <word>\n" | "PREFIX <word>\n" | "SUBSTR <word>\n"
+//  Reply:
+//      "<host> <pid> <command>\n" ... "END <count> <usec>\n"
+
+#define IDX_MAX_TOKEN       16          // tokens kept per process
+#define IDX_MAX_TOKEN_LEN   64
+#define IDX_MAX_TOKEN_NUM   (1 << 18)   // interned tokens
+#define IDX_MAX_PEND        256         // tokens not merged into the sorted array yet
+#define IDX_CMD_LEN         128
+#define IDX_PROC_BUCKET     (1 << 16)
+
+typedef struct idxproc{
+    int             hostIdx;
+    int             pid;                // 0 : free record
+    unsigned int    sTimeHash;          // with pid, tells a reused pid apart
+    int             next;               // bucket chain / free list
+    unsigned int    queryStamp;         // de-duplicates query results
+    int             tokenNum;
+    int             tokenId[IDX_MAX_TOKEN];
+    int             postPos[IDX_MAX_TOKEN];
+    char            command[IDX_CMD_LEN];
+}PSM_IDX_PROC;
+
+typedef struct idxtoken{
+    char            *name;              // NULL : free id
+    unsigned int    hash;
+    int             next;               // bucket chain / retired or free list
+    int             postNum;            // 0 : retired, see mergeSortedToken()
+    int             postMax;
+    int             *post;              // PSM_IDX_PROC index
+}PSM_IDX_TOKEN;
+
+// ===================================================================
+// Pipeline ( psm_ring.c, psm_pipeline.c )
+//
+//  receive --> worker[ hash(IP/User) % WORKER_NUM ] --> shm publish
+//                                                   --> disk writer
+//
+//  The receive stage feeds one SPSC ring per worker, so a host is always
+//  decoded and diffed by the same worker in arrival order. Workers share
+//  an MPSC ring into each tail stage; the pushes of one producer stay in
+//  FIFO order, so per-host order is kept up to the shm and the history.
+//  Jobs come from a fixed pool and go back through an MPSC free ring when
+//  both tail stages are done, which is the back pressure of the pipeline.
+
+typedef struct ringcell{
+    _Atomic unsigned long   seq;
+    void                    *data;
+}PSM_RING_CELL;
+
+typedef struct ring{
+    unsigned int            size;           // power of 2
+    PSM_RING_CELL           *cell;
+    char                    pad0[64];
+    _Atomic unsigned long   head;           // consumer
+    char                    pad1[64];
+    _Atomic unsigned long   tail;           // producer(s)
+    char                    pad2[64];
+}PSM_RING;
+
+typedef struct job{
+    char            msgBuff[MAX_BUFF_SIZE];
+    time_t          rcvTime;
+    int             parsed;                 // snap is valid
+    atomic_int      refCnt;                 // tail stages still holding the job
+    long long       enqTime;                // ns, when pushed to the next ring
+    PS_SNAPSHOT     snap;
+}PSM_JOB;
+
+typedef struct stage{
+    char                        name[32];
+    pthread_t                   thrd;
+    PSM_RING                    *inRing;    // NULL : receive stage
+    _Atomic unsigned long long  jobNum;
+    _Atomic unsigned long long  waitNs;     // time spent in inRing
+    _Atomic unsigned long long  busyNs;     // service time
+    _Atomic unsigned long long  maxNs;
+    _Atomic unsigned int        maxDepth;
+    unsigned long long          lastJobNum; // dumpPipelineStat() only
+}PSM_STAGE;
+
 // ===================================================================
 // Variable
 extern PSMANAGER_CONF psmConf;
 extern char     myAppName[32];
 extern int      myQid;
-extern FILE     *result_fp;
 
 // ===================================================================
 // Function
 extern int initMsgQueue();
 extern int initPsm();
+extern int readConfigData();
 extern void sig_interrupt_alarm();
 extern void sig_stop_alarm();
 extern int initSharedMemory();
-extern int rcvQueueMsg(char *readBuff);
+extern int rcvQueueMsg(char *readBuff, int msgFlag);
 extern int writeShmMemory(char *readBuff);
 
+// psm_snapshot.c
+extern int parseSnapshot(char *readBuff, time_t rcvTime, PS_SNAPSHOT *snap);
+
+// psm_host.c
+extern PSM_HOST *getHost(char *ipAddress, char *userName);
+extern PSM_HOST *getHostByIdx(int hostIdx);
+extern int getHostNum();
+extern unsigned int hashString(char *str);
+
+// psm_event.c
+extern int initEventStream(char *fName);
+extern int diffSnapshot(PS_SNAPSHOT *snap);
+extern void closeEventStream();
+extern char *getEventName(int evtType);
+
+// psm_index.c
+extern int addIndexProcess(int hostIdx, int pid, unsigned int sTimeHash, char *command);
+extern int removeIndexProcess(int hostIdx, int pid, unsigned int sTimeHash);
+extern int rekeyIndexProcess(int hostIdx, int pid, unsigned int oldSTimeHash, unsigned int sTimeHash);
+extern int initQuerySocket(char *sockPath);
+extern void pollQuerySocket();
+extern void closeQuerySocket();
+
+// psm_compact.c
+extern int initCompaction();
+extern void *compact_main(void *arg);
+
+// psm_ring.c
+extern int initRing(PSM_RING *ring, unsigned int size);
+extern void freeRing(PSM_RING *ring);
+extern int pushRing(PSM_RING *ring, void *data);
+extern int pushRingMP(PSM_RING *ring, void *data);
+extern void *popRing(PSM_RING *ring);
+extern unsigned int getRingDepth(PSM_RING *ring);
+
+// psm_pipeline.c
+extern int initPipeline();
+extern void stopPipeline();
+extern void dumpPipelineStat();
+
+// psm_column.c
+extern int initColumnStore(char *dirName);
+extern time_t getColumnSegment();
+extern int appendColumnStore(PS_SNAPSHOT *snap);
+extern int flushColumnStore();
+extern void closeColumnStore();
+extern int openColumnFile(char *fName, PSM_COL_FILE *colFile);
+extern void closeColumnFile(PSM_COL_FILE *colFile);
+extern PSM_COL_HEADER *nextColumnBlock(PSM_COL_FILE *colFile, size_t *offset);
+extern char *getColumnDict(PSM_COL_HEADER *blk, unsigned int id);
+extern int decodeColumn(PSM_COL_HEADER *blk, int colId, long long *value);
+
 
 #endif